@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Allocator that aligns the storage of a std::vector for vector loads
+template <typename T, std::size_t Alignment>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* pointer, std::size_t) {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Alignment used for the struct-of-arrays object data (one AVX register)
+const std::size_t SIMD_ALIGNMENT = 32;
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, SIMD_ALIGNMENT>>;
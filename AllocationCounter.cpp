@@ -0,0 +1,130 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<unsigned long long> allocationCount(0);
+thread_local unsigned long long threadAllocationCount = 0;
+
+void* countedAllocate(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    threadAllocationCount++;
+    // malloc(0) may return null, which new must not
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* countedAllocateAligned(std::size_t size, std::align_val_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    threadAllocationCount++;
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, align, size > 0 ? size : 1) != 0) {
+        return nullptr;
+    }
+    return pointer;
+}
+
+void* allocateOrThrow(void* pointer) {
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+} // namespace
+
+unsigned long long getThreadAllocationCount() {
+    return threadAllocationCount;
+}
+
+unsigned long long getAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+// Replacements of the global allocation functions (aligned storage comes from
+// posix_memalign, so it's released with free like the rest)
+
+void* operator new(std::size_t size) {
+    return allocateOrThrow(countedAllocate(size));
+}
+
+void* operator new[](std::size_t size) {
+    return allocateOrThrow(countedAllocate(size));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(countedAllocateAligned(size, alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(countedAllocateAligned(size, alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocateAligned(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Heap allocation accounting. AllocationCounter.cpp replaces the global operator new and
+// delete (every variant) with versions that count each allocation before forwarding to
+// malloc, so linking it into a program is all it takes to count every allocation made
+// through new, the standard containers and std::string.
+//
+// Counting costs one relaxed atomic add and one thread-local add per allocation. Frees
+// are not counted: a steady-state frame that allocates nothing frees nothing either.
+
+// Allocations made by the calling thread since it started
+unsigned long long getThreadAllocationCount();
+
+// Allocations made by every thread since the program started
+unsigned long long getAllocationCount();
+
+// Allocations made by the calling thread during a block
+class AllocationScope {
+public:
+    AllocationScope() : m_start(getThreadAllocationCount()) {}
+
+    unsigned long long getAllocations() const { return getThreadAllocationCount() - m_start; }
+
+private:
+    unsigned long long m_start;
+};
@@ -0,0 +1,245 @@
+// Smooth-min blending benchmark: cost of one scene distance evaluation for the old
+// all-pairs loop, the streaming full blend and the pruned blend (linear scan and BVH),
+// plus CPU frame times for both render modes.
+//
+// With --check-kernels it instead checks that the SSE and AVX2 packet kernels give
+// bit-identical results to the scalar reference, and exits non-zero if they don't.
+//
+// Usage: blend_bench [maxObjects] | blend_bench --check-kernels
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "CoordSystem.h"
+#include "CPURenderer.h"
+#include "ObjectManager.h"
+#include "SceneBVH.h"
+#include "SDFMath.h"
+#include "SDFPacket.h"
+
+// Original shader loop: every pair (j < i) is blended
+static float allPairsDistance(const ObjectManager& objects, const glm::vec3& p, std::vector<float>& dists) {
+    int count = objects.getObjectCount();
+    for (int i = 0; i < count; i++) {
+        dists[i] = sdfPrimitive(objects.getObjectType(i), p - objects.getObject3DPosition(i), objects.getObjectSliceSize(i));
+    }
+    float minDist = 1000.0f;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < i; j++) {
+            minDist = std::min(minDist, smoothMin(dists[i], dists[j], SDF_BLEND_K));
+        }
+        minDist = std::min(minDist, dists[i]);
+    }
+    return minDist;
+}
+
+static float fullDistance(const ObjectManager& objects, const glm::vec3& p) {
+    const int* types = objects.getTypesArray();
+    const float* x = objects.getProjectedXArray();
+    const float* y = objects.getProjectedYArray();
+    const float* z = objects.getProjectedZArray();
+    const float* size = objects.getSliceSizeArray();
+    SmoothBlender blender;
+    for (int i = 0; i < objects.getObjectCount(); i++) {
+        blender.add(i, sdfPrimitive(types[i], p - glm::vec3(x[i], y[i], z[i]), size[i]));
+    }
+    return blender.result.distance;
+}
+
+static float prunedScanDistance(const ObjectManager& objects, const glm::vec3& p) {
+    const int* types = objects.getTypesArray();
+    const float* x = objects.getProjectedXArray();
+    const float* y = objects.getProjectedYArray();
+    const float* z = objects.getProjectedZArray();
+    const float* size = objects.getSliceSizeArray();
+    BlendCandidates candidates;
+    for (int i = 0; i < objects.getObjectCount(); i++) {
+        candidates.add(i, sdfPrimitive(types[i], p - glm::vec3(x[i], y[i], z[i]), size[i]));
+    }
+    return candidates.blend().distance;
+}
+
+static bool sameBits(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Compare the packet and point kernels of every SIMD level the CPU has with the scalar
+// ones, on scene sizes around multiples of the vector widths (so the tail loops are
+// covered) and with partial lane masks. Returns the number of mismatches.
+static int checkKernels() {
+    const PacketKernels& reference = getPacketKernels(SIMD_SCALAR);
+    const int counts[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 63, 100, 257, 1000, 1001};
+    const int packets = 256;
+    int mismatches = 0;
+
+    for (int level = SIMD_SSE; level <= SIMD_AVX2; level++) {
+        const PacketKernels& kernels = getPacketKernels(static_cast<SimdLevel>(level));
+        if (kernels.level != level) {
+            std::printf("%-6s not supported by this CPU, skipped\n", level == SIMD_SSE ? "sse" : "avx2");
+            continue;
+        }
+        int levelMismatches = 0;
+        long long compared = 0;
+        for (int objectCount : counts) {
+            // Spheres and cubes around the origin; some W offsets make slices shrink or
+            // miss their object (SDF_EMPTY_SLICE)
+            std::mt19937 rng(objectCount);
+            std::uniform_real_distribution<float> position(-3.0f, 3.0f);
+            std::uniform_real_distribution<float> wOffset(-0.8f, 0.8f);
+            ObjectManager objects;
+            for (int i = 0; i < objectCount; i++) {
+                glm::vec4 p = getrealcoord(glm::vec3(position(rng), position(rng), position(rng)));
+                p.w += i % 3 == 0 ? wOffset(rng) : 0.0f;
+                objects.addObject(static_cast<int>(rng() % 2), p);
+            }
+            PacketScene scene = makePacketScene(objects);
+
+            for (int packet = 0; packet < packets; packet++) {
+                alignas(32) float px[SDF_PACKET_WIDTH], py[SDF_PACKET_WIDTH], pz[SDF_PACKET_WIDTH];
+                for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+                    px[lane] = position(rng) * 1.5f;
+                    py[lane] = position(rng) * 1.5f;
+                    pz[lane] = position(rng) * 1.5f;
+                }
+                // Every other packet with a random subset of lanes
+                unsigned laneMask = packet % 2 == 0 ? 0xffu : static_cast<unsigned>(rng() % 255 + 1);
+                for (int mode = PACKET_MIN_DISTANCE; mode <= PACKET_BLENDED_DISTANCE; mode++) {
+                    alignas(32) float expected[SDF_PACKET_WIDTH], actual[SDF_PACKET_WIDTH];
+                    reference.packetDistance(scene, px, py, pz, laneMask, mode, expected);
+                    kernels.packetDistance(scene, px, py, pz, laneMask, mode, actual);
+                    for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+                        if (!(laneMask & (1u << lane))) continue;
+                        compared++;
+                        if (!sameBits(expected[lane], actual[lane])) {
+                            if (levelMismatches < 10) {
+                                std::printf("%s packet mode %d, %d objects, lane %d: %.9g vs scalar %.9g\n", kernels.name,
+                                            mode, objectCount, lane, actual[lane], expected[lane]);
+                            }
+                            levelMismatches++;
+                        }
+                    }
+                }
+                glm::vec3 p(px[0], py[0], pz[0]);
+                float expected = reference.pointDistance(scene, p);
+                float actual = kernels.pointDistance(scene, p);
+                compared++;
+                if (!sameBits(expected, actual)) {
+                    if (levelMismatches < 10) {
+                        std::printf("%s point, %d objects: %.9g vs scalar %.9g\n", kernels.name, objectCount, actual,
+                                    expected);
+                    }
+                    levelMismatches++;
+                }
+            }
+        }
+        std::printf("%-6s %lld distances compared, %d mismatches\n", kernels.name, compared, levelMismatches);
+        mismatches += levelMismatches;
+    }
+    return mismatches;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--check-kernels") == 0) {
+        return checkKernels() == 0 ? 0 : 1;
+    }
+    int maxObjects = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    std::printf("%8s %12s %12s %12s %12s %10s %12s %12s\n", "objects", "all-pairs", "full", "pruned-scan",
+                "pruned-bvh", "max-error", "frame-full", "frame-pruned");
+    std::printf("%8s %12s %12s %12s %12s %10s %12s %12s\n", "", "ns/eval", "ns/eval", "ns/eval", "ns/eval", "",
+                "ms", "ms");
+
+    for (int objectCount = 10; objectCount <= maxObjects; objectCount *= 10) {
+        // Constant density: the scene grows with the cube root of the object count
+        std::mt19937 rng(1234);
+        float extent = 2.0f * std::cbrt(objectCount / 10.0f);
+        std::uniform_real_distribution<float> position(-extent, extent);
+        ObjectManager objects;
+        for (int i = 0; i < objectCount; i++) {
+            glm::vec3 p(position(rng), position(rng), position(rng));
+            objects.addObject(i % 2, getrealcoord(p));
+        }
+        SceneBVH bvh;
+        bvh.build(objects);
+
+        std::vector<glm::vec3> samples(4096);
+        for (auto& sample : samples) {
+            sample = glm::vec3(position(rng), position(rng), position(rng));
+        }
+
+        // Fewer samples for the slow methods so every column takes about the same time
+        double pairs = static_cast<double>(objectCount) * objectCount;
+        int allPairsSamples = objectCount <= 10000 ? static_cast<int>(std::min(4096.0, std::max(1.0, 4e7 / pairs))) : 0;
+        int linearSamples = std::min(4096, std::max(16, 4096 * 1000 / objectCount));
+
+        std::vector<float> dists(objectCount);
+        float maxError = 0.0f;
+        volatile float sink = 0.0f;
+
+        double allPairsNs = -1.0;
+        if (allPairsSamples > 0) {
+            auto start = std::chrono::steady_clock::now();
+            for (int s = 0; s < allPairsSamples; s++) {
+                sink = sink + allPairsDistance(objects, samples[s], dists);
+            }
+            allPairsNs = secondsSince(start) * 1e9 / allPairsSamples;
+
+            for (int s = 0; s < allPairsSamples; s++) {
+                float reference = allPairsDistance(objects, samples[s], dists);
+                maxError = std::max(maxError, std::fabs(reference - bvh.blendedDistance(samples[s]).distance));
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int s = 0; s < linearSamples; s++) {
+            sink = sink + fullDistance(objects, samples[s]);
+        }
+        double fullNs = secondsSince(start) * 1e9 / linearSamples;
+
+        start = std::chrono::steady_clock::now();
+        for (int s = 0; s < linearSamples; s++) {
+            sink = sink + prunedScanDistance(objects, samples[s]);
+        }
+        double scanNs = secondsSince(start) * 1e9 / linearSamples;
+
+        start = std::chrono::steady_clock::now();
+        for (int s = 0; s < 4096; s++) {
+            sink = sink + bvh.blendedDistance(samples[s]).distance;
+        }
+        double bvhNs = secondsSince(start) * 1e9 / 4096;
+
+        for (int s = 0; s < linearSamples; s++) {
+            float full = fullDistance(objects, samples[s]);
+            maxError = std::max(maxError, std::fabs(full - prunedScanDistance(objects, samples[s])));
+            maxError = std::max(maxError, std::fabs(full - bvh.blendedDistance(samples[s]).distance));
+        }
+
+        // Whole frames from the middle of the scene (the full blend only while it is still practical)
+        CPURenderer renderer;
+        CPUCamera camera = {glm::vec3(0.0f), 0.0f, 0.0f};
+        const int width = 160, height = 120;
+        std::vector<unsigned char> rgba(width * height * 4);
+        double frameFullMs = -1.0;
+        if (objectCount <= 1000) {
+            renderer.setBlendMode(BLEND_FULL);
+            frameFullMs = renderer.render(objects, camera, rgba.data(), width, height).seconds * 1e3;
+        }
+        renderer.setBlendMode(BLEND_PRUNED);
+        double framePrunedMs = renderer.render(objects, camera, rgba.data(), width, height).seconds * 1e3;
+
+        char allPairsText[32] = "-", frameFullText[32] = "-";
+        if (allPairsNs >= 0.0) std::snprintf(allPairsText, sizeof(allPairsText), "%.0f", allPairsNs);
+        if (frameFullMs >= 0.0) std::snprintf(frameFullText, sizeof(frameFullText), "%.1f", frameFullMs);
+        std::printf("%8d %12s %12.0f %12.0f %12.0f %10.2g %12s %12.1f\n", objectCount, allPairsText, fullNs,
+                    scanNs, bvhNs, maxError, frameFullText, framePrunedMs);
+    }
+
+    return 0;
+}
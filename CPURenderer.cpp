@@ -0,0 +1,309 @@
+#include "CPURenderer.h"
+#include <chrono>
+
+// Below this many objects, pruned blending marches with the packet kernels over all objects
+// (same distances) and only shading goes through the candidate set; the BVH pays off above it
+static const int PRUNED_BVH_MIN_OBJECTS = 512;
+
+CPURenderer::CPURenderer(int workerCount) : m_pool(workerCount), m_tileSize(32), m_kernels(&getPacketKernels()),
+    m_blendMode(BLEND_PRUNED), m_conePrepass(true), m_debugView(DEBUG_VIEW_SHADED), m_useBVH(false), m_objects(nullptr),
+    m_cameraPos(0.0f), m_target(nullptr), m_width(0), m_height(0), m_tilesX(0), m_coneTilesX(0), m_coneTilesY(0) {
+    m_workerSteps.resize(m_pool.getWorkerCount());
+    m_workerConeSteps.resize(m_pool.getWorkerCount());
+}
+
+void CPURenderer::setTileSize(int size) {
+    m_tileSize = size > 0 ? size : 1;
+}
+
+void CPURenderer::setSimdLevel(SimdLevel level) {
+    m_kernels = &getPacketKernels(level);
+}
+
+void CPURenderer::setBlendMode(BlendMode mode) {
+    m_blendMode = mode;
+}
+
+void CPURenderer::setConePrepassEnabled(bool enabled) {
+    m_conePrepass = enabled;
+}
+
+void CPURenderer::setDebugView(DebugView view) {
+    m_debugView = view;
+}
+
+int CPURenderer::getWorkerCount() const {
+    return m_pool.getWorkerCount();
+}
+
+CPURenderStats CPURenderer::render(const ObjectManager& objects, const CPUCamera& camera,
+                                   unsigned char* rgba, int width, int height) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Workers read the struct-of-arrays object data directly
+    m_objects = &objects;
+    m_scene = makePacketScene(objects);
+    m_useBVH = m_blendMode == BLEND_PRUNED && objects.getObjectCount() >= PRUNED_BVH_MIN_OBJECTS;
+    if (m_useBVH) {
+        m_bvh.update(objects);
+    }
+
+    m_basis = computeViewBasis(camera.horizontalAngle, camera.verticalAngle);
+    m_cameraPos = camera.position;
+    m_target = rgba;
+    m_width = width;
+    m_height = height;
+    m_tilesX = (width + m_tileSize - 1) / m_tileSize;
+    int tilesY = (height + m_tileSize - 1) / m_tileSize;
+    int tileCount = m_tilesX * tilesY;
+    std::fill(m_workerSteps.begin(), m_workerSteps.end(), 0);
+    std::fill(m_workerConeSteps.begin(), m_workerConeSteps.end(), 0);
+
+    // Cone pre-pass, then the full-resolution tiles starting from its depths
+    m_coneDepth.clear();
+    if (m_conePrepass) {
+        m_coneTilesX = (width + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE;
+        m_coneTilesY = (height + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE;
+        m_coneDepth.resize(static_cast<size_t>(m_coneTilesX) * m_coneTilesY);
+        m_pool.parallelFor(m_coneTilesY, &CPURenderer::coneRowTask, this);
+    }
+
+    m_pool.parallelFor(tileCount, &CPURenderer::renderTileTask, this);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    CPURenderStats stats;
+    stats.width = width;
+    stats.height = height;
+    stats.tileCount = tileCount;
+    stats.workerCount = m_pool.getWorkerCount();
+    stats.stolenTiles = m_pool.getLastStealCount();
+    stats.rays = static_cast<long long>(width) * height;
+    stats.steps = 0;
+    stats.coneSteps = 0;
+    for (size_t worker = 0; worker < m_workerSteps.size(); worker++) {
+        stats.steps += m_workerSteps[worker];
+        stats.coneSteps += m_workerConeSteps[worker];
+    }
+    stats.stepsPerRay = stats.rays > 0 ? static_cast<double>(stats.steps + stats.coneSteps) / stats.rays : 0.0;
+    stats.seconds = seconds;
+    stats.raysPerSecond = seconds > 0.0 ? stats.rays / seconds : 0.0;
+    return stats;
+}
+
+void CPURenderer::renderTileTask(void* context, int tileIndex, int workerIndex) {
+    static_cast<CPURenderer*>(context)->renderTile(tileIndex, workerIndex);
+}
+
+void CPURenderer::coneRowTask(void* context, int row, int workerIndex) {
+    static_cast<CPURenderer*>(context)->coneRow(row, workerIndex);
+}
+
+void CPURenderer::coneRow(int row, int workerIndex) {
+    float coneSlope = coneSlopeForTile(SDF_CONE_TILE_SIZE, m_height);
+    auto sceneDistance = [this](const glm::vec3& p) { return sdfScene(p).distance; };
+    long long steps = 0;
+
+    for (int column = 0; column < m_coneTilesX; column++) {
+        // Centre ray of the tile, as the shader's pre-pass fragment at (column, row)
+        glm::vec3 rd = cameraRay((column + 0.5f) * SDF_CONE_TILE_SIZE, (row + 0.5f) * SDF_CONE_TILE_SIZE);
+        int tileSteps = 0;
+        m_coneDepth[static_cast<size_t>(row) * m_coneTilesX + column] =
+            coneMarch(sceneDistance, m_cameraPos, rd, coneSlope, tileSteps);
+        steps += tileSteps;
+    }
+    m_workerConeSteps[workerIndex] += steps;
+}
+
+glm::vec3 CPURenderer::cameraRay(float fragX, float fragY) const {
+    float aspect = static_cast<float>(m_width) / static_cast<float>(m_height);
+    float uvX = ((fragX / m_width) * 2.0f - 1.0f) * aspect;
+    float uvY = (fragY / m_height) * 2.0f - 1.0f;
+    return glm::normalize(m_basis.forward + uvX * m_basis.right + uvY * m_basis.up);
+}
+
+void CPURenderer::renderTile(int tileIndex, int workerIndex) {
+    int x0 = (tileIndex % m_tilesX) * m_tileSize;
+    int y0 = (tileIndex / m_tilesX) * m_tileSize;
+    int x1 = std::min(x0 + m_tileSize, m_width);
+    int y1 = std::min(y0 + m_tileSize, m_height);
+    float aspect = static_cast<float>(m_width) / static_cast<float>(m_height);
+
+    RayPacket packet;
+    float uvX[SDF_PACKET_WIDTH];
+    long long steps = 0;
+
+    for (int y = y0; y < y1; y++) {
+        // Buffer rows are top-down, gl_FragCoord rows are bottom-up
+        float fragY = static_cast<float>(m_height - 1 - y) + 0.5f;
+        float uvY = (fragY / m_height) * 2.0f - 1.0f;
+        unsigned char* row = m_target + (static_cast<size_t>(y) * m_width) * 4;
+        const float* coneRow = m_coneDepth.empty() ? nullptr
+            : &m_coneDepth[static_cast<size_t>((m_height - 1 - y) / SDF_CONE_TILE_SIZE) * m_coneTilesX];
+
+        for (int packetX = x0; packetX < x1; packetX += SDF_PACKET_WIDTH) {
+            // One ray per lane for consecutive pixels of the row
+            packet.laneMask = 0;
+            for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+                int x = packetX + lane;
+                float fragX = static_cast<float>(x) + 0.5f;
+                uvX[lane] = ((fragX / m_width) * 2.0f - 1.0f) * aspect;
+                glm::vec3 rd = glm::normalize(m_basis.forward + uvX[lane] * m_basis.right + uvY * m_basis.up);
+                packet.ox[lane] = m_cameraPos.x;
+                packet.oy[lane] = m_cameraPos.y;
+                packet.oz[lane] = m_cameraPos.z;
+                packet.dx[lane] = rd.x;
+                packet.dy[lane] = rd.y;
+                packet.dz[lane] = rd.z;
+                packet.tStart[lane] = coneRow && x < x1 ? coneRow[x / SDF_CONE_TILE_SIZE] : 0.0f;
+                if (x < x1) {
+                    packet.laneMask |= 1u << lane;
+                }
+            }
+
+            if (m_useBVH) {
+                for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+                    if (packet.laneMask & (1u << lane)) {
+                        packet.t[lane] = raymarchPruned(glm::vec3(packet.ox[lane], packet.oy[lane], packet.oz[lane]),
+                                                        glm::vec3(packet.dx[lane], packet.dy[lane], packet.dz[lane]),
+                                                        packet.tStart[lane], packet.steps[lane]);
+                    }
+                }
+            } else {
+                raymarchPacket(*m_kernels, m_scene, PACKET_BLENDED_DISTANCE, packet);
+            }
+
+            for (int lane = 0; lane < SDF_PACKET_WIDTH && packetX + lane < x1; lane++) {
+                glm::vec3 color;
+                float t = packet.t[lane];
+                steps += packet.steps[lane];
+                if (m_debugView == DEBUG_VIEW_STEPS) {
+                    color = stepHeatmap(packet.steps[lane]);
+                } else if (t > 0.0f) {
+                    glm::vec3 p = glm::vec3(packet.ox[lane], packet.oy[lane], packet.oz[lane]) +
+                                  glm::vec3(packet.dx[lane], packet.dy[lane], packet.dz[lane]) * t;
+                    bool centerRay = std::fabs(uvX[lane]) < 0.01f && std::fabs(uvY) < 0.01f;
+                    color = shadeHit(p, centerRay);
+                } else {
+                    color = shadeMiss(uvX[lane], uvY);
+                }
+
+                unsigned char* out = row + (packetX + lane) * 4;
+                out[0] = static_cast<unsigned char>(std::lround(glm::clamp(color.x, 0.0f, 1.0f) * 255.0f));
+                out[1] = static_cast<unsigned char>(std::lround(glm::clamp(color.y, 0.0f, 1.0f) * 255.0f));
+                out[2] = static_cast<unsigned char>(std::lround(glm::clamp(color.z, 0.0f, 1.0f) * 255.0f));
+                out[3] = 255;
+            }
+        }
+    }
+    m_workerSteps[workerIndex] += steps;
+}
+
+// Combined SDF with every object blended, as the shader's sdfSceneFull
+BlendResult CPURenderer::sdfSceneFull(const glm::vec3& p) const {
+    const PacketScene& scene = m_scene;
+    SmoothBlender blender;
+    for (int i = 0; i < scene.count; i++) {
+        blender.add(i, sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]));
+    }
+    return blender.result;
+}
+
+// Objects near p for the pruned blend, from the BVH or a scan over all objects
+void CPURenderer::gatherBlendCandidates(const glm::vec3& p, BlendCandidates& candidates) const {
+    if (m_useBVH) {
+        m_bvh.gatherBlendCandidates(p, candidates);
+        return;
+    }
+
+    const PacketScene& scene = m_scene;
+    candidates.reset();
+    for (int i = 0; i < scene.count; i++) {
+        candidates.add(i, sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]));
+    }
+}
+
+// Scene SDF in the selected blend mode, as the shader's sdfScene
+BlendResult CPURenderer::sdfScene(const glm::vec3& p) const {
+    if (m_blendMode == BLEND_PRUNED) {
+        BlendCandidates candidates;
+        gatherBlendCandidates(p, candidates);
+        return candidates.blend();
+    }
+    return sdfSceneFull(p);
+}
+
+// Raymarch one ray through the pruned scene distance (same limits as the shader)
+float CPURenderer::raymarchPruned(const glm::vec3& ro, const glm::vec3& rd, float tStart, int& steps) const {
+    float t = tStart;
+    steps = 0;
+    if (t > SDF_FAR_PLANE) return -1.0f;
+    for (int i = 0; i < SDF_MAX_STEPS; i++) {
+        float d = m_bvh.blendedDistance(ro + rd * t).distance;
+        steps++;
+        if (d < SDF_HIT_EPSILON) return t;
+        t += d;
+        if (t > SDF_FAR_PLANE) return -1.0f;
+    }
+    return -1.0f;
+}
+
+glm::vec3 CPURenderer::objectGradient(int object, const glm::vec3& p) const {
+    const PacketScene& scene = m_scene;
+    return sdfPrimitiveGradient(scene.types[object], p - glm::vec3(scene.x[object], scene.y[object], scene.z[object]),
+                                scene.size[object]);
+}
+
+glm::vec3 CPURenderer::objectColor(int object) const {
+    return getObjectColor(m_scene.types[object], m_objects->isObjectSelected(object));
+}
+
+// Distance, analytic normal, blended colour and hit object from one scene evaluation,
+// as the shader's evaluateScene
+SDFSample CPURenderer::evaluateScene(const glm::vec3& p) const {
+    BlendResult blend = sdfScene(p);
+    SDFSample result;
+    result.distance = blend.distance;
+    result.objectIndex = blend.nearestDist < 0.01f ? blend.nearestObject : -1;
+    result.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    result.color = glm::vec3(0.0f);
+    if (blend.objectA < 0) {
+        return result;
+    }
+
+    glm::vec3 gradient = objectGradient(blend.objectA, p);
+    result.color = objectColor(blend.objectA);
+    if (blend.objectB >= 0) {
+        glm::vec2 weights = smoothMinWeight(blend.distA, blend.distB, SDF_BLEND_K);
+        glm::vec2 gradientWeights = smoothMinGradientWeight(blend.distA, blend.distB, SDF_BLEND_K);
+        result.color = result.color * weights.x + objectColor(blend.objectB) * weights.y;
+        gradient = gradient * gradientWeights.x + objectGradient(blend.objectB, p) * gradientWeights.y;
+    }
+    result.normal = glm::normalize(gradient);
+    return result;
+}
+
+// Colour of a hit pixel, as in the fragment shader's main()
+glm::vec3 CPURenderer::shadeHit(const glm::vec3& p, bool centerRay) const {
+    SDFSample hit = evaluateScene(p);
+    glm::vec3 baseColor = hit.color;
+
+    // Object under the crosshair is highlighted in blue
+    if (hit.objectIndex >= 0 && centerRay && !m_objects->isObjectSelected(hit.objectIndex)) {
+        baseColor = glm::vec3(0.2f, 0.4f, 0.9f);
+    }
+
+    // Lighting: fixed light at (2, 2, 2)
+    glm::vec3 lightDir = glm::normalize(glm::vec3(2.0f, 2.0f, 2.0f) - p);
+    float diffuse = std::max(glm::dot(hit.normal, lightDir), 0.0f);
+    return baseColor * diffuse + glm::vec3(0.1f);
+}
+
+// Colour of a pixel whose ray missed: crosshair or dark blue background
+glm::vec3 CPURenderer::shadeMiss(float uvX, float uvY) const {
+    float uvLength = std::sqrt(uvX * uvX + uvY * uvY);
+    if (uvLength < 0.02f && (std::fabs(uvX) < 0.005f || std::fabs(uvY) < 0.005f)) {
+        return glm::vec3(1.0f);
+    }
+    return glm::vec3(0.0f, 0.0f, 0.2f);
+}
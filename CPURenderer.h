@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SDFMath.h"
+#include "SDFPacket.h"
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+
+// Camera used by the CPU renderer: 3D (mapped) position plus look angles
+struct CPUCamera {
+    glm::vec3 position;
+    float horizontalAngle;
+    float verticalAngle;
+};
+
+// Timing and throughput of one CPU frame
+struct CPURenderStats {
+    int width;
+    int height;
+    int tileCount;
+    int workerCount;
+    int stolenTiles;       // Tiles that ran on a worker other than their initial owner
+    long long rays;        // Primary rays traced
+    long long steps;       // Distance evaluations of the full-resolution raymarch
+    long long coneSteps;   // Distance evaluations of the cone pre-pass
+    double stepsPerRay;    // Both passes, per primary ray
+    double seconds;        // Wall time of the frame
+    double raysPerSecond;
+};
+
+// Headless renderer that reproduces the fragment shader on the CPU.
+// The framebuffer is split into square tiles which are scheduled across all cores
+// by a work-stealing thread pool. Rows are marched as 8-ray packets over all objects;
+// with pruned blending of large scenes, each ray instead only visits the objects a BVH
+// finds near it, so the cost grows with the local density rather than the object count.
+class CPURenderer {
+public:
+    // Constructor (0 = one worker per hardware thread)
+    explicit CPURenderer(int workerCount = 0);
+
+    // Set the tile edge length in pixels
+    void setTileSize(int size);
+
+    // Force the packet kernels of a given instruction set (defaults to the best available)
+    void setSimdLevel(SimdLevel level);
+
+    // Smooth-min blend mode (pruned by default, like the shader)
+    void setBlendMode(BlendMode mode);
+
+    // Cone pre-pass seeding each ray's start distance, as in the shader (on by default)
+    void setConePrepassEnabled(bool enabled);
+
+    // Shaded output or the raymarch step heatmap
+    void setDebugView(DebugView view);
+
+    // Render the scene into rgba (width * height * 4 bytes, top row first)
+    CPURenderStats render(const ObjectManager& objects, const CPUCamera& camera,
+                          unsigned char* rgba, int width, int height);
+
+    // Number of worker threads used for rendering
+    int getWorkerCount() const;
+
+private:
+    // Pool callback: renders one tile
+    static void renderTileTask(void* context, int tileIndex, int workerIndex);
+    void renderTile(int tileIndex, int workerIndex);
+
+    // Pool callback: cone-marches one row of pre-pass tiles into m_coneDepth
+    static void coneRowTask(void* context, int row, int workerIndex);
+    void coneRow(int row, int workerIndex);
+
+    // Camera ray through a point given in gl_FragCoord pixels
+    glm::vec3 cameraRay(float fragX, float fragY) const;
+
+    // Shader mirrors, evaluated against m_scene (full) or m_bvh (pruned)
+    BlendResult sdfSceneFull(const glm::vec3& p) const;
+    void gatherBlendCandidates(const glm::vec3& p, BlendCandidates& candidates) const;
+    BlendResult sdfScene(const glm::vec3& p) const;
+    float raymarchPruned(const glm::vec3& ro, const glm::vec3& rd, float tStart, int& steps) const;
+    glm::vec3 objectGradient(int object, const glm::vec3& p) const;
+    glm::vec3 objectColor(int object) const;
+    SDFSample evaluateScene(const glm::vec3& p) const;
+    glm::vec3 shadeHit(const glm::vec3& p, bool centerRay) const;
+    glm::vec3 shadeMiss(float uvX, float uvY) const;
+
+    ThreadPool m_pool;
+    int m_tileSize;
+    const PacketKernels* m_kernels;
+    BlendMode m_blendMode;
+    bool m_conePrepass;
+    DebugView m_debugView;
+
+    // Hierarchy for pruned blending of large scenes, kept in sync with the objects between frames
+    SceneBVH m_bvh;
+    bool m_useBVH;   // Pruned queries of this frame go through m_bvh
+
+    // State of the frame being rendered (objects are read in place, they must not change meanwhile)
+    const ObjectManager* m_objects;
+    PacketScene m_scene;
+    ViewBasis m_basis;
+    glm::vec3 m_cameraPos;
+    unsigned char* m_target;
+    int m_width, m_height;
+    int m_tilesX;
+
+    // Cone pre-pass start distances, one per SDF_CONE_TILE_SIZE^2 pixels, bottom row first
+    // like gl_FragCoord (empty when the pre-pass is off)
+    std::vector<float> m_coneDepth;
+    int m_coneTilesX, m_coneTilesY;
+
+    // Step counts per worker, summed into the stats after the frame
+    std::vector<long long> m_workerSteps;
+    std::vector<long long> m_workerConeSteps;
+};
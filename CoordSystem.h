@@ -2,7 +2,8 @@
 #pragma once
 #include <glm/glm.hpp>
 
-// Transforms a 4D point to a 3D point by dropping the w component
+// Transforms a 4D point to a 3D point by dropping the w component (the default
+// ManifoldProjection; the renderer maps objects through its current projection instead)
 inline glm::vec3 getmapcoord(const glm::vec4& point) {
     return glm::vec3(point.x, point.y, point.z);
 }
@@ -0,0 +1,66 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <new>
+
+FrameArena::FrameArena(std::size_t initialBytes)
+    : m_block(nullptr), m_capacity(0), m_offset(0), m_usedBytes(0), m_peakBytes(0) {
+    if (initialBytes > 0) {
+        m_capacity = roundUp(initialBytes);
+        m_block = allocateBlock(m_capacity);
+    }
+}
+
+FrameArena::~FrameArena() {
+    for (char* block : m_overflow) {
+        freeBlock(block);
+    }
+    freeBlock(m_block);
+}
+
+void* FrameArena::allocateBytes(std::size_t bytes) {
+    bytes = roundUp(std::max<std::size_t>(bytes, 1));
+    m_usedBytes += bytes;
+    m_peakBytes = std::max(m_peakBytes, m_usedBytes);
+    if (m_offset + bytes <= m_capacity) {
+        char* pointer = m_block + m_offset;
+        m_offset += bytes;
+        return pointer;
+    }
+
+    // Doesn't fit: give it a block of its own until the next reset
+    if (m_overflow.capacity() == m_overflow.size()) {
+        m_overflow.reserve(std::max<std::size_t>(m_overflow.size() * 2, 8));
+    }
+    char* block = allocateBlock(bytes);
+    m_overflow.push_back(block);
+    return block;
+}
+
+void FrameArena::reset() {
+    if (!m_overflow.empty()) {
+        // Make the main block hold the whole frame, with headroom for frames a bit bigger
+        for (char* block : m_overflow) {
+            freeBlock(block);
+        }
+        m_overflow.clear();
+        freeBlock(m_block);
+        m_capacity = roundUp(m_usedBytes + m_usedBytes / 4);
+        m_block = allocateBlock(m_capacity);
+    }
+    m_offset = 0;
+    m_usedBytes = 0;
+}
+
+std::size_t FrameArena::roundUp(std::size_t bytes) {
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+char* FrameArena::allocateBlock(std::size_t bytes) {
+    return static_cast<char*>(::operator new(bytes, std::align_val_t(ALIGNMENT)));
+}
+
+void FrameArena::freeBlock(char* block) {
+    if (block) {
+        ::operator delete(block, std::align_val_t(ALIGNMENT));
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Bump allocator for scratch data that lives for one frame. Allocating is a pointer bump
+// in one block; reset() at the start of a frame releases everything at once. A frame that
+// outgrows the block spills into extra blocks, and the next reset replaces them all with
+// one block big enough for that whole frame, so once the largest frame has been seen the
+// arena doesn't touch the heap again.
+//
+// Storage is uninitialised and only good for trivially destructible types (nothing is
+// destroyed on reset).
+class FrameArena {
+public:
+    // Alignment of every allocation (one cache line, which also covers SIMD loads)
+    static const std::size_t ALIGNMENT = 64;
+
+    explicit FrameArena(std::size_t initialBytes = 0);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Storage for `count` objects, valid until the next reset
+    template <typename T>
+    T* allocate(std::size_t count) {
+        return static_cast<T*>(allocateBytes(count * sizeof(T)));
+    }
+
+    void* allocateBytes(std::size_t bytes);
+
+    // Release everything allocated since the last reset (and grow the block if it overflowed)
+    void reset();
+
+    // Size of the main block, bytes handed out since the last reset, and the most any frame used
+    std::size_t getCapacity() const { return m_capacity; }
+    std::size_t getUsedBytes() const { return m_usedBytes; }
+    std::size_t getPeakBytes() const { return m_peakBytes; }
+
+private:
+    static std::size_t roundUp(std::size_t bytes);
+    static char* allocateBlock(std::size_t bytes);
+    static void freeBlock(char* block);
+
+    char* m_block;
+    std::size_t m_capacity;
+    std::size_t m_offset;              // Next free byte of the main block
+    std::vector<char*> m_overflow;     // Blocks of allocations that didn't fit this frame
+    std::size_t m_usedBytes;           // Everything handed out this frame, both kinds of block
+    std::size_t m_peakBytes;
+};
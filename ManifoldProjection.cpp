@@ -0,0 +1,203 @@
+#include "ManifoldProjection.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MANIFOLD_PROJECTION_SSE 1
+#endif
+
+ManifoldProjection::ManifoldProjection() {
+    std::memset(m_matrix, 0, sizeof(m_matrix));
+    m_matrix[0][0] = 1.0f;
+    m_matrix[1][1] = 1.0f;
+    m_matrix[2][2] = 1.0f;
+    m_matrix[3][4] = 1.0f;
+    m_affine = true;
+    m_sliceNormal = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+ManifoldProjection ManifoldProjection::slice(const glm::vec4& normal) {
+    ManifoldProjection projection;
+    float length = glm::length(normal);
+    if (!(length > 0.0f)) {
+        return projection;
+    }
+    glm::vec4 n = normal * (1.0f / length);
+
+    // Gram-Schmidt over the axes in order, skipping any that (nearly) lie along the normal
+    // or the axes already taken
+    glm::vec4 basis[3];
+    int found = 0;
+    for (int axis = 0; axis < 4 && found < 3; axis++) {
+        glm::vec4 u(0.0f);
+        u[axis] = 1.0f;
+        u = u - n * glm::dot(u, n);
+        for (int i = 0; i < found; i++) {
+            u = u - basis[i] * glm::dot(u, basis[i]);
+        }
+        float residual = glm::length(u);
+        if (residual > 1e-3f) {
+            basis[found++] = u * (1.0f / residual);
+        }
+    }
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 4; column++) {
+            projection.m_matrix[row][column] = basis[row][column];
+        }
+        projection.m_matrix[row][4] = 0.0f;
+    }
+    projection.updateDerived();
+    return projection;
+}
+
+ManifoldProjection ManifoldProjection::fromMatrix(const float matrix[4][5]) {
+    ManifoldProjection projection;
+    std::memcpy(projection.m_matrix, matrix, sizeof(projection.m_matrix));
+    projection.updateDerived();
+    return projection;
+}
+
+void ManifoldProjection::updateDerived() {
+    m_affine = m_matrix[3][0] == 0.0f && m_matrix[3][1] == 0.0f && m_matrix[3][2] == 0.0f &&
+               m_matrix[3][3] == 0.0f && m_matrix[3][4] == 1.0f;
+
+    // The null space of the 3x4 linear part, from the 4D cross product of its rows
+    // (signed 3x3 minors), pointing towards +w where it has a w component
+    glm::vec4 normal;
+    for (int skip = 0; skip < 4; skip++) {
+        int c[3];
+        for (int column = 0, k = 0; column < 4; column++) {
+            if (column != skip) c[k++] = column;
+        }
+        const float (*m)[5] = m_matrix;
+        float minor = m[0][c[0]] * (m[1][c[1]] * m[2][c[2]] - m[1][c[2]] * m[2][c[1]]) -
+                      m[0][c[1]] * (m[1][c[0]] * m[2][c[2]] - m[1][c[2]] * m[2][c[0]]) +
+                      m[0][c[2]] * (m[1][c[0]] * m[2][c[1]] - m[1][c[1]] * m[2][c[0]]);
+        normal[skip] = skip % 2 == 0 ? minor : -minor;
+    }
+    float length = glm::length(normal);
+    if (!(length > 0.0f)) {
+        m_sliceNormal = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+    m_sliceNormal = normal * ((normal.w < 0.0f ? -1.0f : 1.0f) / length);
+}
+
+glm::vec3 ManifoldProjection::project(const glm::vec4& point, float cameraW) const {
+    float q[4] = {point.x, point.y, point.z, point.w - cameraW};
+    float out[4];
+    for (int row = 0; row < 4; row++) {
+        const float* m = m_matrix[row];
+        out[row] = m[0] * q[0] + m[1] * q[1] + m[2] * q[2] + m[3] * q[3] + m[4];
+    }
+    if (m_affine) {
+        return glm::vec3(out[0], out[1], out[2]);
+    }
+    return glm::vec3(out[0] / out[3], out[1] / out[3], out[2] / out[3]);
+}
+
+void ManifoldProjection::projectBatch(const float* x, const float* y, const float* z, const float* w, int count,
+                                      float cameraW, float* outX, float* outY, float* outZ) const {
+    int i = 0;
+#ifdef MANIFOLD_PROJECTION_SSE
+    // Same operations in the same order as project, so both round identically
+    __m128 m[4][5];
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 5; column++) {
+            m[row][column] = _mm_set1_ps(m_matrix[row][column]);
+        }
+    }
+    __m128 camera = _mm_set1_ps(cameraW);
+    for (; i + 4 <= count; i += 4) {
+        __m128 q0 = _mm_loadu_ps(x + i);
+        __m128 q1 = _mm_loadu_ps(y + i);
+        __m128 q2 = _mm_loadu_ps(z + i);
+        __m128 q3 = _mm_sub_ps(_mm_loadu_ps(w + i), camera);
+        __m128 out[4];
+        for (int row = 0; row < (m_affine ? 3 : 4); row++) {
+            __m128 sum = _mm_mul_ps(m[row][0], q0);
+            sum = _mm_add_ps(sum, _mm_mul_ps(m[row][1], q1));
+            sum = _mm_add_ps(sum, _mm_mul_ps(m[row][2], q2));
+            sum = _mm_add_ps(sum, _mm_mul_ps(m[row][3], q3));
+            out[row] = _mm_add_ps(sum, m[row][4]);
+        }
+        if (!m_affine) {
+            out[0] = _mm_div_ps(out[0], out[3]);
+            out[1] = _mm_div_ps(out[1], out[3]);
+            out[2] = _mm_div_ps(out[2], out[3]);
+        }
+        _mm_storeu_ps(outX + i, out[0]);
+        _mm_storeu_ps(outY + i, out[1]);
+        _mm_storeu_ps(outZ + i, out[2]);
+    }
+#endif
+    for (; i < count; i++) {
+        glm::vec3 p = project(glm::vec4(x[i], y[i], z[i], w[i]), cameraW);
+        outX[i] = p.x;
+        outY[i] = p.y;
+        outZ[i] = p.z;
+    }
+}
+
+glm::vec4 ManifoldProjection::unproject(const glm::vec3& point, const glm::vec4& reference, float cameraW,
+                                        bool keepW) const {
+    // project(q) == point is linear in q once multiplied out by the fourth row:
+    // (M_i - point_i * M_3) . (q, 1) == 0 for i = 0..2, i.e. B q = c. The nearest solution to
+    // the reference is reference + B^T (B B^T)^-1 (c - B reference).
+    double q[4] = {reference.x, reference.y, reference.z, reference.w - cameraW};
+    double rows[3][4];
+    double residual[3];
+    for (int i = 0; i < 3; i++) {
+        residual[i] = point[i] * static_cast<double>(m_matrix[3][4]) - m_matrix[i][4];
+        for (int column = 0; column < 4; column++) {
+            rows[i][column] = keepW && column == 3 ? 0.0 : m_matrix[i][column] - point[i] * static_cast<double>(m_matrix[3][column]);
+            residual[i] -= rows[i][column] * q[column];
+        }
+    }
+
+    // Solve (B B^T) y = residual by Cramer's rule
+    double gram[3][3];
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            gram[a][b] = rows[a][0] * rows[b][0] + rows[a][1] * rows[b][1] + rows[a][2] * rows[b][2] + rows[a][3] * rows[b][3];
+        }
+    }
+    double cofactor[3][3];
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            int a1 = (a + 1) % 3, a2 = (a + 2) % 3, b1 = (b + 1) % 3, b2 = (b + 2) % 3;
+            cofactor[a][b] = gram[a1][b1] * gram[a2][b2] - gram[a1][b2] * gram[a2][b1];
+        }
+    }
+    double determinant = gram[0][0] * cofactor[0][0] + gram[0][1] * cofactor[0][1] + gram[0][2] * cofactor[0][2];
+    if (std::fabs(determinant) < 1e-12) {
+        return reference;
+    }
+    double y[3];
+    for (int a = 0; a < 3; a++) {
+        // The Gram matrix is symmetric, so its inverse is the cofactor matrix over the determinant
+        y[a] = (cofactor[a][0] * residual[0] + cofactor[a][1] * residual[1] + cofactor[a][2] * residual[2]) / determinant;
+    }
+
+    // Added in double so e.g. dropping w gives back exactly the requested coordinates
+    glm::vec4 result;
+    for (int column = 0; column < 4; column++) {
+        double delta = rows[0][column] * y[0] + rows[1][column] * y[1] + rows[2][column] * y[2];
+        result[column] = static_cast<float>(static_cast<double>(reference[column]) + delta);
+    }
+    return result;
+}
+
+float ManifoldProjection::sliceOffset(const glm::vec4& point, float cameraW) const {
+    return m_sliceNormal.x * point.x + m_sliceNormal.y * point.y + m_sliceNormal.z * point.z +
+           m_sliceNormal.w * (point.w - cameraW);
+}
+
+bool ManifoldProjection::dependsOnCameraW() const {
+    return m_matrix[0][3] != 0.0f || m_matrix[1][3] != 0.0f || m_matrix[2][3] != 0.0f || m_matrix[3][3] != 0.0f;
+}
+
+bool ManifoldProjection::operator==(const ManifoldProjection& other) const {
+    return std::memcmp(m_matrix, other.m_matrix, sizeof(m_matrix)) == 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Maps the 4D manifold into the 3D space the scene is rendered in.
+//
+// The map is a 4x5 projective matrix M applied to the camera-relative point
+// q = (x, y, z, w - cameraW, 1): the first three rows give the 3D position, divided by the
+// fourth row (1 for affine maps such as slices). Measuring w from the camera's W means a
+// slice passes through the camera, and moving the camera in W moves the slice with it.
+// The default map drops w, like getmapcoord.
+class ManifoldProjection {
+public:
+    // Drop the w component (getmapcoord)
+    ManifoldProjection();
+
+    // Orthogonal projection onto the hyperplane through the camera with this normal; the
+    // 3D axes are the x, y, z (then w) axes made orthonormal within the hyperplane, so a
+    // normal along w gives the default map
+    static ManifoldProjection slice(const glm::vec4& normal);
+
+    // Arbitrary projective map from a row-major 4x5 matrix
+    static ManifoldProjection fromMatrix(const float matrix[4][5]);
+
+    // Project one 4D point
+    glm::vec3 project(const glm::vec4& point, float cameraW) const;
+
+    // Project `count` points given as separate x, y, z, w arrays into separate 3D arrays,
+    // four points per SSE instruction. Gives exactly the same values as project.
+    void projectBatch(const float* x, const float* y, const float* z, const float* w, int count, float cameraW,
+                      float* outX, float* outY, float* outZ) const;
+
+    // The 4D point nearest to `reference` that projects to `point`. With keepW only x, y
+    // and z move (for the camera, which defines where w is measured from). Returns the
+    // reference if no such point can be reached.
+    glm::vec4 unproject(const glm::vec3& point, const glm::vec4& reference, float cameraW, bool keepW = false) const;
+
+    // Signed distance of a point from the hyperplane the map slices along: the one through
+    // the camera across the direction the map collapses (w for the default map)
+    float sliceOffset(const glm::vec4& point, float cameraW) const;
+
+    // Whether the camera's W moves projected points (it doesn't when the map ignores w)
+    bool dependsOnCameraW() const;
+
+    bool operator==(const ManifoldProjection& other) const;
+    bool operator!=(const ManifoldProjection& other) const { return !(*this == other); }
+
+private:
+    float m_matrix[4][5];
+    bool m_affine;            // Fourth row is (0, 0, 0, 0, 1), so no division
+    glm::vec4 m_sliceNormal;  // Unit direction the first three rows ignore
+
+    // Refresh m_affine and m_sliceNormal after the matrix changed
+    void updateDerived();
+};
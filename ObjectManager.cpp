@@ -1,17 +1,123 @@
 
 #include "ObjectManager.h"
 #include "CoordSystem.h"
+#include "SDFMath.h"
 #include <algorithm>
 
-ObjectManager::ObjectManager() : m_rng(std::random_device{}()) {
+// Entries the change log may hold per object before it is truncated
+static const size_t CHANGE_LOG_ENTRIES_PER_OBJECT = 4;
+
+ObjectManager::ObjectManager() : m_projectionCameraW(7.0f), m_generation(0), m_allChangedGeneration(0), m_changeLogStart(0), m_rng(std::random_device{}()) {
     // Initialize random distribution for [-5, 5] range
     m_dist = std::uniform_real_distribution<float>(-5.0f, 5.0f);
 }
 
+ObjectManager::ObjectManager(unsigned int seed) : m_projectionCameraW(7.0f), m_generation(0), m_allChangedGeneration(0), m_changeLogStart(0), m_rng(seed) {
+    m_dist = std::uniform_real_distribution<float>(-5.0f, 5.0f);
+}
+
 int ObjectManager::addObject(int type, const glm::vec4& position) {
+    int index = static_cast<int>(m_objectTypes.size());
     m_objectTypes.push_back(type);
-    m_positions.push_back(position);
-    return static_cast<int>(m_objectTypes.size() - 1);
+    m_x.push_back(0.0f);
+    m_y.push_back(0.0f);
+    m_z.push_back(0.0f);
+    m_w.push_back(0.0f);
+    m_px.push_back(0.0f);
+    m_py.push_back(0.0f);
+    m_pz.push_back(0.0f);
+    m_sliceSize.push_back(0.0f);
+    storePosition(index, position);
+    
+    if (m_selectedBits.size() * 64 <= static_cast<size_t>(index)) {
+        m_selectedBits.push_back(0);
+    }
+    m_selectedSlot.push_back(-1);
+    
+    m_versions.push_back(0);
+    markChanged(index);
+    return index;
+}
+
+void ObjectManager::addObjects(const int* types, const float* x, const float* y, const float* z, const float* w, int count) {
+    if (count <= 0) {
+        return;
+    }
+    size_t first = m_objectTypes.size();
+    size_t total = first + count;
+    m_objectTypes.insert(m_objectTypes.end(), types, types + count);
+    m_x.insert(m_x.end(), x, x + count);
+    m_y.insert(m_y.end(), y, y + count);
+    m_z.insert(m_z.end(), z, z + count);
+    m_w.insert(m_w.end(), w, w + count);
+    m_px.resize(total);
+    m_py.resize(total);
+    m_pz.resize(total);
+    m_sliceSize.resize(total);
+    m_projection.projectBatch(x, y, z, w, count, m_projectionCameraW,
+                              m_px.data() + first, m_py.data() + first, m_pz.data() + first);
+    for (size_t i = first; i < total; i++) {
+        m_sliceSize[i] = sliceSize(m_objectTypes[i], m_projection.sliceOffset(getObjectPosition(static_cast<int>(i)), m_projectionCameraW));
+    }
+    
+    m_selectedBits.resize((total + 63) / 64, 0);
+    m_selectedSlot.resize(total, -1);
+    m_versions.resize(total, 0);
+    markAllChanged();
+}
+
+void ObjectManager::removeObjects(int first, int count) {
+    int total = getObjectCount();
+    if (first < 0 || count <= 0 || first >= total) {
+        return;
+    }
+    int last = std::min(first + count, total);
+    auto eraseRange = [first, last](auto& values) {
+        values.erase(values.begin() + first, values.begin() + last);
+    };
+    eraseRange(m_objectTypes);
+    eraseRange(m_x);
+    eraseRange(m_y);
+    eraseRange(m_z);
+    eraseRange(m_w);
+    eraseRange(m_px);
+    eraseRange(m_py);
+    eraseRange(m_pz);
+    eraseRange(m_sliceSize);
+    eraseRange(m_versions);
+    
+    // Keep the selected objects that remain, under their new indices
+    std::vector<int> selected;
+    selected.swap(m_selectedObjects);
+    m_selectedBits.assign((m_objectTypes.size() + 63) / 64, 0);
+    m_selectedSlot.assign(m_objectTypes.size(), -1);
+    for (int index : selected) {
+        if (index >= first && index < last) {
+            continue;
+        }
+        int moved = index >= last ? index - (last - first) : index;
+        m_selectedBits[moved >> 6] |= uint64_t(1) << (moved & 63);
+        m_selectedSlot[moved] = static_cast<int>(m_selectedObjects.size());
+        m_selectedObjects.push_back(moved);
+    }
+    markAllChanged();
+}
+
+void ObjectManager::clearObjects() {
+    m_objectTypes.clear();
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_w.clear();
+    m_px.clear();
+    m_py.clear();
+    m_pz.clear();
+    m_sliceSize.clear();
+    m_selectedBits.clear();
+    m_selectedObjects.clear();
+    m_selectedSlot.clear();
+    m_versions.clear();
+    markAllChanged();
 }
 
 int ObjectManager::addRandomObject(int type) {
@@ -44,16 +150,16 @@ int ObjectManager::getObjectType(int index) const {
 }
 
 glm::vec4 ObjectManager::getObjectPosition(int index) const {
-    if (index >= 0 && index < m_positions.size()) {
-        return m_positions[index];
+    if (index >= 0 && index < m_objectTypes.size()) {
+        return glm::vec4(m_x[index], m_y[index], m_z[index], m_w[index]);
     }
     return glm::vec4(0.0f, 0.0f, 0.0f, 7.0f); // Invalid index, use default w=7
 }
 
 glm::vec3 ObjectManager::getObject3DPosition(int index) const {
-    if (index >= 0 && index < m_positions.size()) {
-        // Map 4D position to 3D
-        return getmapcoord(m_positions[index]);
+    if (index >= 0 && index < m_objectTypes.size()) {
+        // Mapped position from the projection cache
+        return glm::vec3(m_px[index], m_py[index], m_pz[index]);
     }
     return glm::vec3(0.0f); // Invalid index
 }
@@ -62,42 +168,88 @@ const int* ObjectManager::getTypesArray() const {
     return m_objectTypes.data();
 }
 
-// This function requires special handling since we store 4D positions but need 3D for shaders
-const float* ObjectManager::getPositionsArray() const {
-    static std::vector<glm::vec3> mappedPositions;
-    mappedPositions.clear();
-    mappedPositions.reserve(m_positions.size());
-    
-    // Map all 4D positions to 3D for the shader
-    for (const auto& pos : m_positions) {
-        mappedPositions.push_back(getmapcoord(pos));
+const float* ObjectManager::getXArray() const {
+    return m_x.data();
+}
+
+const float* ObjectManager::getYArray() const {
+    return m_y.data();
+}
+
+const float* ObjectManager::getZArray() const {
+    return m_z.data();
+}
+
+const float* ObjectManager::getWArray() const {
+    return m_w.data();
+}
+
+const float* ObjectManager::getProjectedXArray() const {
+    return m_px.data();
+}
+
+const float* ObjectManager::getProjectedYArray() const {
+    return m_py.data();
+}
+
+const float* ObjectManager::getProjectedZArray() const {
+    return m_pz.data();
+}
+
+const float* ObjectManager::getSliceSizeArray() const {
+    return m_sliceSize.data();
+}
+
+float ObjectManager::getObjectSliceSize(int index) const {
+    if (index >= 0 && index < m_objectTypes.size()) {
+        return m_sliceSize[index];
     }
-    
-    return reinterpret_cast<const float*>(mappedPositions.data());
+    return SDF_EMPTY_SLICE; // Invalid index
 }
 
 void ObjectManager::selectObject(int index) {
     if (index >= 0 && index < m_objectTypes.size()) {
         // Only add if not already selected
         if (!isObjectSelected(index)) {
+            m_selectedBits[index >> 6] |= uint64_t(1) << (index & 63);
+            m_selectedSlot[index] = static_cast<int>(m_selectedObjects.size());
             m_selectedObjects.push_back(index);
+            markChanged(index);
         }
     }
 }
 
 void ObjectManager::deselectObject(int index) {
-    auto it = std::find(m_selectedObjects.begin(), m_selectedObjects.end(), index);
-    if (it != m_selectedObjects.end()) {
-        m_selectedObjects.erase(it);
+    if (!isObjectSelected(index)) {
+        return;
     }
+    
+    // Move the last selected object into the freed slot
+    int slot = m_selectedSlot[index];
+    int last = m_selectedObjects.back();
+    m_selectedObjects[slot] = last;
+    m_selectedSlot[last] = slot;
+    m_selectedObjects.pop_back();
+    
+    m_selectedSlot[index] = -1;
+    m_selectedBits[index >> 6] &= ~(uint64_t(1) << (index & 63));
+    markChanged(index);
 }
 
 void ObjectManager::clearSelections() {
+    for (int index : m_selectedObjects) {
+        m_selectedBits[index >> 6] &= ~(uint64_t(1) << (index & 63));
+        m_selectedSlot[index] = -1;
+        markChanged(index);
+    }
     m_selectedObjects.clear();
 }
 
 bool ObjectManager::isObjectSelected(int index) const {
-    return std::find(m_selectedObjects.begin(), m_selectedObjects.end(), index) != m_selectedObjects.end();
+    if (index < 0 || index >= m_objectTypes.size()) {
+        return false;
+    }
+    return (m_selectedBits[index >> 6] >> (index & 63)) & 1;
 }
 
 const std::vector<int>& ObjectManager::getSelectedObjects() const {
@@ -109,14 +261,123 @@ int ObjectManager::getSelectedCount() const {
 }
 
 void ObjectManager::setObjectPosition(int index, const glm::vec4& position) {
-    if (index >= 0 && index < m_positions.size()) {
-        m_positions[index] = position;
+    if (index >= 0 && index < m_objectTypes.size() && getObjectPosition(index) != position) {
+        storePosition(index, position);
+        markChanged(index);
     }
 }
 
 void ObjectManager::setObject3DPosition(int index, const glm::vec3& position) {
-    if (index >= 0 && index < m_positions.size()) {
-        // Convert the 3D position to 4D using getrealcoord
-        m_positions[index] = getrealcoord(position);
+    if (index >= 0 && index < m_objectTypes.size()) {
+        setObjectPosition(index, m_projection.unproject(position, getObjectPosition(index), m_projectionCameraW));
+    }
+}
+
+bool ObjectManager::setProjection(const ManifoldProjection& projection, float cameraW) {
+    if (projection == m_projection && cameraW == m_projectionCameraW) {
+        return false;
+    }
+    bool positionsChange = projection != m_projection || projection.dependsOnCameraW();
+    m_projection = projection;
+    m_projectionCameraW = cameraW;
+    int count = getObjectCount();
+    
+    if (!positionsChange) {
+        // Only the slicing hyperplane moved along w: mark the objects whose slice changed
+        for (int i = 0; i < count; i++) {
+            float size = sliceSize(m_objectTypes[i], m_projection.sliceOffset(getObjectPosition(i), cameraW));
+            if (size != m_sliceSize[i]) {
+                m_sliceSize[i] = size;
+                markChanged(i);
+            }
+        }
+        return true;
+    }
+    
+    m_projection.projectBatch(m_x.data(), m_y.data(), m_z.data(), m_w.data(), count, cameraW,
+                              m_px.data(), m_py.data(), m_pz.data());
+    for (int i = 0; i < count; i++) {
+        m_sliceSize[i] = sliceSize(m_objectTypes[i], m_projection.sliceOffset(getObjectPosition(i), cameraW));
+    }
+    
+    // Every object moved
+    markAllChanged();
+    return true;
+}
+
+const ManifoldProjection& ObjectManager::getProjection() const {
+    return m_projection;
+}
+
+float ObjectManager::getProjectionCameraW() const {
+    return m_projectionCameraW;
+}
+
+unsigned long long ObjectManager::getGeneration() const {
+    return m_generation;
+}
+
+unsigned long long ObjectManager::getObjectVersion(int index) const {
+    if (index >= 0 && index < m_versions.size()) {
+        return std::max(m_versions[index], m_allChangedGeneration);
+    }
+    return 0;
+}
+
+bool ObjectManager::getChangedObjects(unsigned long long since, std::vector<int>& changed) const {
+    changed.clear();
+    if (since < m_changeLogStart) {
+        return false;
+    }
+    
+    // Walk back from the newest entry; an entry is the latest for its object only if it
+    // matches the object's version, which skips repeated changes to the same object
+    for (size_t i = m_changeLog.size(); i-- > 0;) {
+        unsigned long long generation = m_changeLogGenerations[i];
+        if (generation <= since) {
+            break;
+        }
+        int index = m_changeLog[i];
+        if (m_versions[index] == generation) {
+            changed.push_back(index);
+        }
+    }
+    return true;
+}
+
+void ObjectManager::storePosition(int index, const glm::vec4& position) {
+    m_x[index] = position.x;
+    m_y[index] = position.y;
+    m_z[index] = position.z;
+    m_w[index] = position.w;
+    
+    glm::vec3 mapped = m_projection.project(position, m_projectionCameraW);
+    m_px[index] = mapped.x;
+    m_py[index] = mapped.y;
+    m_pz[index] = mapped.z;
+    m_sliceSize[index] = sliceSize(m_objectTypes[index], m_projection.sliceOffset(position, m_projectionCameraW));
+}
+
+void ObjectManager::markChanged(int index) {
+    m_generation++;
+    m_versions[index] = m_generation;
+    
+    // Keep the log bounded; consumers that fall behind the start get a full update
+    if (m_changeLog.size() >= CHANGE_LOG_ENTRIES_PER_OBJECT * m_objectTypes.size() + 64) {
+        m_changeLog.clear();
+        m_changeLogGenerations.clear();
+        m_changeLogStart = m_generation - 1;
     }
+    m_changeLog.push_back(index);
+    m_changeLogGenerations.push_back(m_generation);
+}
+
+void ObjectManager::markAllChanged() {
+    // Bump every object (through m_allChangedGeneration, so this doesn't touch each one)
+    // and empty the log, so consumers do a full update
+    m_generation++;
+    m_allChangedGeneration = m_generation;
+    m_changeLog.clear();
+    m_changeLogGenerations.clear();
+    m_changeLogStart = m_generation;
 }
@@ -3,6 +3,9 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <random>
+#include <cstdint>
+#include "AlignedAllocator.h"
+#include "ManifoldProjection.h"
 
 // Handles the storage and management of SDF objects using struct of arrays pattern
 class ObjectManager {
@@ -10,9 +13,23 @@ public:
     // Constructor
     ObjectManager();
     
+    // Constructor with a fixed seed for the random object placement (reproducible scenes)
+    explicit ObjectManager(unsigned int seed);
+    
     // Add a new object with specified type and position
     int addObject(int type, const glm::vec4& position);
     
+    // Append `count` objects given as separate type and x, y, z, w arrays in one batch
+    // (projected together, and counted as a change to every object)
+    void addObjects(const int* types, const float* x, const float* y, const float* z, const float* w, int count);
+    
+    // Remove objects [first, first + count); later objects move down to fill the gap.
+    // Counted as a change to every object.
+    void removeObjects(int first, int count);
+    
+    // Remove every object (and the selection)
+    void clearObjects();
+    
     // Add a randomly positioned object of the given type
     int addRandomObject(int type);
     
@@ -31,11 +48,26 @@ public:
     // Get object 3D position at index (after mapping from 4D)
     glm::vec3 getObject3DPosition(int index) const;
     
-    // Get types array pointer for shader uniform
+    // Get types array pointer (getObjectCount() entries)
     const int* getTypesArray() const;
     
-    // Get positions array pointer for shader uniform (3D mapped positions)
-    const float* getPositionsArray() const;
+    // Per-component 4D position arrays (32-byte aligned, getObjectCount() entries each)
+    const float* getXArray() const;
+    const float* getYArray() const;
+    const float* getZArray() const;
+    const float* getWArray() const;
+    
+    // Per-component 3D mapped position arrays, kept in sync with the 4D positions through
+    // the current projection
+    const float* getProjectedXArray() const;
+    const float* getProjectedYArray() const;
+    const float* getProjectedZArray() const;
+    
+    // Size of every object's 3D slice at the camera's W (sliceSize: sphere radius or cube
+    // half side, SDF_EMPTY_SLICE where the slice misses the object), kept in sync like the
+    // projected positions
+    const float* getSliceSizeArray() const;
+    float getObjectSliceSize(int index) const;
     
     // Select an object by index
     void selectObject(int index);
@@ -58,14 +90,62 @@ public:
     // Set position of an object (4D)
     void setObjectPosition(int index, const glm::vec4& position);
     
-    // Set position of an object using 3D position (will be unmapped to 4D)
+    // Set position of an object using 3D position (unmapped to the nearest 4D position
+    // that projects there)
     void setObject3DPosition(int index, const glm::vec3& position);
     
+    // Map the objects through this projection from the camera's W, and slice them at it.
+    // Reprojects every object in one batch, counting as a change to all of them, when the
+    // projected positions can differ; when only the slices move (a new camera W with a map
+    // that ignores w), only objects whose slice size changed are marked. Returns whether
+    // anything was recomputed. Cheap to call every frame.
+    bool setProjection(const ManifoldProjection& projection, float cameraW);
+    
+    const ManifoldProjection& getProjection() const;
+    float getProjectionCameraW() const;
+    
+    // Scene generation: incremented on every change to object data (add, move, selection)
+    unsigned long long getGeneration() const;
+    
+    // Generation at which an object last changed
+    unsigned long long getObjectVersion(int index) const;
+    
+    // Collect the indices of objects changed after generation `since` (each index once).
+    // Returns false if the change log no longer reaches back that far, in which case the
+    // caller has to treat every object as changed.
+    bool getChangedObjects(unsigned long long since, std::vector<int>& changed) const;
+    
 private:
+    // Record a change to an object and bump the generation
+    void markChanged(int index);
+    
+    // Record a change to every object at once, so consumers do a full update
+    void markAllChanged();
+    
+    // Store a 4D position and refresh the object's 3D projection and slice
+    void storePosition(int index, const glm::vec4& position);
+    
     // Struct of Arrays pattern for object data
-    std::vector<int> m_objectTypes;     // 0 = sphere, 1 = cube
-    std::vector<glm::vec4> m_positions; // Object positions (4D)
-    std::vector<int> m_selectedObjects; // List of indices of selected objects
+    AlignedVector<int> m_objectTypes;       // 0 = sphere, 1 = cube
+    AlignedVector<float> m_x, m_y, m_z, m_w; // Object positions (4D)
+    AlignedVector<float> m_px, m_py, m_pz;   // Projection cache: positions mapped to 3D
+    AlignedVector<float> m_sliceSize;        // Slice sizes at the camera's W
+    ManifoldProjection m_projection;         // Map the projection cache was filled with
+    float m_projectionCameraW;               // Camera W it was filled for
+    
+    // Selection set: bitset for O(1) membership, compact list for iteration and
+    // each object's slot in that list for O(1) removal
+    std::vector<uint64_t> m_selectedBits;
+    std::vector<int> m_selectedObjects;  // List of indices of selected objects
+    std::vector<int> m_selectedSlot;     // Index into m_selectedObjects, -1 if not selected
+    
+    // Change tracking
+    unsigned long long m_generation;              // Current scene generation
+    std::vector<unsigned long long> m_versions;   // Generation of each object's last change
+    unsigned long long m_allChangedGeneration;    // Last change to every object (newer than m_versions where set)
+    std::vector<int> m_changeLog;                 // Changed object indices, oldest first
+    std::vector<unsigned long long> m_changeLogGenerations; // Generation of each log entry
+    unsigned long long m_changeLogStart;          // Changes after this generation are all in the log
     
     // Random number generator
     std::mt19937 m_rng;
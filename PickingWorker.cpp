@@ -0,0 +1,130 @@
+#include "PickingWorker.h"
+
+PickingWorker::PickingWorker() : m_front(-1), m_publishedGeneration(0), m_indexEpoch(0), m_bufferEpochs(), m_requestOrigin(0.0f),
+    m_requestDirection(0.0f, 0.0f, 1.0f), m_requestPending(false), m_sceneChanged(false), m_stopping(false),
+    m_lastOrigin(0.0f), m_lastDirection(0.0f, 0.0f, 1.0f), m_hasRay(false), m_result(0xffffffffull), m_completedPicks(0) {
+    m_buffers[0] = std::make_shared<ObjectManager>();
+    m_buffers[1] = std::make_shared<ObjectManager>();
+    m_thread = std::thread(&PickingWorker::workerLoop, this);
+}
+
+PickingWorker::~PickingWorker() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+bool PickingWorker::publishScene(const ObjectManager& objects) {
+    if (m_front >= 0 && objects.getGeneration() == m_publishedGeneration && m_bufferEpochs[m_front] == m_indexEpoch) {
+        return true;
+    }
+
+    // The back buffer may still be held by the worker from when it was the front one.
+    // Only the published pointer can hand out new references, so once the count is
+    // down to ours it stays there until we publish it again.
+    int back = m_front == 0 ? 1 : 0;
+    if (m_buffers[back].use_count() > 1) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire); // Pairs with the worker's release of its reference
+
+    // Assignment reuses the buffer's storage, so steady-state publishing doesn't allocate
+    *m_buffers[back] = objects;
+    m_bufferEpochs[back] = m_indexEpoch;
+    std::atomic_store(&m_published, std::shared_ptr<const ObjectManager>(m_buffers[back]));
+    m_front = back;
+    m_publishedGeneration = objects.getGeneration();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sceneChanged = true;
+    }
+    m_wake.notify_one();
+    return true;
+}
+
+void PickingWorker::requestPick(const glm::vec3& origin, const glm::vec3& direction) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requestOrigin = origin;
+        m_requestDirection = direction;
+        m_requestPending = true;
+    }
+    m_wake.notify_one();
+}
+
+int PickingWorker::getObjectUnderCursor() const {
+    unsigned long long result = m_result.load(std::memory_order_acquire);
+    if (static_cast<unsigned int>(result >> 32) != m_indexEpoch) {
+        return -1;
+    }
+    return static_cast<int>(static_cast<unsigned int>(result));
+}
+
+void PickingWorker::discardResult() {
+    m_indexEpoch++;
+}
+
+unsigned long long PickingWorker::getCompletedPicks() const {
+    return m_completedPicks.load(std::memory_order_relaxed);
+}
+
+void PickingWorker::workerLoop() {
+    while (true) {
+        glm::vec3 origin, direction;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || m_requestPending || m_sceneChanged; });
+            if (m_stopping) {
+                return;
+            }
+            // A new scene alone re-traces the last ray (the object under it may have moved)
+            if (m_requestPending) {
+                m_lastOrigin = m_requestOrigin;
+                m_lastDirection = m_requestDirection;
+                m_hasRay = true;
+            }
+            origin = m_lastOrigin;
+            direction = m_lastDirection;
+            m_requestPending = false;
+            m_sceneChanged = false;
+        }
+
+        std::shared_ptr<const ObjectManager> snapshot = std::atomic_load(&m_published);
+        if (!snapshot || !m_hasRay) {
+            continue;
+        }
+        // The render thread only rewrites a buffer's epoch while nobody holds the buffer
+        unsigned int epoch = m_bufferEpochs[snapshot.get() == m_buffers[0].get() ? 0 : 1];
+        int result = pick(*snapshot, origin, direction);
+        m_result.store(static_cast<unsigned long long>(epoch) << 32 | static_cast<unsigned int>(result),
+                       std::memory_order_release);
+        m_completedPicks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int PickingWorker::pick(const ObjectManager& objects, const glm::vec3& origin, const glm::vec3& direction) {
+    // Snapshots carry the change log, so objects moved since the last one are only refit
+    m_bvh.update(objects);
+
+    float t = raymarch(origin, direction);
+    if (t > 0.0f) {
+        return m_bvh.closestObject(origin + direction * t, 0.01f);
+    }
+    return -1;
+}
+
+float PickingWorker::raymarch(const glm::vec3& ro, const glm::vec3& rd) const {
+    float t = 0.0f; // Distance along ray
+    for (int i = 0; i < 64; i++) {
+        glm::vec3 p = ro + rd * t; // Current position
+        float d = m_bvh.distance(p); // Distance to scene
+        if (d < 0.001f) return t; // Hit (close enough)
+        t += d; // Step forward
+        if (t > 20.0f) return -1.0f; // Too far, miss
+    }
+    return -1.0f; // Missed after max steps
+}
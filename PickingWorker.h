@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SceneBVH.h"
+
+// Finds the object under the cursor on a background thread, so cursor callbacks and the
+// render loop never wait for a CPU raymarch.
+//
+// The render thread publishes immutable copies of the scene: two ObjectManager buffers
+// alternate, the newest one is handed over with an atomic shared_ptr swap, and a buffer
+// is only overwritten once the worker has let go of it (otherwise publishing waits for a
+// later frame). Cursor rays are coalesced: the worker only ever traces the latest one,
+// against the latest snapshot, through its own BVH (refit incrementally between snapshots).
+class PickingWorker {
+public:
+    // Starts the worker thread
+    PickingWorker();
+
+    // Stops and joins the worker thread
+    ~PickingWorker();
+
+    PickingWorker(const PickingWorker&) = delete;
+    PickingWorker& operator=(const PickingWorker&) = delete;
+
+    // Hand the worker a copy of the objects if they changed since the last snapshot.
+    // Returns false if both buffers were still in use and nothing was published.
+    bool publishScene(const ObjectManager& objects);
+
+    // Ask for the object under a ray; replaces any request the worker hasn't started yet
+    void requestPick(const glm::vec3& origin, const glm::vec3& direction);
+
+    // Result of the newest finished pick (-1 if nothing was hit, or if it was picked on a
+    // snapshot from before the last discardResult)
+    int getObjectUnderCursor() const;
+
+    // Object indices changed (objects were removed or replaced): drop the current result
+    // and whatever the worker picks on older snapshots. Results count again once a scene
+    // published after this has been picked.
+    void discardResult();
+
+    // Number of picks traced so far (requests that were superseded aren't traced)
+    unsigned long long getCompletedPicks() const;
+
+private:
+    // Worker thread entry point
+    void workerLoop();
+
+    // Object under the ray in the snapshot (-1 if none)
+    int pick(const ObjectManager& objects, const glm::vec3& origin, const glm::vec3& direction);
+
+    // Raymarch against m_bvh (mirrors the shader's raymarch without blending)
+    float raymarch(const glm::vec3& ro, const glm::vec3& rd) const;
+
+    // Snapshot buffers (owned by the render thread) and the one currently published
+    std::shared_ptr<ObjectManager> m_buffers[2];
+    int m_front;                        // Buffer last published (-1 before the first)
+    unsigned long long m_publishedGeneration;
+    unsigned int m_indexEpoch;          // discardResult calls so far (render thread)
+    unsigned int m_bufferEpochs[2];     // m_indexEpoch when each buffer was published
+    std::shared_ptr<const ObjectManager> m_published; // Accessed with std::atomic_load/store
+
+    // Latest cursor ray; the mutex is only held to copy it in or out
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    glm::vec3 m_requestOrigin, m_requestDirection;
+    bool m_requestPending;
+    bool m_sceneChanged;
+    bool m_stopping;
+
+    // Worker state
+    SceneBVH m_bvh;
+    glm::vec3 m_lastOrigin, m_lastDirection;  // Ray of the last pick, retraced when the scene changes
+    bool m_hasRay;
+
+    // Newest result, with the index epoch of its snapshot in the high 32 bits
+    std::atomic<unsigned long long> m_result;
+    std::atomic<unsigned long long> m_completedPicks;
+    std::thread m_thread;
+};
@@ -0,0 +1,330 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+Profiler::Profiler() : m_enabled(false), m_frames(FRAME_HISTORY), m_currentFrame(0), m_frameIndex(0),
+    m_frameOpen(false), m_droppedEvents(0), m_gpuAvailable(false), m_gpuNext(0), m_gpuInFlight(0), m_gpuCurrent(-1) {
+    m_epochNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    for (FrameRecord& frame : m_frames) {
+        frame.frameIndex = 0;
+        frame.startNs = 0;
+        frame.durationNs = 0;
+        frame.gpuResolved = true;
+        frame.eventCount.store(0, std::memory_order_relaxed);
+    }
+    for (GpuFrame& gpuFrame : m_gpuFrames) {
+        std::memset(gpuFrame.queries, 0, sizeof(gpuFrame.queries));
+        gpuFrame.zoneCount = 0;
+        gpuFrame.frameIndex = 0;
+        gpuFrame.clockOffsetNs = 0;
+    }
+}
+
+Profiler::~Profiler() {
+    // GL objects are released by cleanupGpu while the context still exists
+}
+
+void Profiler::initializeGpu() {
+    if (m_gpuAvailable) {
+        return;
+    }
+    for (GpuFrame& gpuFrame : m_gpuFrames) {
+        glGenQueries(MAX_GPU_ZONES * 2, gpuFrame.queries);
+    }
+    m_gpuInFlight = 0;
+    m_gpuAvailable = true;
+}
+
+void Profiler::cleanupGpu() {
+    if (!m_gpuAvailable) {
+        return;
+    }
+    for (GpuFrame& gpuFrame : m_gpuFrames) {
+        glDeleteQueries(MAX_GPU_ZONES * 2, gpuFrame.queries);
+        std::memset(gpuFrame.queries, 0, sizeof(gpuFrame.queries));
+    }
+    m_gpuAvailable = false;
+    m_gpuInFlight = 0;
+    m_gpuCurrent = -1;
+}
+
+void Profiler::setEnabled(bool enabled) {
+    if (enabled && !isEnabled()) {
+        // Start from an empty history; queries still in flight are simply reissued later
+        for (FrameRecord& frame : m_frames) {
+            frame.frameIndex = 0;
+            frame.durationNs = 0;
+            frame.gpuResolved = true;
+            frame.eventCount.store(0, std::memory_order_relaxed);
+        }
+        m_gpuInFlight = 0;
+        m_frameIndex = 0;
+        m_frameOpen = false;
+        m_gpuCurrent = -1;
+        m_droppedEvents.store(0, std::memory_order_relaxed);
+    }
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+long long Profiler::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - m_epochNs;
+}
+
+void Profiler::beginFrame() {
+    if (!isEnabled()) {
+        return;
+    }
+    if (m_frameOpen) {
+        endFrame();
+    }
+    resolveGpuFrames();
+
+    // Reuse the oldest slot of the ring
+    m_frameIndex++;
+    int slot = static_cast<int>(m_frameIndex % FRAME_HISTORY);
+    FrameRecord& frame = m_frames[slot];
+    frame.frameIndex = m_frameIndex;
+    frame.startNs = now();
+    frame.durationNs = 0;
+    frame.gpuResolved = true;
+    frame.eventCount.store(0, std::memory_order_relaxed);
+    m_currentFrame.store(slot, std::memory_order_release);
+    m_frameOpen = true;
+
+    // Time this frame's GPU zones unless all query sets are still in flight
+    m_gpuCurrent = -1;
+    if (m_gpuAvailable && m_gpuInFlight < GPU_FRAMES_IN_FLIGHT) {
+        int next = (m_gpuNext + m_gpuInFlight) % GPU_FRAMES_IN_FLIGHT;
+        GpuFrame& gpuFrame = m_gpuFrames[next];
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuFrame.zoneCount = 0;
+        gpuFrame.frameIndex = m_frameIndex;
+        gpuFrame.clockOffsetNs = frame.startNs - static_cast<long long>(gpuNow);
+        m_gpuCurrent = next;
+    }
+}
+
+void Profiler::endFrame() {
+    if (!m_frameOpen) {
+        return;
+    }
+    FrameRecord& frame = m_frames[m_currentFrame.load(std::memory_order_relaxed)];
+    frame.durationNs = std::max(now() - frame.startNs, 1LL);
+    if (m_gpuCurrent >= 0) {
+        GpuFrame& gpuFrame = m_gpuFrames[m_gpuCurrent];
+        if (gpuFrame.zoneCount > 0) {
+            m_gpuInFlight++;
+            frame.gpuResolved = false;
+        }
+        m_gpuCurrent = -1;
+    }
+    m_frameOpen = false;
+}
+
+void Profiler::recordCpuZone(const char* name, long long startNs, long long endNs) {
+    addEvent(name, threadTrack(), startNs, endNs - startNs);
+}
+
+int Profiler::beginGpuZone(const char* name) {
+    if (m_gpuCurrent < 0) {
+        return -1;
+    }
+    GpuFrame& gpuFrame = m_gpuFrames[m_gpuCurrent];
+    if (gpuFrame.zoneCount >= MAX_GPU_ZONES) {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    int zone = gpuFrame.zoneCount++;
+    gpuFrame.names[zone] = name;
+    glQueryCounter(gpuFrame.queries[zone * 2], GL_TIMESTAMP);
+    return zone;
+}
+
+void Profiler::endGpuZone(int zone) {
+    if (m_gpuCurrent < 0) {
+        return;
+    }
+    glQueryCounter(m_gpuFrames[m_gpuCurrent].queries[zone * 2 + 1], GL_TIMESTAMP);
+}
+
+void Profiler::resolveGpuFrames() {
+    // In issue order; stop at the first frame the GPU hasn't finished
+    while (m_gpuInFlight > 0) {
+        GpuFrame& gpuFrame = m_gpuFrames[m_gpuNext];
+        GLint available = 0;
+        glGetQueryObjectiv(gpuFrame.queries[gpuFrame.zoneCount * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+
+        // The frame may have left the ring if the GPU is far behind
+        FrameRecord& frame = m_frames[gpuFrame.frameIndex % FRAME_HISTORY];
+        bool recorded = frame.frameIndex == gpuFrame.frameIndex;
+        for (int zone = 0; zone < gpuFrame.zoneCount; zone++) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(gpuFrame.queries[zone * 2], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(gpuFrame.queries[zone * 2 + 1], GL_QUERY_RESULT, &end);
+            if (recorded) {
+                addEvent(frame, gpuFrame.names[zone], PROFILE_TRACK_GPU,
+                         static_cast<long long>(start) + gpuFrame.clockOffsetNs,
+                         static_cast<long long>(end - start));
+            }
+        }
+        if (recorded) {
+            frame.gpuResolved = true;
+        }
+        m_gpuNext = (m_gpuNext + 1) % GPU_FRAMES_IN_FLIGHT;
+        m_gpuInFlight--;
+    }
+}
+
+void Profiler::addEvent(const char* name, int track, long long startNs, long long durationNs) {
+    addEvent(m_frames[m_currentFrame.load(std::memory_order_acquire)], name, track, startNs, durationNs);
+}
+
+void Profiler::addEvent(FrameRecord& frame, const char* name, int track, long long startNs, long long durationNs) {
+    int slot = frame.eventCount.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= MAX_FRAME_EVENTS) {
+        m_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ProfileEvent& event = frame.events[slot];
+    event.name = name;
+    event.track = track;
+    event.startNs = startNs;
+    event.durationNs = durationNs;
+}
+
+int Profiler::threadTrack() {
+    static std::atomic<int> nextTrack(0);
+    thread_local int track = nextTrack.fetch_add(1, std::memory_order_relaxed);
+    return track;
+}
+
+int Profiler::recordedEvents(const FrameRecord& frame) {
+    // The count keeps growing past the capacity when events are dropped
+    int count = frame.eventCount.load(std::memory_order_relaxed);
+    return count < MAX_FRAME_EVENTS ? count : MAX_FRAME_EVENTS;
+}
+
+const Profiler::FrameRecord& Profiler::frameAt(int age) const {
+    return m_frames[(m_frameIndex - age) % FRAME_HISTORY];
+}
+
+int Profiler::getFrameCount() const {
+    // Complete frames only
+    unsigned long long complete = m_frameOpen ? m_frameIndex - 1 : m_frameIndex;
+    return static_cast<int>(std::min<unsigned long long>(complete, FRAME_HISTORY - 1));
+}
+
+const ProfileEvent* Profiler::getFrameEvents(int age, int& eventCount, bool& gpuResolved) const {
+    // age 0 = oldest complete frame
+    int newest = m_frameOpen ? 1 : 0;
+    const FrameRecord& frame = frameAt(newest + getFrameCount() - 1 - age);
+    eventCount = recordedEvents(frame);
+    gpuResolved = frame.gpuResolved;
+    return frame.events;
+}
+
+void Profiler::getZoneStats(int frames, std::vector<ProfileZoneStats>& stats) const {
+    stats.clear();
+    std::vector<int> counts;
+    std::vector<double> frameSums;
+    frames = std::min(frames, getFrameCount());
+    for (int i = 0; i < frames; i++) {
+        int eventCount = 0;
+        bool gpuResolved = false;
+        const ProfileEvent* events = getFrameEvents(getFrameCount() - 1 - i, eventCount, gpuResolved);
+
+        // Sum repeated zones within the frame first
+        std::fill(frameSums.begin(), frameSums.end(), 0.0);
+        for (int e = 0; e < eventCount; e++) {
+            bool gpu = events[e].track == PROFILE_TRACK_GPU;
+            size_t zone = 0;
+            while (zone < stats.size() && (stats[zone].gpu != gpu || std::strcmp(stats[zone].name, events[e].name) != 0)) {
+                zone++;
+            }
+            if (zone == stats.size()) {
+                stats.push_back({events[e].name, gpu, 0.0, 0.0});
+                counts.push_back(0);
+                frameSums.push_back(0.0);
+            }
+            frameSums[zone] += events[e].durationNs * 1e-6;
+        }
+        for (size_t zone = 0; zone < stats.size(); zone++) {
+            // Frames still waiting for GPU results don't count towards the GPU zones
+            if (stats[zone].gpu && !gpuResolved) continue;
+            stats[zone].averageMs += frameSums[zone];
+            stats[zone].maxMs = std::max(stats[zone].maxMs, frameSums[zone]);
+            counts[zone]++;
+        }
+    }
+    for (size_t zone = 0; zone < stats.size(); zone++) {
+        if (counts[zone] > 0) stats[zone].averageMs /= counts[zone];
+    }
+}
+
+double Profiler::getAverageFrameTime(int frames) const {
+    frames = std::min(frames, getFrameCount());
+    if (frames == 0) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    int newest = m_frameOpen ? 1 : 0;
+    for (int i = 0; i < frames; i++) {
+        sum += frameAt(newest + i).durationNs * 1e-6;
+    }
+    return sum / frames;
+}
+
+std::string Profiler::formatSummary(int frames) const {
+    std::vector<ProfileZoneStats> stats;
+    getZoneStats(frames, stats);
+    char text[128];
+    std::snprintf(text, sizeof(text), "frame %.2f ms", getAverageFrameTime(frames));
+    std::string summary = text;
+    for (const ProfileZoneStats& zone : stats) {
+        std::snprintf(text, sizeof(text), " | %s%s %.2f", zone.gpu ? "gpu:" : "", zone.name, zone.averageMs);
+        summary += text;
+    }
+    return summary;
+}
+
+bool Profiler::writeChromeTrace(const char* path) const {
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    // Complete ("X") events in microseconds, one track per recording thread plus one for the GPU
+    std::fprintf(file, "{\"traceEvents\": [\n");
+    std::fprintf(file, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1000, \"args\": {\"name\": \"GPU\"}}");
+    int frameCount = getFrameCount();
+    int newest = m_frameOpen ? 1 : 0;
+    for (int age = 0; age < frameCount; age++) {
+        const FrameRecord& frame = frameAt(newest + frameCount - 1 - age);
+        std::fprintf(file, ",\n  {\"name\": \"frame %llu\", \"cat\": \"frame\", \"ph\": \"X\", \"pid\": 1, \"tid\": 0, "
+                           "\"ts\": %.3f, \"dur\": %.3f}",
+                     frame.frameIndex, frame.startNs * 1e-3, frame.durationNs * 1e-3);
+        int eventCount = recordedEvents(frame);
+        for (int e = 0; e < eventCount; e++) {
+            const ProfileEvent& event = frame.events[e];
+            bool gpu = event.track == PROFILE_TRACK_GPU;
+            std::fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                               "\"ts\": %.3f, \"dur\": %.3f}",
+                         event.name, gpu ? "gpu" : "cpu", gpu ? 1000 : event.track,
+                         event.startNs * 1e-3, event.durationNs * 1e-3);
+        }
+    }
+    std::fprintf(file, "\n],\n\"displayTimeUnit\": \"ms\"}\n");
+    return std::fclose(file) == 0;
+}
+
+long long Profiler::getDroppedEvents() const {
+    return m_droppedEvents.load(std::memory_order_relaxed);
+}
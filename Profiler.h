@@ -0,0 +1,179 @@
+#pragma once
+#include <GL/glew.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// One timed zone of a frame
+struct ProfileEvent {
+    const char* name;     // Zone name (must be a string literal or otherwise outlive the profiler)
+    int track;            // Recording thread (0 = first thread seen), PROFILE_TRACK_GPU for GPU zones
+    long long startNs;    // Start on the profiler's clock (GPU zones are mapped onto it)
+    long long durationNs;
+};
+
+const int PROFILE_TRACK_GPU = -1;
+
+// Average cost of one zone over recent frames
+struct ProfileZoneStats {
+    const char* name;
+    bool gpu;
+    double averageMs;  // Per frame (zones entered several times per frame are summed)
+    double maxMs;
+};
+
+// Frame profiler for the hot paths: scoped CPU timers and GL timestamp query pairs,
+// recorded into a ring of per-frame event lists.
+//
+// CPU zones may be recorded from any thread: an event claims its slot in the current
+// frame with one atomic add, so recording never locks. Zones have to close before the
+// frame they started in ends. GPU zones are issued from the GL thread, and their results
+// are read back a few frames later (never waiting on the GPU) and added to the frame they
+// belong to. While the profiler is disabled, every scope costs one relaxed load.
+class Profiler {
+public:
+    // Frames kept in the ring (and written to a trace)
+    static const int FRAME_HISTORY = 128;
+
+    // Events one frame can hold (later ones are dropped and counted)
+    static const int MAX_FRAME_EVENTS = 64;
+
+    // GPU zones per frame and frames whose GPU zones can be in flight
+    static const int MAX_GPU_ZONES = 8;
+    static const int GPU_FRAMES_IN_FLIGHT = 4;
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Create the GL queries (needs a current context; without it only CPU zones are recorded)
+    void initializeGpu();
+
+    // Delete the GL queries
+    void cleanupGpu();
+
+    // Recording switch (off by default); re-enabling starts from an empty history
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Frame boundaries, called on the GL thread. beginFrame also collects finished GPU zones.
+    void beginFrame();
+    void endFrame();
+
+    // Current time on the profiler's clock
+    long long now() const;
+
+    // Record a finished CPU zone (see ProfileScope)
+    void recordCpuZone(const char* name, long long startNs, long long endNs);
+
+    // Start/end a GPU zone (see GpuProfileScope); beginGpuZone returns -1 if it isn't timed
+    int beginGpuZone(const char* name);
+    void endGpuZone(int zone);
+
+    // Per-zone averages over the last `frames` complete frames, in order of first appearance.
+    // GPU zones only count frames whose results have arrived.
+    void getZoneStats(int frames, std::vector<ProfileZoneStats>& stats) const;
+
+    // Average CPU time between beginFrame and endFrame over the last `frames` frames
+    double getAverageFrameTime(int frames) const;
+
+    // One-line summary of getZoneStats, e.g. for a window title
+    std::string formatSummary(int frames) const;
+
+    // Recorded frames in order, oldest first, for drawing (count <= FRAME_HISTORY)
+    int getFrameCount() const;
+    const ProfileEvent* getFrameEvents(int age, int& eventCount, bool& gpuResolved) const;
+
+    // Write the history as Chrome trace JSON (chrome://tracing, Perfetto); false if the file can't be written
+    bool writeChromeTrace(const char* path) const;
+
+    // Events dropped because a frame was full
+    long long getDroppedEvents() const;
+
+private:
+    struct FrameRecord {
+        unsigned long long frameIndex;
+        long long startNs;
+        long long durationNs;     // 0 while the frame is open
+        bool gpuResolved;         // GPU zones have been added (or the frame has none)
+        std::atomic<int> eventCount;
+        ProfileEvent events[MAX_FRAME_EVENTS];
+    };
+
+    struct GpuFrame {
+        GLuint queries[MAX_GPU_ZONES * 2];  // Start and end timestamp of each zone
+        const char* names[MAX_GPU_ZONES];
+        int zoneCount;
+        unsigned long long frameIndex;
+        long long clockOffsetNs;  // Profiler clock minus GL timestamp when the frame started
+    };
+
+    // Claim a slot in the current frame and fill it in
+    void addEvent(const char* name, int track, long long startNs, long long durationNs);
+    void addEvent(FrameRecord& frame, const char* name, int track, long long startNs, long long durationNs);
+
+    // Read back GPU frames whose queries have finished, oldest first
+    void resolveGpuFrames();
+
+    // Events stored in a frame
+    static int recordedEvents(const FrameRecord& frame);
+
+    // Frame record `age` frames back from the newest (0 = current)
+    const FrameRecord& frameAt(int age) const;
+
+    // Small index for the calling thread, used as its trace track
+    static int threadTrack();
+
+    std::atomic<bool> m_enabled;
+    std::vector<FrameRecord> m_frames;
+    std::atomic<int> m_currentFrame;       // Slot being recorded into
+    unsigned long long m_frameIndex;       // Frames begun since enabling
+    bool m_frameOpen;
+    std::atomic<long long> m_droppedEvents;
+    long long m_epochNs;                   // steady_clock time of the profiler's zero
+
+    // GPU zones
+    bool m_gpuAvailable;
+    GpuFrame m_gpuFrames[GPU_FRAMES_IN_FLIGHT];
+    int m_gpuNext;              // Oldest in-flight frame
+    int m_gpuInFlight;          // Frames whose results haven't been read yet
+    int m_gpuCurrent;           // Frame receiving zones this frame (-1 if not timed)
+};
+
+// Times the enclosing block as a CPU zone
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, const char* name)
+        : m_profiler(profiler.isEnabled() ? &profiler : nullptr), m_name(name),
+          m_start(m_profiler ? profiler.now() : 0) {}
+    ~ProfileScope() {
+        if (m_profiler) m_profiler->recordCpuZone(m_name, m_start, m_profiler->now());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler* m_profiler;
+    const char* m_name;
+    long long m_start;
+};
+
+// Times the GL commands issued in the enclosing block as a GPU zone
+class GpuProfileScope {
+public:
+    GpuProfileScope(Profiler& profiler, const char* name)
+        : m_profiler(profiler), m_zone(profiler.isEnabled() ? profiler.beginGpuZone(name) : -1) {}
+    ~GpuProfileScope() {
+        if (m_zone >= 0) m_profiler.endGpuZone(m_zone);
+    }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    Profiler& m_profiler;
+    int m_zone;
+};
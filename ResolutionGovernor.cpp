@@ -0,0 +1,71 @@
+#include "ResolutionGovernor.h"
+#include <algorithm>
+#include <cmath>
+
+// Share of the target the governor aims for, so noise doesn't push frames over budget
+static const float TARGET_HEADROOM = 0.9f;
+
+// Largest change of the scale per sample, and smallest change worth making
+static const float MAX_SCALE_STEP = 0.05f;
+static const float MIN_SCALE_STEP = 0.01f;
+
+ResolutionGovernor::ResolutionGovernor(float targetMilliseconds, float minScale, float maxScale)
+    : m_target(targetMilliseconds), m_minScale(minScale), m_maxScale(maxScale), m_scale(maxScale), m_costs(),
+      m_costCount(0), m_costNext(0), m_costPerArea(0.0f) {
+}
+
+void ResolutionGovernor::setTargetFrameTime(float milliseconds) {
+    m_target = std::max(milliseconds, 0.1f);
+}
+
+float ResolutionGovernor::getTargetFrameTime() const {
+    return m_target;
+}
+
+void ResolutionGovernor::setScaleRange(float minScale, float maxScale) {
+    m_minScale = std::max(minScale, 0.01f);
+    m_maxScale = std::max(maxScale, m_minScale);
+    m_scale = std::min(std::max(m_scale, m_minScale), m_maxScale);
+}
+
+float ResolutionGovernor::addSample(float milliseconds, float renderedScale) {
+    if (milliseconds <= 0.0f || renderedScale <= 0.0f) {
+        return m_scale;
+    }
+
+    m_costs[m_costNext] = milliseconds / (renderedScale * renderedScale);
+    m_costNext = (m_costNext + 1) % COST_SAMPLES;
+    if (m_costCount < COST_SAMPLES) {
+        m_costCount++;
+    }
+
+    float sorted[COST_SAMPLES];
+    std::copy(m_costs, m_costs + m_costCount, sorted);
+    std::sort(sorted, sorted + m_costCount);
+    m_costPerArea = sorted[m_costCount / 2];
+
+    // Scale whose predicted time is the target (time ~ cost * scale^2)
+    float ideal = std::sqrt(m_target * TARGET_HEADROOM / m_costPerArea);
+    ideal = std::min(std::max(ideal, m_minScale), m_maxScale);
+
+    float step = std::min(std::max(ideal - m_scale, -MAX_SCALE_STEP), MAX_SCALE_STEP);
+    if (std::fabs(step) >= MIN_SCALE_STEP || ideal == m_minScale || ideal == m_maxScale) {
+        m_scale = std::min(std::max(m_scale + step, m_minScale), m_maxScale);
+    }
+    return m_scale;
+}
+
+float ResolutionGovernor::getScale() const {
+    return m_scale;
+}
+
+float ResolutionGovernor::getPredictedFrameTime() const {
+    return m_costPerArea * m_scale * m_scale;
+}
+
+void ResolutionGovernor::reset() {
+    m_scale = m_maxScale;
+    m_costCount = 0;
+    m_costNext = 0;
+    m_costPerArea = 0.0f;
+}
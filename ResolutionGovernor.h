@@ -0,0 +1,47 @@
+#pragma once
+
+// Picks the render scale (fraction of the window size along each axis) that keeps the
+// measured GPU time of the SDF pass near a target frame time.
+//
+// Fragment cost grows with the rendered area, so each measurement is turned into a cost
+// per unit of area (time / scale^2, for the scale that frame was rendered at), and the
+// median of the last few is used so one-off spikes (shader compiles, driver hiccups)
+// don't move the scale. The next scale is the one whose predicted time meets the target with some
+// headroom, moved towards in limited steps so the picture doesn't pump.
+class ResolutionGovernor {
+public:
+    // Constructor (target in milliseconds, scale range along each axis)
+    explicit ResolutionGovernor(float targetMilliseconds = 1000.0f / 60.0f, float minScale = 0.25f, float maxScale = 1.0f);
+
+    // Frame time to aim for, in milliseconds
+    void setTargetFrameTime(float milliseconds);
+    float getTargetFrameTime() const;
+
+    // Allowed range of the scale
+    void setScaleRange(float minScale, float maxScale);
+
+    // Feed the GPU time of a frame rendered at renderedScale; returns the new scale
+    float addSample(float milliseconds, float renderedScale);
+
+    // Scale to render the next frame at
+    float getScale() const;
+
+    // Time the current scale is predicted to take, in milliseconds
+    float getPredictedFrameTime() const;
+
+    // Forget measurements and go back to the largest scale (e.g. after a resize)
+    void reset();
+
+private:
+    float m_target;
+    float m_minScale;
+    float m_maxScale;
+    float m_scale;
+
+    // Recent costs in milliseconds at scale 1 (a ring of COST_SAMPLES) and their median
+    static const int COST_SAMPLES = 5;
+    float m_costs[COST_SAMPLES];
+    int m_costCount;
+    int m_costNext;
+    float m_costPerArea;  // 0 = no samples yet
+};
@@ -0,0 +1,346 @@
+// Headless renderer benchmark: builds reproducible random scenes of growing size, renders
+// a fixed orbit around them with the CPU renderer (the same raymarch as the shader) and
+// picks objects along the way, and times the GPU renderer's frustum culling and tile
+// binning of each view. Results go out as JSON so runs can be compared between
+// releases; progress is printed to stderr.
+//
+// With --scene the objects of a scene file are benchmarked instead (and the load timed);
+// --write-scene streams a random scene of --max-objects objects to a scene file and exits,
+// and --build-world partitions the --scene file into a paged world file and exits.
+//
+// Heap allocations of every timed frame (render, cull, bin and picks, on all threads) are
+// counted after one warm-up pass over the path; --require-zero-allocations makes the run
+// fail if any of them allocated.
+//
+// Usage: sdf_bench [--max-objects N] [--frames N] [--width W] [--height H]
+//                  [--picks N] [--seed S] [--out file.json]
+//                  [--scene file.sdfs | --write-scene file.sdfs [--extent E]]
+//                  [--build-world world.sdfw [--cell-size S]] [--look-offset D]
+//                  [--require-zero-allocations]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "AllocationCounter.h"
+#include "CPURenderer.h"
+#include "CoordSystem.h"
+#include "FrameArena.h"
+#include "ObjectManager.h"
+#include "SceneBVH.h"
+#include "SceneFile.h"
+#include "TileBinner.h"
+#include "ViewCuller.h"
+#include "WorldStore.h"
+#include "SDFMath.h"
+
+struct BenchOptions {
+    int maxObjects;
+    int frames;
+    int width, height;
+    int picksPerFrame;
+    unsigned int seed;
+    const char* outPath;
+    const char* scenePath;       // Scene file to benchmark instead of random scenes
+    const char* writeScenePath;  // Scene file to write instead of benchmarking
+    float extent;                // Half size of the cube --write-scene fills
+    const char* worldPath;       // World file to build from scenePath instead of benchmarking
+    float cellSize;              // Cell size of that world
+    bool requireZeroAllocations; // Fail if a timed frame allocated
+    float lookOffset;            // Distance of the path's look-at point from the scene centre
+};
+
+// Distribution of a list of timings
+struct Percentiles {
+    double mean, p50, p90, p99, max;
+};
+
+static Percentiles computePercentiles(std::vector<double> values) {
+    Percentiles result = {0.0, 0.0, 0.0, 0.0, 0.0};
+    if (values.empty()) return result;
+    std::sort(values.begin(), values.end());
+    // Nearest-rank percentile
+    auto rank = [&](double q) {
+        size_t index = static_cast<size_t>(std::ceil(q * values.size()));
+        return values[std::min(values.size() - 1, index > 0 ? index - 1 : 0)];
+    };
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    result.mean = sum / values.size();
+    result.p50 = rank(0.50);
+    result.p90 = rank(0.90);
+    result.p99 = rank(0.99);
+    result.max = values.back();
+    return result;
+}
+
+static void writePercentiles(FILE* out, const char* name, const Percentiles& p) {
+    std::fprintf(out, "\"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                 name, p.mean, p.p50, p.p90, p.p99, p.max);
+}
+
+// Camera of frame `frame` on the fixed path: one orbit around the scene centre, bobbing
+// up and down. It looks at a point `lookOffset` from the centre that circles three times as
+// fast, so the views go from straight through the scene to facing away from it (and the
+// culled share with them). A zero offset always looks at the centre.
+static CPUCamera pathCamera(int frame, int frameCount, float lookOffset) {
+    float angle = 2.0f * 3.14159265f * frame / frameCount;
+    glm::vec3 position(9.0f * std::sin(angle), 2.0f * std::sin(2.0f * angle), 9.0f * std::cos(angle));
+    glm::vec3 target(lookOffset * std::sin(3.0f * angle), 0.0f, lookOffset * std::cos(3.0f * angle));
+    glm::vec3 forward = glm::normalize(target - position);
+    CPUCamera camera;
+    camera.position = position;
+    camera.horizontalAngle = std::atan2(forward.x, forward.z);
+    camera.verticalAngle = std::asin(forward.y);
+    return camera;
+}
+
+// Object under a ray, found the way the CPU picking worker does (BVH raymarch, then closest object)
+static int pickObject(const SceneBVH& bvh, const glm::vec3& ro, const glm::vec3& rd) {
+    float t = 0.0f;
+    for (int i = 0; i < 64; i++) {
+        glm::vec3 p = ro + rd * t;
+        float d = bvh.distance(p);
+        if (d < 0.001f) return bvh.closestObject(p, 0.01f);
+        t += d;
+        if (t > 20.0f) break;
+    }
+    return -1;
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--require-zero-allocations") == 0) {
+            options.requireZeroAllocations = true;
+            continue;
+        }
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) {
+            std::fprintf(stderr, "Missing value for %s\n", arg);
+            return false;
+        }
+        if (std::strcmp(arg, "--max-objects") == 0) options.maxObjects = std::atoi(value);
+        else if (std::strcmp(arg, "--frames") == 0) options.frames = std::atoi(value);
+        else if (std::strcmp(arg, "--width") == 0) options.width = std::atoi(value);
+        else if (std::strcmp(arg, "--height") == 0) options.height = std::atoi(value);
+        else if (std::strcmp(arg, "--picks") == 0) options.picksPerFrame = std::atoi(value);
+        else if (std::strcmp(arg, "--seed") == 0) options.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(arg, "--out") == 0) options.outPath = value;
+        else if (std::strcmp(arg, "--scene") == 0) options.scenePath = value;
+        else if (std::strcmp(arg, "--write-scene") == 0) options.writeScenePath = value;
+        else if (std::strcmp(arg, "--extent") == 0) options.extent = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--build-world") == 0) options.worldPath = value;
+        else if (std::strcmp(arg, "--cell-size") == 0) options.cellSize = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--look-offset") == 0) options.lookOffset = static_cast<float>(std::atof(value));
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", arg);
+            return false;
+        }
+        i++;
+    }
+    if (options.frames < 1 || options.width < 1 || options.height < 1 || options.picksPerFrame < 0) {
+        std::fprintf(stderr, "Frames and size must be positive\n");
+        return false;
+    }
+    if (options.worldPath && (!options.scenePath || !(options.cellSize > 0.0f))) {
+        std::fprintf(stderr, "--build-world needs --scene and a positive --cell-size\n");
+        return false;
+    }
+    return true;
+}
+
+// Stream a random scene (half spheres, half cubes, spread over a cube like
+// generateRandomObjects, ±5 unless --extent says otherwise) to a scene file without holding
+// it in memory
+static bool writeRandomScene(const BenchOptions& options) {
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> coord(-options.extent, options.extent);
+    auto start = std::chrono::steady_clock::now();
+    SceneWriter writer;
+    if (!writer.open(options.writeScenePath)) return false;
+    for (int i = 0; i < options.maxObjects; i++) {
+        glm::vec3 position(coord(rng), coord(rng), coord(rng));
+        if (!writer.addObject(i < options.maxObjects / 2 ? 0 : 1, getrealcoord(position))) return false;
+    }
+    if (!writer.finish()) return false;
+    std::fprintf(stderr, "Wrote %d objects to %s in %.1f ms\n", options.maxObjects, options.writeScenePath,
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = {100000, 32, 320, 180, 64, 1234u, nullptr, nullptr, nullptr, 5.0f, nullptr, 8.0f, false, 12.0f};
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: sdf_bench [--max-objects N] [--frames N] [--width W] [--height H] "
+                             "[--picks N] [--seed S] [--out file.json] [--scene file.sdfs | --write-scene file.sdfs [--extent E]] "
+                             "[--build-world world.sdfw [--cell-size S]] [--look-offset D] [--require-zero-allocations]\n");
+        return 1;
+    }
+    if (options.writeScenePath) {
+        return writeRandomScene(options) ? 0 : 1;
+    }
+    if (options.worldPath) {
+        SceneFile scene;
+        auto start = std::chrono::steady_clock::now();
+        if (!scene.open(options.scenePath) || !WorldStore::build(scene, options.worldPath, options.cellSize)) return 1;
+        std::fprintf(stderr, "Built world %s from %d objects in %.1f ms\n", options.worldPath, scene.getObjectCount(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3);
+        return 0;
+    }
+
+    FILE* out = options.outPath ? std::fopen(options.outPath, "w") : stdout;
+    if (!out) {
+        std::fprintf(stderr, "Failed to open %s\n", options.outPath);
+        return 1;
+    }
+
+    CPURenderer renderer;
+    std::vector<unsigned char> rgba(static_cast<size_t>(options.width) * options.height * 4);
+
+    std::fprintf(out, "{\n  \"benchmark\": \"sdf_bench\",\n  \"renderer\": \"cpu\",\n");
+    std::fprintf(out, "  \"seed\": %u,\n  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n",
+                 options.seed, options.width, options.height, options.frames);
+    std::fprintf(out, "  \"look_offset\": %.2f,\n", options.lookOffset);
+    std::fprintf(out, "  \"picks_per_frame\": %d,\n  \"workers\": %d,\n  \"scenes\": [",
+                 options.picksPerFrame, renderer.getWorkerCount());
+
+    bool firstScene = true;
+    bool allocationFree = true;
+    for (int objectCount = 10; objectCount <= options.maxObjects; objectCount *= 10) {
+        // Same scene for the same seed and size: half spheres, half cubes
+        ObjectManager objects(options.seed);
+        double loadMs = -1.0;
+        if (options.scenePath) {
+            // Only the file's scene, loaded the way the renderer loads it
+            auto start = std::chrono::steady_clock::now();
+            SceneFile file;
+            if (!file.open(options.scenePath)) return 1;
+            file.appendTo(objects);
+            loadMs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3;
+            objectCount = objects.getObjectCount();
+        } else {
+            objects.generateRandomObjects(objectCount / 2, objectCount - objectCount / 2);
+        }
+        SceneBVH pickBVH;
+        pickBVH.build(objects);
+
+        // Warm-up frame (BVH build inside the renderer, first touch of the buffers)
+        renderer.render(objects, pathCamera(0, options.frames, options.lookOffset), rgba.data(), options.width, options.height);
+
+        std::mt19937 pickRng(options.seed);
+        std::uniform_real_distribution<float> pickCoord(-1.0f, 1.0f);
+        float aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+
+        // Cull and bin every view of the path once, so the lists and the frame arena reach
+        // the largest size the timed frames need
+        ViewCuller culler;
+        TileBinner binner;
+        FrameArena arena;
+        for (int frame = 0; frame < options.frames; frame++) {
+            CPUCamera camera = pathCamera(frame, options.frames, options.lookOffset);
+            ViewBasis basis = computeViewBasis(camera.horizontalAngle, camera.verticalAngle);
+            arena.reset();
+            culler.cull(objects, camera.position, basis, aspect);
+            binner.bin(objects, culler.getVisibleObjects(), culler.getVisibleCount(), camera.position, basis,
+                       options.width, options.height, arena);
+        }
+
+        double culledFraction = 0.0, tileObjects = 0.0;
+        int maxTileObjects = 0;
+        std::vector<double> frameMs, pickUs, cullMs, binMs;
+        frameMs.reserve(options.frames);
+        cullMs.reserve(options.frames);
+        binMs.reserve(options.frames);
+        pickUs.reserve(static_cast<size_t>(options.frames) * options.picksPerFrame);
+        unsigned long long allocations = 0;
+        int allocatingFrames = 0;
+        long long rays = 0, steps = 0, coneSteps = 0;
+        double renderSeconds = 0.0;
+        int pickHits = 0;
+        for (int frame = 0; frame < options.frames; frame++) {
+            unsigned long long allocationsBefore = getAllocationCount();
+            arena.reset();
+            CPUCamera camera = pathCamera(frame, options.frames, options.lookOffset);
+            CPURenderStats stats = renderer.render(objects, camera, rgba.data(), options.width, options.height);
+            frameMs.push_back(stats.seconds * 1e3);
+            renderSeconds += stats.seconds;
+            rays += stats.rays;
+            steps += stats.steps;
+            coneSteps += stats.coneSteps;
+
+            // The objects the GPU renderer would send for this view
+            ViewBasis basis = computeViewBasis(camera.horizontalAngle, camera.verticalAngle);
+            auto cullStart = std::chrono::steady_clock::now();
+            culler.cull(objects, camera.position, basis, aspect);
+            cullMs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - cullStart).count() * 1e3);
+            culledFraction += culler.getCulledFraction();
+            auto binStart = std::chrono::steady_clock::now();
+            binner.bin(objects, culler.getVisibleObjects(), culler.getVisibleCount(), camera.position, basis,
+                       options.width, options.height, arena);
+            binMs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - binStart).count() * 1e3);
+            const TileBinStats& bins = binner.getStats();
+            tileObjects += static_cast<double>(bins.entries) / (bins.tilesX * bins.tilesY);
+            maxTileObjects = std::max(maxTileObjects, bins.maxTileObjects);
+
+            // Picks through random pixels of this frame's view
+            for (int i = 0; i < options.picksPerFrame; i++) {
+                float uvX = pickCoord(pickRng) * aspect;
+                float uvY = pickCoord(pickRng);
+                glm::vec3 rd = glm::normalize(basis.forward + uvX * basis.right + uvY * basis.up);
+                auto start = std::chrono::steady_clock::now();
+                int hit = pickObject(pickBVH, camera.position, rd);
+                pickUs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e6);
+                if (hit >= 0) pickHits++;
+            }
+
+            unsigned long long frameAllocations = getAllocationCount() - allocationsBefore;
+            allocations += frameAllocations;
+            allocatingFrames += frameAllocations > 0 ? 1 : 0;
+        }
+        allocationFree = allocationFree && allocatingFrames == 0;
+
+        Percentiles frame = computePercentiles(frameMs);
+        Percentiles pick = computePercentiles(pickUs);
+        Percentiles cull = computePercentiles(cullMs);
+        Percentiles bin = computePercentiles(binMs);
+        culledFraction /= options.frames;
+        tileObjects /= options.frames;
+        double raysPerSecond = renderSeconds > 0.0 ? rays / renderSeconds : 0.0;
+        double stepsPerRay = rays > 0 ? static_cast<double>(steps + coneSteps) / rays : 0.0;
+        double coneStepsPerRay = rays > 0 ? static_cast<double>(coneSteps) / rays : 0.0;
+
+        std::fprintf(out, "%s\n    {\"objects\": %d, ", firstScene ? "" : ",", objectCount);
+        if (loadMs >= 0.0) std::fprintf(out, "\"load_ms\": %.3f, ", loadMs);
+        writePercentiles(out, "frame_ms", frame);
+        std::fprintf(out, ", \"rays_per_second\": %.0f, \"steps_per_ray\": %.3f, \"cone_steps_per_ray\": %.3f, ",
+                     raysPerSecond, stepsPerRay, coneStepsPerRay);
+        writePercentiles(out, "pick_us", pick);
+        std::fprintf(out, ", \"picks\": %d, \"pick_hits\": %d, ", static_cast<int>(pickUs.size()), pickHits);
+        writePercentiles(out, "cull_ms", cull);
+        std::fprintf(out, ", \"culled_fraction\": %.4f, ", culledFraction);
+        writePercentiles(out, "bin_ms", bin);
+        std::fprintf(out, ", \"objects_per_tile\": %.2f, \"max_tile_objects\": %d, ", tileObjects, maxTileObjects);
+        std::fprintf(out, "\"allocations_per_frame\": %.2f, \"allocating_frames\": %d}",
+                     static_cast<double>(allocations) / options.frames, allocatingFrames);
+        std::fflush(out);
+        firstScene = false;
+
+        std::fprintf(stderr, "%8d objects: %.2f ms/frame (p50), %.1f Mrays/s, %.2f steps/ray, %.1f us/pick (p50), "
+                             "%.0f%% culled in %.3f ms, %.1f objects/tile binned in %.3f ms (p50), %.2f allocations/frame\n",
+                     objectCount, frame.p50, raysPerSecond * 1e-6, stepsPerRay, pick.p50, culledFraction * 100.0, cull.p50,
+                     tileObjects, bin.p50, static_cast<double>(allocations) / options.frames);
+        if (options.scenePath) break;
+    }
+
+    std::fprintf(out, "\n  ]\n}\n");
+    if (out != stdout) std::fclose(out);
+    if (options.requireZeroAllocations && !allocationFree) {
+        std::fprintf(stderr, "Steady-state frames allocated (see allocating_frames)\n");
+        return 1;
+    }
+    return 0;
+}
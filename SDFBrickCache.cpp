@@ -0,0 +1,296 @@
+#include "SDFBrickCache.h"
+#include "SDFMath.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Atlas layers guaranteed by GL 3.3 (GL_MAX_3D_TEXTURE_SIZE is at least 256)
+static const int DEFAULT_MAX_ATLAS_LAYERS = 256 / BRICK_SAMPLES;
+
+SDFBrickCache::SDFBrickCache(float brickSize, int workerCount) : m_pool(workerCount), m_brickSize(brickSize),
+    m_truncation(brickSize), m_synced(false), m_generation(0), m_gridMin(0.0f), m_gridSize(0),
+    m_rebuilt(false), m_slotCount(0), m_atlasLayers(0), m_maxAtlasLayers(DEFAULT_MAX_ATLAS_LAYERS), m_stats() {
+    m_workerObjects.resize(m_pool.getWorkerCount());
+}
+
+void SDFBrickCache::setMaxAtlasLayers(int layers) {
+    m_maxAtlasLayers = std::max(layers, 1);
+}
+
+bool SDFBrickCache::update(const ObjectManager& objects) {
+    m_dirtyBricks.clear();
+    m_rebuilt = false;
+    m_stats.lastRebakedBricks = 0;
+    if (m_synced && objects.getGeneration() == m_generation) {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    m_bvh.update(objects);
+
+    bool rebuild = !m_synced || objects.getObjectCount() != static_cast<int>(m_bakedPositions.size()) ||
+                   !objects.getChangedObjects(m_generation, m_changedObjects);
+    if (!rebuild) {
+        for (int index : m_changedObjects) {
+            glm::vec3 position = objects.getObject3DPosition(index);
+            int type = objects.getObjectType(index);
+            float size = objects.getObjectSliceSize(index);
+            if (position == m_bakedPositions[index] && type == m_bakedTypes[index] && size == m_bakedSizes[index]) {
+                continue; // Selection changes don't affect distances
+            }
+            if (!insideGrid(position)) {
+                rebuild = true;
+                break;
+            }
+
+            // Re-bake around where the object was and where it is now
+            markBricksNear(m_bakedPositions[index]);
+            markBricksNear(position);
+            m_bakedPositions[index] = position;
+            m_bakedTypes[index] = type;
+            m_bakedSizes[index] = size;
+        }
+    }
+
+    if (rebuild) {
+        rebuildGrid(objects);
+    }
+    bakeDirtyBricks();
+
+    for (int brick : m_dirtyBricks) {
+        m_brickDirty[brick] = 0;
+    }
+
+    m_synced = true;
+    m_generation = objects.getGeneration();
+
+    m_stats.brickCount = m_gridSize.x * m_gridSize.y * m_gridSize.z;
+    m_stats.surfaceBricks = m_slotCount - static_cast<int>(m_freeSlots.size());
+    m_stats.lastRebakedBricks = static_cast<int>(m_dirtyBricks.size());
+    m_stats.lastBakeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (rebuild) {
+        m_stats.fullBakes++;
+    } else {
+        m_stats.partialBakes++;
+    }
+    return m_rebuilt || !m_dirtyBricks.empty();
+}
+
+void SDFBrickCache::rebuildGrid(const ObjectManager& objects) {
+    int count = objects.getObjectCount();
+    m_bakedPositions.resize(count);
+    m_bakedTypes.resize(count);
+    m_bakedSizes.resize(count);
+
+    glm::vec3 lo(0.0f), hi(0.0f);
+    for (int i = 0; i < count; i++) {
+        m_bakedPositions[i] = objects.getObject3DPosition(i);
+        m_bakedTypes[i] = objects.getObjectType(i);
+        m_bakedSizes[i] = objects.getObjectSliceSize(i);
+        lo = i == 0 ? m_bakedPositions[i] : glm::min(lo, m_bakedPositions[i]);
+        hi = i == 0 ? m_bakedPositions[i] : glm::max(hi, m_bakedPositions[i]);
+    }
+
+    // Object bounds plus the margin insideGrid() wants, plus one brick of slack so small
+    // drags near the edge don't force a rebuild
+    float margin = SDF_PRIMITIVE_SIZE + m_truncation + SDF_BLEND_K + m_brickSize;
+    m_gridMin = glm::floor((lo - margin) / m_brickSize) * m_brickSize;
+    m_gridSize = count > 0 ? glm::ivec3(glm::ceil((hi + margin - m_gridMin) / m_brickSize)) : glm::ivec3(0);
+
+    int brickCount = m_gridSize.x * m_gridSize.y * m_gridSize.z;
+    m_brickMap.assign(static_cast<size_t>(brickCount) * 2, 0.0f);
+    m_brickDirty.assign(brickCount, 1);
+    m_dirtyBricks.resize(brickCount);
+    for (int brick = 0; brick < brickCount; brick++) {
+        m_brickMap[brick * 2] = static_cast<float>(BRICK_EMPTY);
+        m_dirtyBricks[brick] = brick;
+    }
+
+    m_atlas.clear();
+    m_freeSlots.clear();
+    m_slotCount = 0;
+    m_rebuilt = true;
+}
+
+bool SDFBrickCache::insideGrid(const glm::vec3& center) const {
+    // Nothing may come closer to the outside of the grid than the truncation distance
+    // (plus the blend radius), so the shader can bound distances out there
+    float margin = SDF_PRIMITIVE_SIZE + m_truncation + SDF_BLEND_K;
+    glm::vec3 gridMax = m_gridMin + glm::vec3(m_gridSize) * m_brickSize;
+    return glm::all(glm::greaterThanEqual(center - margin, m_gridMin)) &&
+           glm::all(glm::lessThanEqual(center + margin, gridMax));
+}
+
+void SDFBrickCache::markBricksNear(const glm::vec3& center) {
+    // An object changes the truncated blend only where it is within the truncation
+    // distance plus the blend reach (smoothMin lowers distances by up to k / 4 and pulls
+    // in objects up to k further away) of its box
+    float reach = SDF_PRIMITIVE_SIZE + m_truncation + 1.25f * SDF_BLEND_K;
+    glm::ivec3 lo = glm::ivec3(glm::floor((center - reach - m_gridMin) / m_brickSize));
+    glm::ivec3 hi = glm::ivec3(glm::floor((center + reach - m_gridMin) / m_brickSize));
+    lo = glm::max(lo, glm::ivec3(0));
+    hi = glm::min(hi, m_gridSize - 1);
+
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                int brick = x + m_gridSize.x * (y + m_gridSize.y * z);
+                if (!m_brickDirty[brick]) {
+                    m_brickDirty[brick] = 1;
+                    m_dirtyBricks.push_back(brick);
+                }
+            }
+        }
+    }
+}
+
+glm::vec3 SDFBrickCache::brickMin(int brick) const {
+    int x = brick % m_gridSize.x;
+    int y = (brick / m_gridSize.x) % m_gridSize.y;
+    int z = brick / (m_gridSize.x * m_gridSize.y);
+    return m_gridMin + glm::vec3(x, y, z) * m_brickSize;
+}
+
+void SDFBrickCache::bakeDirtyBricks() {
+    int dirtyCount = static_cast<int>(m_dirtyBricks.size());
+
+    // Classify by the distance at the brick centre (in parallel), then hand out slots
+    m_centerDist.resize(dirtyCount);
+    m_pool.parallelFor(dirtyCount, &SDFBrickCache::classifyTask, this);
+
+    // The blended field is 1-Lipschitz, so it changes by at most this much within a brick
+    float halfDiagonal = 0.5f * std::sqrt(3.0f) * m_brickSize;
+
+    m_bakeBricks.clear();
+    for (int i = 0; i < dirtyCount; i++) {
+        int brick = m_dirtyBricks[i];
+        float dist = m_centerDist[i];
+        float* entry = &m_brickMap[static_cast<size_t>(brick) * 2];
+        int slot = static_cast<int>(entry[0]);
+
+        if (dist - halfDiagonal > 0.0f || dist + halfDiagonal < 0.0f) {
+            // No surface in this brick: keep a bound outside objects, the exact SDF inside
+            if (slot >= 0) {
+                m_freeSlots.push_back(slot);
+            }
+            bool outside = dist > 0.0f;
+            entry[0] = static_cast<float>(outside ? BRICK_EMPTY : BRICK_EXACT);
+            entry[1] = outside ? std::min(dist, m_truncation) - halfDiagonal : 0.0f;
+            continue;
+        }
+
+        if (slot < 0) {
+            slot = allocateSlot();
+        }
+        entry[0] = static_cast<float>(slot);
+        entry[1] = 0.0f;
+        if (slot >= 0) {
+            m_bakeBricks.push_back(brick);
+        }
+    }
+
+    m_pool.parallelFor(static_cast<int>(m_bakeBricks.size()), &SDFBrickCache::bakeTask, this);
+}
+
+int SDFBrickCache::allocateSlot() {
+    if (!m_freeSlots.empty()) {
+        int slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+
+    int slotsPerLayer = BRICK_ATLAS_SLOTS_X * BRICK_ATLAS_SLOTS_Y;
+    if (m_slotCount == m_atlasLayers * slotsPerLayer) {
+        if (m_atlasLayers >= m_maxAtlasLayers) {
+            return BRICK_EXACT;
+        }
+        // Grow the atlas; the GPU copy has to be recreated
+        m_atlasLayers = std::min(std::max(m_atlasLayers * 2, 1), m_maxAtlasLayers);
+        m_rebuilt = true;
+    }
+
+    m_atlas.resize(static_cast<size_t>(m_slotCount + 1) * BRICK_SAMPLE_COUNT);
+    return m_slotCount++;
+}
+
+void SDFBrickCache::classifyTask(void* context, int taskIndex, int workerIndex) {
+    SDFBrickCache* cache = static_cast<SDFBrickCache*>(context);
+    glm::vec3 center = cache->brickMin(cache->m_dirtyBricks[taskIndex]) + glm::vec3(0.5f * cache->m_brickSize);
+    cache->m_centerDist[taskIndex] = cache->m_bvh.blendedDistance(center).distance;
+}
+
+void SDFBrickCache::bakeTask(void* context, int taskIndex, int workerIndex) {
+    SDFBrickCache* cache = static_cast<SDFBrickCache*>(context);
+    int brick = cache->m_bakeBricks[taskIndex];
+    int slot = static_cast<int>(cache->m_brickMap[static_cast<size_t>(brick) * 2]);
+    glm::vec3 origin = cache->brickMin(brick);
+    float voxelSize = cache->getVoxelSize();
+    float truncation = cache->m_truncation;
+
+    // Only objects within the influence reach of the brick can change its truncated samples
+    std::vector<int>& nearby = cache->m_workerObjects[workerIndex];
+    cache->m_bvh.objectsNear(origin, origin + glm::vec3(cache->m_brickSize), truncation + 1.25f * SDF_BLEND_K, nearby);
+
+    float* samples = &cache->m_atlas[static_cast<size_t>(slot) * BRICK_SAMPLE_COUNT];
+    for (int z = 0; z < BRICK_SAMPLES; z++) {
+        for (int y = 0; y < BRICK_SAMPLES; y++) {
+            for (int x = 0; x < BRICK_SAMPLES; x++) {
+                glm::vec3 p = origin + glm::vec3(x, y, z) * voxelSize;
+                SmoothBlender blender;
+                for (int object : nearby) {
+                    blender.add(object, sdfPrimitive(cache->m_bakedTypes[object], p - cache->m_bakedPositions[object],
+                                                          cache->m_bakedSizes[object]));
+                }
+                samples[(z * BRICK_SAMPLES + y) * BRICK_SAMPLES + x] = std::min(blender.result.distance, truncation);
+            }
+        }
+    }
+}
+
+bool SDFBrickCache::wasRebuilt() const {
+    return m_rebuilt;
+}
+
+const std::vector<int>& SDFBrickCache::getDirtyBricks() const {
+    return m_dirtyBricks;
+}
+
+glm::vec3 SDFBrickCache::getGridMin() const {
+    return m_gridMin;
+}
+
+glm::ivec3 SDFBrickCache::getGridSize() const {
+    return m_gridSize;
+}
+
+float SDFBrickCache::getBrickSize() const {
+    return m_brickSize;
+}
+
+float SDFBrickCache::getVoxelSize() const {
+    return m_brickSize / BRICK_VOXELS;
+}
+
+float SDFBrickCache::getTruncation() const {
+    return m_truncation;
+}
+
+const std::vector<float>& SDFBrickCache::getBrickMap() const {
+    return m_brickMap;
+}
+
+const float* SDFBrickCache::getSlotSamples(int slot) const {
+    return &m_atlas[static_cast<size_t>(slot) * BRICK_SAMPLE_COUNT];
+}
+
+int SDFBrickCache::getSlotCount() const {
+    return m_slotCount;
+}
+
+int SDFBrickCache::getAtlasLayers() const {
+    return m_atlasLayers;
+}
+
+const BrickCacheStats& SDFBrickCache::getStats() const {
+    return m_stats;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SceneBVH.h"
+#include "ThreadPool.h"
+
+// Voxels along a brick edge. A brick stores (BRICK_VOXELS + 1)^3 corner samples so
+// neighbouring bricks interpolate seamlessly (BRICK_VOXELS in the fragment shader).
+const int BRICK_VOXELS = 8;
+const int BRICK_SAMPLES = BRICK_VOXELS + 1;
+const int BRICK_SAMPLE_COUNT = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+
+// Atlas slots per row and per layer (the atlas grows in layers of 16 x 16 slots)
+const int BRICK_ATLAS_SLOTS_X = 16;
+const int BRICK_ATLAS_SLOTS_Y = 16;
+
+// Brick map slot values other than an atlas slot
+const int BRICK_EMPTY = -1;  // No surface inside; the distance is at least the stored bound
+const int BRICK_EXACT = -2;  // Inside an object, or the atlas is full: use the exact SDF
+
+// Baking and upload accounting
+struct BrickCacheStats {
+    int brickCount;          // Bricks in the grid
+    int surfaceBricks;       // Bricks with baked samples
+    int lastRebakedBricks;   // Bricks re-baked by the last update()
+    double lastBakeSeconds;  // Time spent in the last update()
+    unsigned long long fullBakes;
+    unsigned long long partialBakes;
+};
+
+// Sparse cache of the blended scene distance for mostly static scenes.
+//
+// The scene bounds are split into bricks. Bricks that contain no surface only keep a
+// conservative lower bound of the distance (one float); bricks that do contain surface
+// keep a grid of samples in an atlas, so the shader can march most of the way without
+// evaluating objects. Samples are truncated at getTruncation(), so an object only affects
+// bricks near it: when objects move, only the bricks around their old and new bounds are
+// re-baked. Baking is spread over a worker pool.
+class SDFBrickCache {
+public:
+    // Constructor (brick edge length in world units; 0 workers = one per hardware thread)
+    explicit SDFBrickCache(float brickSize = 0.5f, int workerCount = 0);
+
+    // Limit the atlas depth (in layers of slots), e.g. from GL_MAX_3D_TEXTURE_SIZE
+    void setMaxAtlasLayers(int layers);
+
+    // Re-bake whatever changed since the last update; returns false if nothing did
+    bool update(const ObjectManager& objects);
+
+    // True if the last update() rebuilt the grid or grew the atlas (everything must be re-sent)
+    bool wasRebuilt() const;
+
+    // Bricks whose map entry (and atlas slot, if any) changed in the last update()
+    const std::vector<int>& getDirtyBricks() const;
+
+    // Grid layout
+    glm::vec3 getGridMin() const;
+    glm::ivec3 getGridSize() const;
+    float getBrickSize() const;
+    float getVoxelSize() const;
+
+    // Largest stored distance; nothing is closer than this to the grid's outside
+    float getTruncation() const;
+
+    // Brick map: two floats per brick (slot or BRICK_EMPTY / BRICK_EXACT, lower bound),
+    // bricks ordered x fastest, then y, then z
+    const std::vector<float>& getBrickMap() const;
+
+    // Samples of an atlas slot (BRICK_SAMPLE_COUNT floats, x fastest)
+    const float* getSlotSamples(int slot) const;
+
+    // Atlas slots in use (highest slot + 1) and layers allocated
+    int getSlotCount() const;
+    int getAtlasLayers() const;
+
+    const BrickCacheStats& getStats() const;
+
+private:
+    // Lay a new grid over the objects and mark every brick dirty
+    void rebuildGrid(const ObjectManager& objects);
+
+    // Mark the bricks an object at center can influence
+    void markBricksNear(const glm::vec3& center);
+
+    // True if an object at center fits inside the grid with the full margin
+    bool insideGrid(const glm::vec3& center) const;
+
+    // Classify and bake the dirty bricks
+    void bakeDirtyBricks();
+
+    // Hand out an atlas slot (BRICK_EXACT if the atlas is full)
+    int allocateSlot();
+
+    glm::vec3 brickMin(int brick) const;
+
+    // Pool callbacks
+    static void classifyTask(void* context, int taskIndex, int workerIndex);
+    static void bakeTask(void* context, int taskIndex, int workerIndex);
+
+    ThreadPool m_pool;
+    SceneBVH m_bvh;
+    float m_brickSize;
+    float m_truncation;
+
+    // Change tracking
+    bool m_synced;
+    unsigned long long m_generation;
+    std::vector<int> m_changedObjects;
+    std::vector<glm::vec3> m_bakedPositions; // Object positions the bricks were baked for
+    std::vector<int> m_bakedTypes;
+    std::vector<float> m_bakedSizes;
+
+    // Grid
+    glm::vec3 m_gridMin;
+    glm::ivec3 m_gridSize;
+    std::vector<float> m_brickMap;
+    std::vector<char> m_brickDirty;
+    std::vector<int> m_dirtyBricks;
+    bool m_rebuilt;
+
+    // Atlas (CPU copy of the baked samples, slot after slot)
+    std::vector<float> m_atlas;
+    std::vector<int> m_freeSlots;
+    int m_slotCount;
+    int m_atlasLayers;
+    int m_maxAtlasLayers;
+
+    // Scratch for bakeDirtyBricks
+    std::vector<float> m_centerDist;
+    std::vector<int> m_bakeBricks;
+    std::vector<std::vector<int>> m_workerObjects; // Objects near the brick, per worker
+
+    BrickCacheStats m_stats;
+};
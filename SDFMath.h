@@ -0,0 +1,380 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// CPU mirrors of the helper functions in the fragment shader (ShaderSources.cpp).
+// Anything rendered or picked on the CPU goes through these so it matches the GPU.
+
+// Smooth-min blend radius used by the shader's sdfScene
+const float SDF_BLEND_K = 0.3f;
+
+// Raymarch limits used by the shader's raymarch
+const int SDF_MAX_STEPS = 64;
+const float SDF_HIT_EPSILON = 0.001f;
+const float SDF_FAR_PLANE = 20.0f;
+
+// Pixels per cone pre-pass tile along each axis (u_coneTileSize in the shader)
+const int SDF_CONE_TILE_SIZE = 8;
+
+// Pixels per object binning tile along each axis (u_binTileSize in the shader); a multiple
+// of SDF_CONE_TILE_SIZE, so every cone tile lies in one binning tile
+const int SDF_BIN_TILE_SIZE = 16;
+
+// What a frame shows (mirrors u_debugView in the fragment shader)
+enum DebugView {
+    DEBUG_VIEW_SHADED = 0,  // Normal shading
+    DEBUG_VIEW_STEPS = 1    // Raymarch steps per pixel as a heatmap
+};
+
+// Objects are 4D primitives centred on their 4D position: hyperspheres (type 0) of this
+// radius and tesseracts (type 1) of this half side
+const float SDF_PRIMITIVE_SIZE = 0.5f;
+
+// Slice size of a primitive the slicing hyperplane misses. Every distance to it is then
+// beyond the 1000 scene distances start at, so it never wins or blends with anything.
+const float SDF_EMPTY_SLICE = -1000.0f;
+
+// Low mantissa bits of a slice size that are always zero, so the renderer can pack the
+// object flags into them without losing anything (the sizes keep 14 mantissa bits)
+const uint32_t SDF_SLICE_FLAG_BITS = 0x1FF;
+
+// Size of the 3D slice through a primitive whose centre is `offset` away from the slicing
+// hyperplane: the radius of the sphere a hypersphere leaves, or the half side of the
+// cube a tesseract leaves (exact for hyperplanes along w; tilted hyperplanes are treated
+// as if they were aligned with the tesseract's faces). SDF_EMPTY_SLICE if it misses.
+inline float sliceSize(int type, float offset) {
+    float size = SDF_EMPTY_SLICE;
+    if (type == 0) {
+        float radiusSq = SDF_PRIMITIVE_SIZE * SDF_PRIMITIVE_SIZE - offset * offset;
+        if (radiusSq > 0.0f) {
+            size = std::sqrt(radiusSq);
+        }
+    } else if (type == 1 && std::fabs(offset) <= SDF_PRIMITIVE_SIZE) {
+        size = SDF_PRIMITIVE_SIZE;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &size, sizeof(bits));
+    bits &= ~SDF_SLICE_FLAG_BITS;
+    std::memcpy(&size, &bits, sizeof(size));
+    return size;
+}
+
+// Radius of a sphere around the slice (of sliceSize) of a primitive of the given type,
+// or -1 if nothing can be hit (an empty slice or an unknown type)
+inline float sliceBoundingRadius(int type, float size) {
+    if (size < 0.0f || (type != 0 && type != 1)) {
+        return -1.0f;
+    }
+    return type == 1 ? size * 1.7320508f : size;
+}
+
+// SDF for a sphere: distance to a sphere of the given radius
+inline float sdfSphere(const glm::vec3& p, float radius) {
+    return glm::length(p) - radius;
+}
+
+// SDF for a cube: distance to a cube of the given half side
+inline float sdfCube(const glm::vec3& p, float halfSize) {
+    glm::vec3 d = glm::abs(p) - glm::vec3(halfSize);
+    return glm::length(glm::max(d, glm::vec3(0.0f))) +
+           std::min(std::max(d.x, std::max(d.y, d.z)), 0.0f);
+}
+
+// Distance to the slice (of sliceSize) of a primitive of the given type centred at the origin
+inline float sdfPrimitive(int type, const glm::vec3& p, float size) {
+    if (type == 0) {
+        return sdfSphere(p, size);
+    } else if (type == 1) {
+        return sdfCube(p, size);
+    }
+    return 1000.0f; // Default large distance for unknown types
+}
+
+// Gradient of sdfSphere (unit length; straight up at the centre)
+inline glm::vec3 sdfSphereGradient(const glm::vec3& p) {
+    float len = glm::length(p);
+    return len > 0.0f ? p / len : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// Gradient of sdfCube: towards the nearest point of the box outside, along the
+// axis of the nearest face inside
+inline glm::vec3 sdfCubeGradient(const glm::vec3& p, float halfSize) {
+    glm::vec3 d = glm::abs(p) - glm::vec3(halfSize);
+    glm::vec3 s(p.x < 0.0f ? -1.0f : 1.0f, p.y < 0.0f ? -1.0f : 1.0f, p.z < 0.0f ? -1.0f : 1.0f);
+    float g = std::max(d.x, std::max(d.y, d.z));
+    if (g > 0.0f) {
+        return s * glm::normalize(glm::max(d, glm::vec3(0.0f)));
+    }
+    if (d.x >= d.y && d.x >= d.z) return glm::vec3(s.x, 0.0f, 0.0f);
+    if (d.y >= d.z) return glm::vec3(0.0f, s.y, 0.0f);
+    return glm::vec3(0.0f, 0.0f, s.z);
+}
+
+// Gradient of sdfPrimitive
+inline glm::vec3 sdfPrimitiveGradient(int type, const glm::vec3& p, float size) {
+    if (type == 0) {
+        return sdfSphereGradient(p);
+    } else if (type == 1) {
+        return sdfCubeGradient(p, size);
+    }
+    return glm::vec3(0.0f);
+}
+
+// Smooth minimum: blends two distances smoothly
+inline float smoothMin(float a, float b, float k) {
+    float h = std::max(k - std::fabs(a - b), 0.0f) / k;
+    return std::min(a, b) - h * h * k * 0.25f;
+}
+
+// Blend weights of a and b for the colour of a smoothMin(a, b, k) result
+inline glm::vec2 smoothMinWeight(float a, float b, float k) {
+    float h = std::max(k - std::fabs(a - b), 0.0f) / k;
+    float m = h * h * 0.5f; // Blend factor
+    return (a < b) ? glm::vec2(1.0f - m, m) : glm::vec2(m, 1.0f - m);
+}
+
+// Partial derivatives of smoothMin(a, b, k) with respect to a and b: the nearer input
+// gets 1 - h / 2 and the other h / 2, so the blended gradient is their weighted sum
+inline glm::vec2 smoothMinGradientWeight(float a, float b, float k) {
+    float h = std::max(k - std::fabs(a - b), 0.0f) / k;
+    float m = h * 0.5f;
+    return (a < b) ? glm::vec2(1.0f - m, m) : glm::vec2(m, 1.0f - m);
+}
+
+// Get color for object based on type and selection state
+inline glm::vec3 getObjectColor(int type, bool selected) {
+    if (selected) {
+        return glm::vec3(0.2f, 0.4f, 0.9f); // Selected objects are blue
+    } else if (type == 0) {
+        return glm::vec3(0.8f, 0.2f, 0.2f); // Sphere - red
+    } else if (type == 1) {
+        return glm::vec3(0.8f, 0.4f, 0.0f); // Cube - orange
+    }
+    return glm::vec3(1.0f); // Default white
+}
+
+// Camera orientation derived from the look angles
+struct ViewBasis {
+    glm::vec3 forward;
+    glm::vec3 right;
+    glm::vec3 up;
+};
+
+// Horizontal look angle for a mouse x position (full rotation across the window)
+inline float horizontalLookAngle(float mouseX, float width) {
+    return -(mouseX / width) * 2.0f * 3.14159f;
+}
+
+// Vertical look angle for a mouse y position (limited tilt)
+inline float verticalLookAngle(float mouseY, float height) {
+    return ((1.0f - mouseY / height) - 0.5f) * 3.14159f * 0.5f;
+}
+
+// Build the camera basis exactly as the fragment shader does
+inline ViewBasis computeViewBasis(float horizontalAngle, float verticalAngle) {
+    ViewBasis basis;
+    basis.forward = glm::normalize(glm::vec3(
+        std::sin(horizontalAngle) * std::cos(verticalAngle),
+        std::sin(verticalAngle),
+        std::cos(horizontalAngle) * std::cos(verticalAngle)
+    ));
+    basis.right = glm::normalize(glm::cross(basis.forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    basis.up = glm::normalize(glm::cross(basis.right, basis.forward));
+    return basis;
+}
+
+// How sdfScene blends objects (mirrors u_blendMode in the fragment shader)
+enum BlendMode {
+    BLEND_FULL = 0,   // Every object is blended against the nearest object before it
+    BLEND_PRUNED = 1  // Plain distances first, then blend only objects within SDF_BLEND_K of the nearest
+};
+
+// Objects the pruned blend keeps around the nearest one (MAX_BLEND_CANDIDATES in the shader)
+const int SDF_MAX_BLEND_CANDIDATES = 8;
+
+// Blended distance and the objects it comes from. Colour and gradient are only resolved
+// from these where a point is shaded (see smoothMinWeight, smoothMinGradientWeight).
+struct BlendResult {
+    float distance;
+    int objectA;        // -1 if nothing is nearer than 1000
+    int objectB;        // -1 if the distance comes from objectA alone
+    float distA;
+    float distB;
+    int nearestObject;  // Closest object (the first one on ties)
+    float nearestDist;
+};
+
+// Streaming form of the shader's sdfScene blend (blendObject). Feed objects in ascending
+// index order; each one is blended against the nearest object fed before it. smoothMin is
+// monotonic in both arguments, so this gives the same result as blending every pair (j < i).
+struct SmoothBlender {
+    BlendResult result;
+
+    SmoothBlender() {
+        reset();
+    }
+
+    void reset() {
+        result.distance = 1000.0f;
+        result.objectA = -1;
+        result.objectB = -1;
+        result.distA = 1000.0f;
+        result.distB = 1000.0f;
+        result.nearestObject = -1;
+        result.nearestDist = 1000.0f;
+    }
+
+    void add(int object, float dist) {
+        // Smooth blend with the nearest previous object
+        if (result.nearestObject >= 0) {
+            float smoothed = smoothMin(dist, result.nearestDist, SDF_BLEND_K);
+            if (smoothed < result.distance) {
+                result.distance = smoothed;
+                result.objectA = object;
+                result.objectB = result.nearestObject;
+                result.distA = dist;
+                result.distB = result.nearestDist;
+            }
+        }
+
+        // Also check the individual distance
+        if (dist < result.distance) {
+            result.distance = dist;
+            result.objectA = object;
+            result.objectB = -1;
+            result.distA = dist;
+        }
+
+        if (dist < result.nearestDist) {
+            result.nearestDist = dist;
+            result.nearestObject = object;
+        }
+    }
+};
+
+// Objects close enough to the nearest one to change the blended result.
+// A pair can only blend below the nearest distance d0 if both of its distances are below
+// d0 + SDF_BLEND_K, so only those objects are kept (at most SDF_MAX_BLEND_CANDIDATES of them,
+// the nearest win). The final set doesn't depend on the order objects are added in.
+struct BlendCandidates {
+    float minDist;
+    int count;
+    int objects[SDF_MAX_BLEND_CANDIDATES];
+    float dists[SDF_MAX_BLEND_CANDIDATES];
+
+    BlendCandidates() {
+        reset();
+    }
+
+    void reset() {
+        minDist = 1000.0f;
+        count = 0;
+    }
+
+    void add(int object, float dist) {
+        if (dist >= minDist + SDF_BLEND_K) {
+            return;
+        }
+
+        if (dist < minDist) {
+            // New nearest object: drop candidates that are now out of range
+            minDist = dist;
+            int kept = 0;
+            for (int c = 0; c < count; c++) {
+                if (dists[c] < minDist + SDF_BLEND_K) {
+                    objects[kept] = objects[c];
+                    dists[kept] = dists[c];
+                    kept++;
+                }
+            }
+            count = kept;
+        }
+
+        if (count < SDF_MAX_BLEND_CANDIDATES) {
+            objects[count] = object;
+            dists[count] = dist;
+            count++;
+            return;
+        }
+
+        // Full: replace the farthest candidate if this one is nearer
+        int farthest = 0;
+        for (int c = 1; c < count; c++) {
+            if (dists[c] > dists[farthest]) farthest = c;
+        }
+        if (dist < dists[farthest]) {
+            objects[farthest] = object;
+            dists[farthest] = dist;
+        }
+    }
+
+    // Blend the candidates in ascending object order
+    BlendResult blend() {
+        for (int c = 1; c < count; c++) {
+            int object = objects[c];
+            float dist = dists[c];
+            int d = c - 1;
+            while (d >= 0 && objects[d] > object) {
+                objects[d + 1] = objects[d];
+                dists[d + 1] = dists[d];
+                d--;
+            }
+            objects[d + 1] = object;
+            dists[d + 1] = dist;
+        }
+
+        SmoothBlender blender;
+        for (int c = 0; c < count; c++) {
+            blender.add(objects[c], dists[c]);
+        }
+        return blender.result;
+    }
+};
+
+// Everything needed to shade a point, from one scene evaluation (SDFSample in the shader)
+struct SDFSample {
+    float distance;
+    glm::vec3 normal;
+    glm::vec3 color;
+    int objectIndex;   // Object hit at the point (closest within 0.01), or -1
+};
+
+// Cone marching for the pre-pass, as the shader's coneMarch. Every ray of a tile stays
+// within coneSlope * t of the centre ray at distance t, so a step of the clearance
+// d - coneSlope * t divided by (1 + coneSlope) can't skip a surface for any of them.
+// Returns the distance the tile's rays can safely start at (beyond the far plane if they
+// all miss); steps receives the distance evaluations taken.
+template <typename SceneDistance>
+inline float coneMarch(const SceneDistance& sceneDistance, const glm::vec3& ro, const glm::vec3& rd,
+                       float coneSlope, int& steps) {
+    float t = 0.0f;
+    steps = 0;
+    for (int i = 0; i < SDF_MAX_STEPS; i++) {
+        float clearance = sceneDistance(ro + rd * t) - coneSlope * t;
+        steps++;
+        if (clearance < SDF_HIT_EPSILON + coneSlope * t) {
+            return t; // The cone is about as wide as the gap: leave the rest to the pixels
+        }
+        t += clearance / (1.0f + coneSlope);
+        if (t > SDF_FAR_PLANE) return 1e6f; // Too far, every ray of the tile misses
+    }
+    return t;
+}
+
+// Cone slope covering the rays of a square tile of tileSize pixels (half its diagonal in uv units)
+inline float coneSlopeForTile(int tileSize, int height) {
+    return static_cast<float>(tileSize) * 1.41421f / static_cast<float>(height);
+}
+
+// Blue (few steps) through green to red (the 64-step limit), as the shader's stepHeatmap
+inline glm::vec3 stepHeatmap(int steps) {
+    float x = std::min(std::max(static_cast<float>(steps) / 64.0f, 0.0f), 1.0f);
+    auto smoothstep = [](float e0, float e1, float v) {
+        float u = std::min(std::max((v - e0) / (e1 - e0), 0.0f), 1.0f);
+        return u * u * (3.0f - 2.0f * u);
+    };
+    return glm::vec3(smoothstep(0.5f, 1.0f, x), 1.0f - std::fabs(2.0f * x - 1.0f), 1.0f - smoothstep(0.0f, 0.5f, x));
+}
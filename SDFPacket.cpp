@@ -0,0 +1,344 @@
+#include "SDFPacket.h"
+#include "SDFMath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SDF_PACKET_X86 1
+#endif
+
+PacketScene makePacketScene(const ObjectManager& objects) {
+    PacketScene scene;
+    scene.types = objects.getTypesArray();
+    scene.x = objects.getProjectedXArray();
+    scene.y = objects.getProjectedYArray();
+    scene.z = objects.getProjectedZArray();
+    scene.size = objects.getSliceSizeArray();
+    scene.count = objects.getObjectCount();
+    return scene;
+}
+
+// --- Scalar reference ---
+//
+// The blended mode walks the objects once, blending each distance against the minimum of the
+// distances before it. smoothMin is monotonic in both arguments, so for every object the best
+// partner among the earlier ones is the nearest of them, and this yields the same value as the
+// shader's loop over all pairs j < i.
+
+static void packetDistanceScalar(const PacketScene& scene, const float* px, const float* py, const float* pz,
+                                 unsigned laneMask, int mode, float* outDist) {
+    for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+        if (!(laneMask & (1u << lane))) continue;
+
+        glm::vec3 p(px[lane], py[lane], pz[lane]);
+        float result = 1000.0f;
+        float prefix = 1000.0f;
+        for (int i = 0; i < scene.count; i++) {
+            float d = sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]);
+            if (mode == PACKET_MIN_DISTANCE) {
+                result = std::min(result, d);
+            } else {
+                result = std::min(result, smoothMin(d, prefix, SDF_BLEND_K));
+                prefix = std::min(prefix, d);
+            }
+        }
+        outDist[lane] = result;
+    }
+}
+
+static float pointDistanceScalar(const PacketScene& scene, const glm::vec3& p) {
+    float result = 1000.0f;
+    for (int i = 0; i < scene.count; i++) {
+        result = std::min(result, sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]));
+    }
+    return result;
+}
+
+#ifdef SDF_PACKET_X86
+
+// --- SSE (4 lanes, two halves per packet) ---
+
+static inline __m128 absSSE(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+static inline __m128 selectSSE(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); // mask ? a : b
+}
+
+static inline __m128 sphereSSE(__m128 dx, __m128 dy, __m128 dz, __m128 radius) {
+    __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return _mm_sub_ps(_mm_sqrt_ps(lenSq), radius);
+}
+
+static inline __m128 cubeSSE(__m128 dx, __m128 dy, __m128 dz, __m128 half) {
+    __m128 zero = _mm_setzero_ps();
+    __m128 qx = _mm_sub_ps(absSSE(dx), half);
+    __m128 qy = _mm_sub_ps(absSSE(dy), half);
+    __m128 qz = _mm_sub_ps(absSSE(dz), half);
+    __m128 ox = _mm_max_ps(qx, zero);
+    __m128 oy = _mm_max_ps(qy, zero);
+    __m128 oz = _mm_max_ps(qz, zero);
+    __m128 outside = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)));
+    __m128 inside = _mm_min_ps(_mm_max_ps(qx, _mm_max_ps(qy, qz)), zero);
+    return _mm_add_ps(outside, inside);
+}
+
+static inline __m128 smoothMinSSE(__m128 a, __m128 b) {
+    __m128 k = _mm_set1_ps(SDF_BLEND_K);
+    __m128 h = _mm_div_ps(_mm_max_ps(_mm_sub_ps(k, absSSE(_mm_sub_ps(a, b))), _mm_setzero_ps()), k);
+    return _mm_sub_ps(_mm_min_ps(a, b), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(h, h), k), _mm_set1_ps(0.25f)));
+}
+
+static void packetDistanceHalfSSE(const PacketScene& scene, const float* px, const float* py, const float* pz,
+                                  int mode, float* outDist) {
+    __m128 x = _mm_loadu_ps(px);
+    __m128 y = _mm_loadu_ps(py);
+    __m128 z = _mm_loadu_ps(pz);
+    __m128 result = _mm_set1_ps(1000.0f);
+    __m128 prefix = _mm_set1_ps(1000.0f);
+
+    for (int i = 0; i < scene.count; i++) {
+        // Every lane sees the same object, so the type branch doesn't diverge
+        __m128 dx = _mm_sub_ps(x, _mm_set1_ps(scene.x[i]));
+        __m128 dy = _mm_sub_ps(y, _mm_set1_ps(scene.y[i]));
+        __m128 dz = _mm_sub_ps(z, _mm_set1_ps(scene.z[i]));
+        __m128 size = _mm_set1_ps(scene.size[i]);
+        __m128 d;
+        if (scene.types[i] == 0) {
+            d = sphereSSE(dx, dy, dz, size);
+        } else if (scene.types[i] == 1) {
+            d = cubeSSE(dx, dy, dz, size);
+        } else {
+            d = _mm_set1_ps(1000.0f);
+        }
+
+        if (mode == PACKET_MIN_DISTANCE) {
+            result = _mm_min_ps(result, d);
+        } else {
+            result = _mm_min_ps(result, smoothMinSSE(d, prefix));
+            prefix = _mm_min_ps(prefix, d);
+        }
+    }
+    _mm_storeu_ps(outDist, result);
+}
+
+static void packetDistanceSSE(const PacketScene& scene, const float* px, const float* py, const float* pz,
+                              unsigned laneMask, int mode, float* outDist) {
+    if (laneMask & 0x0Fu) packetDistanceHalfSSE(scene, px, py, pz, mode, outDist);
+    if (laneMask & 0xF0u) packetDistanceHalfSSE(scene, px + 4, py + 4, pz + 4, mode, outDist + 4);
+}
+
+static float pointDistanceSSE(const PacketScene& scene, const glm::vec3& p) {
+    __m128 px = _mm_set1_ps(p.x);
+    __m128 py = _mm_set1_ps(p.y);
+    __m128 pz = _mm_set1_ps(p.z);
+    __m128 far = _mm_set1_ps(1000.0f);
+    __m128i sphereType = _mm_set1_epi32(0);
+    __m128i cubeType = _mm_set1_epi32(1);
+    __m128 result = far;
+
+    // Four objects per iteration
+    int i = 0;
+    for (; i + 4 <= scene.count; i += 4) {
+        __m128 dx = _mm_sub_ps(px, _mm_loadu_ps(scene.x + i));
+        __m128 dy = _mm_sub_ps(py, _mm_loadu_ps(scene.y + i));
+        __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(scene.z + i));
+        __m128i types = _mm_loadu_si128(reinterpret_cast<const __m128i*>(scene.types + i));
+        __m128 isSphere = _mm_castsi128_ps(_mm_cmpeq_epi32(types, sphereType));
+        __m128 isCube = _mm_castsi128_ps(_mm_cmpeq_epi32(types, cubeType));
+        __m128 size = _mm_loadu_ps(scene.size + i);
+        __m128 d = selectSSE(isSphere, sphereSSE(dx, dy, dz, size), far);
+        d = selectSSE(isCube, cubeSSE(dx, dy, dz, size), d);
+        result = _mm_min_ps(result, d);
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, result);
+    float minDist = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    for (; i < scene.count; i++) {
+        minDist = std::min(minDist, sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]));
+    }
+    return minDist;
+}
+
+// --- AVX2 (8 lanes) ---
+
+#define SDF_AVX2 __attribute__((target("avx2")))
+
+SDF_AVX2 static inline __m256 absAVX(__m256 v) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+SDF_AVX2 static inline __m256 sphereAVX(__m256 dx, __m256 dy, __m256 dz, __m256 radius) {
+    __m256 lenSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+    return _mm256_sub_ps(_mm256_sqrt_ps(lenSq), radius);
+}
+
+SDF_AVX2 static inline __m256 cubeAVX(__m256 dx, __m256 dy, __m256 dz, __m256 half) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 qx = _mm256_sub_ps(absAVX(dx), half);
+    __m256 qy = _mm256_sub_ps(absAVX(dy), half);
+    __m256 qz = _mm256_sub_ps(absAVX(dz), half);
+    __m256 ox = _mm256_max_ps(qx, zero);
+    __m256 oy = _mm256_max_ps(qy, zero);
+    __m256 oz = _mm256_max_ps(qz, zero);
+    __m256 outside = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)),
+                                                  _mm256_mul_ps(oz, oz)));
+    __m256 inside = _mm256_min_ps(_mm256_max_ps(qx, _mm256_max_ps(qy, qz)), zero);
+    return _mm256_add_ps(outside, inside);
+}
+
+SDF_AVX2 static inline __m256 smoothMinAVX(__m256 a, __m256 b) {
+    __m256 k = _mm256_set1_ps(SDF_BLEND_K);
+    __m256 h = _mm256_div_ps(_mm256_max_ps(_mm256_sub_ps(k, absAVX(_mm256_sub_ps(a, b))), _mm256_setzero_ps()), k);
+    return _mm256_sub_ps(_mm256_min_ps(a, b),
+                         _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(h, h), k), _mm256_set1_ps(0.25f)));
+}
+
+SDF_AVX2 static void packetDistanceAVX2(const PacketScene& scene, const float* px, const float* py, const float* pz,
+                                        unsigned laneMask, int mode, float* outDist) {
+    if (!laneMask) return;
+
+    __m256 x = _mm256_loadu_ps(px);
+    __m256 y = _mm256_loadu_ps(py);
+    __m256 z = _mm256_loadu_ps(pz);
+    __m256 result = _mm256_set1_ps(1000.0f);
+    __m256 prefix = _mm256_set1_ps(1000.0f);
+
+    for (int i = 0; i < scene.count; i++) {
+        __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(scene.x[i]));
+        __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(scene.y[i]));
+        __m256 dz = _mm256_sub_ps(z, _mm256_set1_ps(scene.z[i]));
+        __m256 size = _mm256_set1_ps(scene.size[i]);
+        __m256 d;
+        if (scene.types[i] == 0) {
+            d = sphereAVX(dx, dy, dz, size);
+        } else if (scene.types[i] == 1) {
+            d = cubeAVX(dx, dy, dz, size);
+        } else {
+            d = _mm256_set1_ps(1000.0f);
+        }
+
+        if (mode == PACKET_MIN_DISTANCE) {
+            result = _mm256_min_ps(result, d);
+        } else {
+            result = _mm256_min_ps(result, smoothMinAVX(d, prefix));
+            prefix = _mm256_min_ps(prefix, d);
+        }
+    }
+    _mm256_storeu_ps(outDist, result);
+}
+
+SDF_AVX2 static float pointDistanceAVX2(const PacketScene& scene, const glm::vec3& p) {
+    __m256 px = _mm256_set1_ps(p.x);
+    __m256 py = _mm256_set1_ps(p.y);
+    __m256 pz = _mm256_set1_ps(p.z);
+    __m256 far = _mm256_set1_ps(1000.0f);
+    __m256i sphereType = _mm256_set1_epi32(0);
+    __m256i cubeType = _mm256_set1_epi32(1);
+    __m256 result = far;
+
+    // Eight objects per iteration
+    int i = 0;
+    for (; i + 8 <= scene.count; i += 8) {
+        __m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(scene.x + i));
+        __m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(scene.y + i));
+        __m256 dz = _mm256_sub_ps(pz, _mm256_loadu_ps(scene.z + i));
+        __m256i types = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(scene.types + i));
+        __m256 isSphere = _mm256_castsi256_ps(_mm256_cmpeq_epi32(types, sphereType));
+        __m256 isCube = _mm256_castsi256_ps(_mm256_cmpeq_epi32(types, cubeType));
+        __m256 size = _mm256_loadu_ps(scene.size + i);
+        __m256 d = _mm256_blendv_ps(far, sphereAVX(dx, dy, dz, size), isSphere);
+        d = _mm256_blendv_ps(d, cubeAVX(dx, dy, dz, size), isCube);
+        result = _mm256_min_ps(result, d);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, result);
+    float minDist = lanes[0];
+    for (int lane = 1; lane < 8; lane++) {
+        minDist = std::min(minDist, lanes[lane]);
+    }
+    for (; i < scene.count; i++) {
+        minDist = std::min(minDist, sdfPrimitive(scene.types[i], p - glm::vec3(scene.x[i], scene.y[i], scene.z[i]), scene.size[i]));
+    }
+    return minDist;
+}
+
+#endif // SDF_PACKET_X86
+
+// --- Dispatch ---
+
+static const PacketKernels s_kernels[] = {
+    { SIMD_SCALAR, "scalar", packetDistanceScalar, pointDistanceScalar },
+#ifdef SDF_PACKET_X86
+    { SIMD_SSE, "sse", packetDistanceSSE, pointDistanceSSE },
+    { SIMD_AVX2, "avx2", packetDistanceAVX2, pointDistanceAVX2 },
+#endif
+};
+
+SimdLevel detectSimdLevel() {
+#ifdef SDF_PACKET_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE;
+#endif
+    return SIMD_SCALAR;
+}
+
+const PacketKernels& getPacketKernels(SimdLevel level) {
+    SimdLevel supported = detectSimdLevel();
+    if (level > supported) {
+        level = supported;
+    }
+    return s_kernels[level];
+}
+
+const PacketKernels& getPacketKernels() {
+    static const PacketKernels& best = getPacketKernels(detectSimdLevel());
+    return best;
+}
+
+void raymarchPacket(const PacketKernels& kernels, const PacketScene& scene, int mode, RayPacket& packet) {
+    alignas(32) float px[SDF_PACKET_WIDTH] = {};
+    alignas(32) float py[SDF_PACKET_WIDTH] = {};
+    alignas(32) float pz[SDF_PACKET_WIDTH] = {};
+    alignas(32) float dist[SDF_PACKET_WIDTH];
+    float t[SDF_PACKET_WIDTH];
+
+    unsigned active = packet.laneMask;
+    for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+        t[lane] = packet.tStart[lane];
+        packet.t[lane] = -1.0f;
+        packet.steps[lane] = 0;
+        if (t[lane] > SDF_FAR_PLANE) {
+            active &= ~(1u << lane); // Nothing in reach
+        }
+    }
+
+    for (int step = 0; step < SDF_MAX_STEPS && active; step++) {
+        for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+            if (!(active & (1u << lane))) continue;
+            px[lane] = packet.ox[lane] + packet.dx[lane] * t[lane];
+            py[lane] = packet.oy[lane] + packet.dy[lane] * t[lane];
+            pz[lane] = packet.oz[lane] + packet.dz[lane] * t[lane];
+        }
+
+        kernels.packetDistance(scene, px, py, pz, active, mode, dist);
+
+        for (int lane = 0; lane < SDF_PACKET_WIDTH; lane++) {
+            unsigned bit = 1u << lane;
+            if (!(active & bit)) continue;
+            packet.steps[lane]++;
+            if (dist[lane] < SDF_HIT_EPSILON) {
+                packet.t[lane] = t[lane]; // Hit: mask the lane off
+                active &= ~bit;
+                continue;
+            }
+            t[lane] += dist[lane];
+            if (t[lane] > SDF_FAR_PLANE) {
+                active &= ~bit; // Too far, miss
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+
+// Number of rays evaluated together by the packet kernels
+const int SDF_PACKET_WIDTH = 8;
+
+// Struct-of-arrays view of the object data read by the packet kernels
+struct PacketScene {
+    const int* types;
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* size;  // Slice sizes (sliceSize)
+    int count;
+};
+
+// View of the (3D mapped) objects of an ObjectManager, without copying
+// (valid until objects are added)
+PacketScene makePacketScene(const ObjectManager& objects);
+
+// What a distance query returns
+enum PacketDistanceMode {
+    PACKET_MIN_DISTANCE = 0,     // Plain minimum over all objects (picking)
+    PACKET_BLENDED_DISTANCE = 1  // Smooth-min blended distance, as the fragment shader marches
+};
+
+// Instruction set used by a kernel
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE = 1,
+    SIMD_AVX2 = 2
+};
+
+// Scene distance at 8 points (one per lane); lanes outside laneMask are left undefined
+typedef void (*PacketDistanceKernel)(const PacketScene& scene, const float* px, const float* py, const float* pz,
+                                     unsigned laneMask, int mode, float* outDist);
+
+// Plain minimum scene distance at a single point, vectorised across objects
+typedef float (*PointDistanceKernel)(const PacketScene& scene, const glm::vec3& p);
+
+// A set of kernels for one instruction set
+struct PacketKernels {
+    SimdLevel level;
+    const char* name;
+    PacketDistanceKernel packetDistance;
+    PointDistanceKernel pointDistance;
+};
+
+// Best instruction set supported by the running CPU
+SimdLevel detectSimdLevel();
+
+// Kernels for a specific instruction set (falls back to a lower level if unsupported)
+const PacketKernels& getPacketKernels(SimdLevel level);
+
+// Kernels for the best instruction set on this CPU (detected once)
+const PacketKernels& getPacketKernels();
+
+// Eight rays marched together, one lane per ray
+struct alignas(32) RayPacket {
+    float ox[SDF_PACKET_WIDTH], oy[SDF_PACKET_WIDTH], oz[SDF_PACKET_WIDTH]; // Origins
+    float dx[SDF_PACKET_WIDTH], dy[SDF_PACKET_WIDTH], dz[SDF_PACKET_WIDTH]; // Directions
+    float tStart[SDF_PACKET_WIDTH]; // Distance to start marching at (e.g. from the cone pre-pass)
+    float t[SDF_PACKET_WIDTH];   // Result: distance to the hit, or -1 on a miss
+    int steps[SDF_PACKET_WIDTH]; // Result: distance evaluations taken
+    unsigned laneMask;           // Lanes holding a ray
+};
+
+// Raymarch the lanes in packet.laneMask with the shader's step/hit/far limits, starting at
+// tStart. Lanes drop out of the mask as soon as they hit or leave the scene.
+void raymarchPacket(const PacketKernels& kernels, const PacketScene& scene, int mode, RayPacket& packet);
@@ -1,13 +1,28 @@
 #include <cmath>
 #include "SDFRenderer.h"
 #include "ShaderSources.h"
-#include "CoordSystem.h"
+#include "SceneFile.h"
+#include "AllocationCounter.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <glm/glm.hpp>
 
-SDFRenderer::SDFRenderer() : VAO(0), VBO(0), EBO(0), width(800), height(600), mouseX(0.0f), mouseY(0.0f),
+SDFRenderer::SDFRenderer() : VAO(0), VBO(0), EBO(0), objectBuffer(0), objectTexture(0), objectIdBuffer(0), objectIdTexture(0),
+    maxObjectTexels(0), objectCapacity(0), objectBufferValid(false), uploadedGeneration(0), uploadStats(), cullingEnabled(true),
+    tileBinningEnabled(true), tileRangeBuffer(0), tileRangeTexture(0), tileObjectBuffer(0), tileObjectTexture(0),
+    tileBinsValid(false), binnedPosition(0.0f), binnedForward(0.0f), binnedWidth(0), binnedHeight(0), binnedUploads(0),
+    blendMode(BLEND_PRUNED), brickCacheEnabled(false), brickCacheUploaded(false), brickMapBuffer(0),
+    brickMapTexture(0), brickAtlasTexture(0), dynamicResolutionEnabled(true), resolutionScale(1.0f),
+    sceneFramebuffer(0), sceneColorTexture(0), sceneObjectIdTexture(0), sceneTargetWidth(0), sceneTargetHeight(0),
+    gpuPickingEnabled(true), pickBuffers(), pickFences(), pickNext(0),
+    conePrepassEnabled(true), coneFramebuffer(0), coneDepthTexture(0), coneTargetWidth(0), coneTargetHeight(0),
+    debugView(DEBUG_VIEW_SHADED), gpuTimerQueries(), gpuTimerScales(), gpuTimerShaderSamples(), gpuTimerPending(), gpuTimerNext(0), gpuFrameTime(0.0f),
+    overlayVAO(0), overlayVBO(0), frameAllocations(0), width(800), height(600), mouseX(0.0f), mouseY(0.0f),
     mouseLeftPressed(false), dragStartX(0.0f), dragStartY(0.0f), currentDragX(0.0f), currentDragY(0.0f),
     savedDragX(0.0f), savedDragY(0.0f), cameraX(0.0f), cameraY(0.0f), cameraZ(2.0f), cameraW(7.0f),
+    sceneShader(nullptr), shaderSpecialisationEnabled(true),
+    pickRayOrigin(0.0f), pickRayDirection(0.0f),
     draggingShape(false), selectedShape(0), draggedObjectIndex(-1), objectUnderCursor(-1), shiftKeyPressed(false) {
     // Initialize global camera position
     ::cameraX = 0.0f;
@@ -53,29 +68,162 @@ bool SDFRenderer::initialize() {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     
+    // Create the object data texture buffer (filled every frame in render)
+    glGenBuffers(1, &objectBuffer);
+    glGenTextures(1, &objectTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, objectTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, objectBuffer);
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxObjectTexels);
+    glGenBuffers(1, &objectIdBuffer);
+    glGenTextures(1, &objectIdTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, objectIdBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLint), NULL, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, objectIdTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, objectIdBuffer);
+    
+    // Create the tile binning texture buffers (filled every frame in render)
+    GLint emptyRange[2] = {0, 0};
+    glGenBuffers(1, &tileRangeBuffer);
+    glGenTextures(1, &tileRangeTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, tileRangeBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(emptyRange), emptyRange, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, tileRangeTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, tileRangeBuffer);
+    glGenBuffers(1, &tileObjectBuffer);
+    glGenTextures(1, &tileObjectTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, tileObjectBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(GLint), NULL, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, tileObjectTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32I, tileObjectBuffer);
+    tileBinsValid = false;
+    
+    // Create the brick cache textures (filled when the cache is enabled)
+    float emptyBrick[2] = {static_cast<float>(BRICK_EMPTY), 0.0f};
+    glGenBuffers(1, &brickMapBuffer);
+    glGenTextures(1, &brickMapTexture);
+    glBindBuffer(GL_TEXTURE_BUFFER, brickMapBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(emptyBrick), emptyBrick, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, brickMapTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, brickMapBuffer);
+    
+    glGenTextures(1, &brickAtlasTexture);
+    glBindTexture(GL_TEXTURE_3D, brickAtlasTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, 1, 1, 1, 0, GL_RED, GL_FLOAT, NULL);
+    
+    GLint max3DTextureSize = 0;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3DTextureSize);
+    brickCache.setMaxAtlasLayers(max3DTextureSize / BRICK_SAMPLES);
+    brickCacheUploaded = false;
+    
+    // Offscreen targets for dynamic resolution (sized on first use) and the cone pre-pass,
+    // and the GPU timers
+    glGenFramebuffers(1, &sceneFramebuffer);
+    glGenTextures(1, &sceneColorTexture);
+    glGenTextures(1, &sceneObjectIdTexture);
+    sceneTargetWidth = sceneTargetHeight = 0;
+    glGenFramebuffers(1, &coneFramebuffer);
+    glGenTextures(1, &coneDepthTexture);
+    glBindTexture(GL_TEXTURE_2D, coneDepthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, 1, 1, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    coneTargetWidth = coneTargetHeight = 0;
+    glGenQueries(GPU_TIMER_QUERIES, gpuTimerQueries);
+    
+    // Pixel buffers receiving the object ID under the cursor
+    glGenBuffers(PICK_READBACKS, pickBuffers);
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pickBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLint), NULL, GL_STREAM_READ);
+        pickFences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pickNext = 0;
+    for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        gpuTimerPending[i] = false;
+    }
+    gpuTimerNext = 0;
+    
     // Compile shaders
     if (!shader.compile(vertexShaderSource, fragmentShaderSource)) {
         std::cerr << "Failed to compile shaders!" << std::endl;
         return false;
     }
     
+    // Profiler GPU queries and the overlay's vertex stream (x, y, r, g, b)
+    profiler.initializeGpu();
+    if (!overlayShader.compile(overlayVertexShaderSource, overlayFragmentShaderSource)) {
+        std::cerr << "Failed to compile profiler overlay shaders!" << std::endl;
+        return false;
+    }
+    glGenVertexArrays(1, &overlayVAO);
+    glGenBuffers(1, &overlayVBO);
+    glBindVertexArray(overlayVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    
     return true;
 }
 
 void SDFRenderer::render(float time) {
-    // Use shader
-    shader.use();
+    AllocationScope allocations;
+    frameArena.reset();
+    profiler.beginFrame();
     
-    // Reset the object under cursor and update it based on hover
-    objectUnderCursor = -1;
+    // Page the world's cells around the camera in and out of the objects
+    if (world.isOpen()) {
+        ProfileScope scope(profiler, "world paging");
+        if (world.update(glm::vec3(cameraX, cameraY, cameraZ), objectManager)) {
+            discardObjectIndices();
+        }
+    }
     
-    // First update the object under cursor
-    updateObjectUnderCursor();
+    // Bring the objects' 3D positions up to date with the projection and camera W
+    objectManager.setProjection(projection, cameraW);
+    
+    // Use the shader specialised to the scene once it has compiled, the generic one until then
+    sceneShader = &shader;
+    int shaderSample = -1;
+    if (shaderSpecialisationEnabled) {
+        ProfileScope scope(profiler, "shader variant");
+        Shader* variant = sceneShaders.getProgram(objectManager, shaderSample);
+        if (variant) {
+            sceneShader = variant;
+        }
+    }
+    sceneShader->use();
+    
+    // First update the object under cursor: from the ID buffer the shader wrote a frame or
+    // two ago, or from the CPU picking worker
+    if (gpuPickingEnabled) {
+        readPickResults();
+    } else {
+        updateObjectUnderCursor();
+    }
     
-    // Auto-select the object under cursor (hover selection)
-    objectManager.clearSelections();
+    // Auto-select the object under cursor (hover selection). The selection is only
+    // rewritten when the hovered object changes, so a steady hover dirties nothing.
+    bool hoverSelected = objectUnderCursor >= 0
+        ? objectManager.getSelectedCount() == 1 && objectManager.isObjectSelected(objectUnderCursor)
+        : objectManager.getSelectedCount() == 0;
+    if (!hoverSelected) {
+        objectManager.clearSelections();
+        if (objectUnderCursor >= 0) {
+            objectManager.selectObject(objectUnderCursor);
+        }
+    }
     if (objectUnderCursor >= 0) {
-        objectManager.selectObject(objectUnderCursor);
         
         // If mouse is pressed, this becomes the dragged object
         if (mouseLeftPressed && draggedObjectIndex == -1) {
@@ -84,8 +232,8 @@ void SDFRenderer::render(float time) {
             // Store initial position and distance from camera
             draggedObjectInitialPos = objectManager.getObjectPosition(draggedObjectIndex);
             // Calculate distance using the 3D mapped positions
-            glm::vec3 mappedObjectPos = getmapcoord(draggedObjectInitialPos);
-            glm::vec3 mappedCameraPos = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
+            glm::vec3 mappedObjectPos = projection.project(draggedObjectInitialPos, cameraW);
+            glm::vec3 mappedCameraPos = mapCameraPosition();
             draggedObjectDistance = glm::length(mappedObjectPos - mappedCameraPos);
         }
     }
@@ -104,137 +252,741 @@ void SDFRenderer::render(float time) {
         );
         
         // Scale the direction vector by the distance to keep object at constant distance
-        glm::vec3 mappedCameraPos = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
+        glm::vec3 mappedCameraPos = mapCameraPosition();
         glm::vec3 newPosition3D = mappedCameraPos + direction * draggedObjectDistance;
         
         // Update the object's position - convert 3D position to 4D
         objectManager.setObject3DPosition(draggedObjectIndex, newPosition3D);
     }
     
-    // Set basic uniforms
-    shader.setVec2("u_resolution", static_cast<float>(width), static_cast<float>(height));
-    shader.setFloat("u_time", time);
-    shader.setVec2("u_mouse", mouseX, mouseY);
-    shader.setFloat("u_isDragging", mouseLeftPressed ? 1.0f : 0.0f);
-    // Send the mapped (3D) camera position to the shader
-    glm::vec3 mappedCameraPos = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
-    shader.setVec3("u_cameraPos", mappedCameraPos.x, mappedCameraPos.y, mappedCameraPos.z);
+    // Pick this frame's resolution from the GPU times measured so far
+    readGpuTimers();
+    resolutionScale = dynamicResolutionEnabled ? resolutionGovernor.getScale() : 1.0f;
+    int renderWidth = std::max(1, static_cast<int>(std::lround(width * resolutionScale)));
+    int renderHeight = std::max(1, static_cast<int>(std::lround(height * resolutionScale)));
+    bool scaled = renderWidth < width || renderHeight < height;
     
-    // Set object data uniforms
-    int objectCount = objectManager.getObjectCount();
-    shader.setInt("u_objectCount", objectCount);
+    // Set basic uniforms (the mouse is scaled with the resolution so the view angles don't change)
+    {
+        ProfileScope scope(profiler, "uniforms");
+        sceneShader->setVec2("u_resolution", static_cast<float>(renderWidth), static_cast<float>(renderHeight));
+        sceneShader->setFloat("u_time", time);
+        sceneShader->setVec2("u_mouse", mouseX * renderWidth / width, mouseY * renderHeight / height);
+        sceneShader->setFloat("u_isDragging", mouseLeftPressed ? 1.0f : 0.0f);
+        sceneShader->setInt("u_blendMode", static_cast<int>(blendMode));
+        // Send the mapped (3D) camera position to the shader
+        glm::vec3 mappedCameraPos = mapCameraPosition();
+        sceneShader->setVec3("u_cameraPos", mappedCameraPos.x, mappedCameraPos.y, mappedCameraPos.z);
+    }
     
-    // Update object types and positions in shader
-    for (int i = 0; i < objectCount; i++) {
-        std::string typeIndex = "u_objectTypes[" + std::to_string(i) + "]";
-        shader.setInt(typeIndex, objectManager.getObjectType(i));
-        
-        std::string posIndex = "u_objectPositions[" + std::to_string(i) + "]";
-        glm::vec3 pos = objectManager.getObject3DPosition(i); // Get mapped 3D position
-        shader.setVec3(posIndex, pos.x, pos.y, pos.z);
-        
-        std::string selIndex = "u_objectSelected[" + std::to_string(i) + "]";
-        shader.setInt(selIndex, objectManager.isObjectSelected(i) ? 1 : 0);
+    // Cull against this frame's view, after the drag has moved its object
+    glm::vec3 viewPosition = mapCameraPosition();
+    ViewBasis viewBasis = computeViewBasis(horizontalLookAngle(mouseX, static_cast<float>(width)),
+                                           verticalLookAngle(mouseY, static_cast<float>(height)));
+    {
+        ProfileScope scope(profiler, "culling");
+        if (cullingEnabled && sceneShader == &shader) {
+            culler.cull(objectManager, viewPosition, viewBasis,
+                        static_cast<float>(renderWidth) / static_cast<float>(renderHeight));
+        } else {
+            culler.selectAll(objectManager);
+        }
+    }
+    
+    // Upload the visible objects' data and bind it for the shader, then the tile lists over it
+    uploadObjectData();
+    uploadTileBins(viewPosition, viewBasis, renderWidth, renderHeight);
+    
+    // The brick cache textures are always bound (samplers of different types can't share a unit)
+    if (brickCacheEnabled) {
+        uploadBrickCache();
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, brickMapTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_3D, brickAtlasTexture);
+    glActiveTexture(GL_TEXTURE0);
+    sceneShader->setInt("u_brickMap", 1);
+    sceneShader->setInt("u_brickAtlas", 2);
+    sceneShader->setInt("u_useBrickCache", brickCacheEnabled ? 1 : 0);
+    
+    // Scaled frames go to the corner of the offscreen target and are upscaled into
+    // whatever framebuffer the caller had bound. GPU picking needs the target's object ID
+    // attachment, so it renders offscreen at any scale.
+    GLint targetFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+    bool offscreen = scaled || gpuPickingEnabled;
+    if (offscreen) {
+        resizeSceneTarget();
+    }
+    
+    // Time the SDF passes unless the query of this slot is still in flight
+    int timer = gpuTimerNext;
+    bool timed = !gpuTimerPending[timer];
+    if (timed) {
+        glBeginQuery(GL_TIME_ELAPSED, gpuTimerQueries[timer]);
     }
     
-    // Draw quad
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    sceneShader->setInt("u_debugView", static_cast<int>(debugView));
+    sceneShader->setInt("u_coneTileSize", SDF_CONE_TILE_SIZE);
+    sceneShader->setInt("u_coneDepth", 3);
+    glActiveTexture(GL_TEXTURE3);
+    
+    // Cone pre-pass: one texel per tile into the corner of the depth target
+    // (which must not be bound for sampling while it is written)
+    if (conePrepassEnabled) {
+        GpuProfileScope gpuScope(profiler, "cone pass");
+        resizeConeTarget();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, coneFramebuffer);
+        glViewport(0, 0, (renderWidth + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE,
+                   (renderHeight + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE);
+        sceneShader->setInt("u_conePass", 1);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, coneDepthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    sceneShader->setInt("u_conePass", 0);
+    sceneShader->setInt("u_useConeDepth", conePrepassEnabled ? 1 : 0);
+    
+    // Draw quad
+    {
+        GpuProfileScope gpuScope(profiler, "sdf pass");
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreen ? sceneFramebuffer : static_cast<GLuint>(targetFramebuffer));
+        glViewport(0, 0, renderWidth, renderHeight);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+    
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuTimerScales[timer] = resolutionScale;
+        gpuTimerShaderSamples[timer] = shaderSample;
+        gpuTimerPending[timer] = true;
+        gpuTimerNext = (timer + 1) % GPU_TIMER_QUERIES;
+    }
+    
+    // The cursor is always at the centre of the view
+    if (gpuPickingEnabled) {
+        requestPickReadback(renderWidth / 2, renderHeight / 2);
+    }
+    
+    if (offscreen) {
+        GpuProfileScope gpuScope(profiler, scaled ? "upscale" : "copy");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                          scaled ? GL_LINEAR : GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    glViewport(0, 0, width, height);
+    
+    if (profiler.isEnabled()) {
+        drawProfilerOverlay();
+    }
+    profiler.endFrame();
+    frameAllocations = allocations.getAllocations();
 }
 
-void SDFRenderer::cleanup() {
-    if (VAO) glDeleteVertexArrays(1, &VAO);
-    if (VBO) glDeleteBuffers(1, &VBO);
-    if (EBO) glDeleteBuffers(1, &EBO);
+void SDFRenderer::readGpuTimers() {
+    // Oldest first, so the governor sees the frames in order
+    for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        int timer = (gpuTimerNext + i) % GPU_TIMER_QUERIES;
+        if (!gpuTimerPending[timer]) {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(gpuTimerQueries[timer], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(gpuTimerQueries[timer], GL_QUERY_RESULT, &nanoseconds);
+        gpuTimerPending[timer] = false;
+        gpuFrameTime = static_cast<float>(nanoseconds * 1e-6);
+        if (dynamicResolutionEnabled) {
+            resolutionGovernor.addSample(gpuFrameTime, gpuTimerScales[timer]);
+        }
+        
+        // Frames comparing a specialised shader with the generic one, at full resolution
+        float scale = gpuTimerScales[timer];
+        sceneShaders.reportGpuTime(gpuTimerShaderSamples[timer], gpuFrameTime / (scale * scale));
+    }
+}
+
+void SDFRenderer::resizeSceneTarget() {
+    if (sceneTargetWidth == width && sceneTargetHeight == height) {
+        return;
+    }
     
-    // Shader cleanup is handled by the Shader class destructor
+    // Allocated at the full window size, so changing the scale never reallocates
+    glBindTexture(GL_TEXTURE_2D, sceneColorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
-    // Reset IDs
-    VAO = VBO = EBO = 0;
+    // Object IDs for picking (integer textures can't be filtered)
+    glBindTexture(GL_TEXTURE_2D, sceneObjectIdTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, width, height, 0, GL_RED_INTEGER, GL_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, sceneObjectIdTexture, 0);
+    glDrawBuffers(2, drawBuffers);
+    sceneTargetWidth = width;
+    sceneTargetHeight = height;
 }
 
-void SDFRenderer::setMousePosition(float x, float y) {
-    mouseX = x;
-    mouseY = y;
+void SDFRenderer::requestPickReadback(int x, int y) {
+    // Skip this frame if the oldest readback hasn't been collected yet
+    int slot = pickNext;
+    if (pickFences[slot]) {
+        return;
+    }
+    
+    // Copy into the pixel buffer on the GPU timeline; the fence tells when it's there
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pickBuffers[slot]);
+    glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    pickFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pickNext = (slot + 1) % PICK_READBACKS;
+}
+
+void SDFRenderer::readPickResults() {
+    ProfileScope scope(profiler, "picking");
     
-    // Update the object under cursor whenever the mouse moves
-    updateObjectUnderCursor();
+    // Oldest first, keeping the newest finished result; never waits for the GPU
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        int slot = (pickNext + i) % PICK_READBACKS;
+        if (!pickFences[slot]) {
+            continue;
+        }
+        GLenum status = glClientWaitSync(pickFences[slot], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+        glDeleteSync(pickFences[slot]);
+        pickFences[slot] = 0;
+        
+        GLint objectIndex = -1;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pickBuffers[slot]);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLint), &objectIndex);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        objectUnderCursor = objectIndex < objectManager.getObjectCount() ? objectIndex : -1;
+    }
 }
 
-// SDF functions that match those in the fragment shader
-float SDFRenderer::sdfSphere(const glm::vec3& p) {
-    return glm::length(p) - 0.5f;
+void SDFRenderer::setGpuPickingEnabled(bool enabled) {
+    if (enabled == gpuPickingEnabled) {
+        return;
+    }
+    gpuPickingEnabled = enabled;
+    
+    // Results still in flight were taken with the other method's timing; drop them
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        if (pickFences[i]) {
+            glDeleteSync(pickFences[i]);
+            pickFences[i] = 0;
+        }
+    }
 }
 
-float SDFRenderer::sdfCube(const glm::vec3& p) {
-    glm::vec3 d = glm::abs(p) - glm::vec3(0.5f); // Half-size of cube is 0.5
-    return glm::length(glm::max(d, glm::vec3(0.0f))) + 
-           std::min(std::max(d.x, std::max(d.y, d.z)), 0.0f);
+bool SDFRenderer::isGpuPickingEnabled() const {
+    return gpuPickingEnabled;
 }
 
-// Object-specific SDF with world position
-float SDFRenderer::sdfObject(const glm::vec3& p, int objIndex) {
-    // Get object data
-    int type = objectManager.getObjectType(objIndex);
-    glm::vec3 position = objectManager.getObject3DPosition(objIndex); // Use mapped 3D position
+void SDFRenderer::resizeConeTarget() {
+    int coneWidth = std::max((width + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE, 1);
+    int coneHeight = std::max((height + SDF_CONE_TILE_SIZE - 1) / SDF_CONE_TILE_SIZE, 1);
+    if (coneTargetWidth == coneWidth && coneTargetHeight == coneHeight) {
+        return;
+    }
     
-    // Calculate distance based on object type
-    if (type == 0) {
-        // Sphere
-        return sdfSphere(p - position);
-    } else if (type == 1) {
-        // Cube
-        return sdfCube(p - position);
+    // Depths are read per texel with texelFetch (filters were set in initialize)
+    glBindTexture(GL_TEXTURE_2D, coneDepthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, coneWidth, coneHeight, 0, GL_RED, GL_FLOAT, NULL);
+    glBindFramebuffer(GL_FRAMEBUFFER, coneFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, coneDepthTexture, 0);
+    coneTargetWidth = coneWidth;
+    coneTargetHeight = coneHeight;
+}
+
+void SDFRenderer::drawProfilerOverlay() {
+    // Graph area in normalized device coordinates; its full height is two 60 Hz frames
+    const float left = -0.98f, bottom = -0.98f, graphWidth = 0.9f, graphHeight = 0.4f;
+    const float fullScaleMs = 2000.0f / 60.0f;
+    const float columnWidth = graphWidth / Profiler::FRAME_HISTORY;
+    static const float palette[8][3] = {
+        {0.95f, 0.45f, 0.35f}, {0.35f, 0.75f, 0.95f}, {0.55f, 0.90f, 0.40f}, {0.95f, 0.80f, 0.30f},
+        {0.75f, 0.50f, 0.95f}, {0.30f, 0.90f, 0.80f}, {0.95f, 0.55f, 0.80f}, {0.70f, 0.70f, 0.70f}
+    };
+    static const float background[3] = {0.05f, 0.05f, 0.08f};
+    static const float lineColor[3] = {0.9f, 0.9f, 0.9f};
+    
+    // Vertices (x, y, r, g, b) in the frame arena: a quad per event plus the background and the line
+    int frameCount = profiler.getFrameCount();
+    size_t quadCount = 2;
+    for (int age = 0; age < frameCount; age++) {
+        int eventCount = 0;
+        bool gpuResolved = false;
+        profiler.getFrameEvents(age, eventCount, gpuResolved);
+        quadCount += eventCount;
     }
+    float* vertices = frameArena.allocate<float>(quadCount * 6 * 5);
+    size_t vertexCount = 0;
+    auto addQuad = [&](float x0, float y0, float x1, float y1, const float* color) {
+        const float corners[6][2] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y0}, {x1, y1}, {x0, y1}};
+        for (const float* corner : corners) {
+            float* vertex = &vertices[vertexCount++ * 5];
+            vertex[0] = corner[0];
+            vertex[1] = corner[1];
+            std::copy(color, color + 3, vertex + 2);
+        }
+    };
+    addQuad(left, bottom, left + graphWidth, bottom + graphHeight, background);
+    
+    // Newest frame on the right; each zone gets a colour the first time it shows up
+    for (int age = 0; age < frameCount; age++) {
+        int eventCount = 0;
+        bool gpuResolved = false;
+        const ProfileEvent* events = profiler.getFrameEvents(age, eventCount, gpuResolved);
+        float x = left + graphWidth - (frameCount - age) * columnWidth;
+        float cpuTop = bottom, gpuTop = bottom;
+        for (int e = 0; e < eventCount; e++) {
+            size_t zone = 0;
+            while (zone < overlayZoneNames.size() && std::strcmp(overlayZoneNames[zone], events[e].name) != 0) {
+                zone++;
+            }
+            if (zone == overlayZoneNames.size()) {
+                overlayZoneNames.push_back(events[e].name);
+            }
+            bool gpu = events[e].track == PROFILE_TRACK_GPU;
+            float& top = gpu ? gpuTop : cpuTop;
+            float x0 = gpu ? x + columnWidth * 0.5f : x;
+            float y1 = std::min(top + static_cast<float>(events[e].durationNs * 1e-6) / fullScaleMs * graphHeight,
+                                bottom + graphHeight);
+            addQuad(x0, top, x0 + columnWidth * 0.5f, y1, palette[zone % 8]);
+            top = y1;
+        }
+    }
+    
+    // Reference line at one 60 Hz frame
+    float lineY = bottom + graphHeight * 0.5f;
+    addQuad(left, lineY - 0.002f, left + graphWidth, lineY + 0.002f, lineColor);
     
-    return 1000.0f; // Default large distance for unknown types
+    overlayShader.use();
+    glBindVertexArray(overlayVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, overlayVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 5 * sizeof(float), vertices, GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertexCount));
+}
+
+void SDFRenderer::setProfilingEnabled(bool enabled) {
+    profiler.setEnabled(enabled);
+}
+
+bool SDFRenderer::isProfilingEnabled() const {
+    return profiler.isEnabled();
+}
+
+Profiler& SDFRenderer::getProfiler() {
+    return profiler;
+}
+
+void SDFRenderer::setConePrepassEnabled(bool enabled) {
+    conePrepassEnabled = enabled;
+}
+
+bool SDFRenderer::isConePrepassEnabled() const {
+    return conePrepassEnabled;
+}
+
+void SDFRenderer::setDebugView(DebugView view) {
+    debugView = view;
+}
+
+DebugView SDFRenderer::getDebugView() const {
+    return debugView;
+}
+
+void SDFRenderer::setCullingEnabled(bool enabled) {
+    cullingEnabled = enabled;
+}
+
+bool SDFRenderer::isCullingEnabled() const {
+    return cullingEnabled;
+}
+
+void SDFRenderer::setTileBinningEnabled(bool enabled) {
+    tileBinningEnabled = enabled;
 }
 
-// Combined SDF: finds minimum distance to any object in the scene
-float SDFRenderer::sdfScene(const glm::vec3& p) {
-    float minDist = 1000.0f;
+bool SDFRenderer::isTileBinningEnabled() const {
+    return tileBinningEnabled;
+}
+
+const TileBinStats& SDFRenderer::getTileBinStats() const {
+    return binner.getStats();
+}
+
+void SDFRenderer::setDynamicResolutionEnabled(bool enabled) {
+    dynamicResolutionEnabled = enabled;
+    resolutionGovernor.reset();
+}
+
+bool SDFRenderer::isDynamicResolutionEnabled() const {
+    return dynamicResolutionEnabled;
+}
+
+void SDFRenderer::setTargetFrameTime(float milliseconds) {
+    resolutionGovernor.setTargetFrameTime(milliseconds);
+}
+
+float SDFRenderer::getTargetFrameTime() const {
+    return resolutionGovernor.getTargetFrameTime();
+}
+
+float SDFRenderer::getResolutionScale() const {
+    return resolutionScale;
+}
+
+float SDFRenderer::getGpuFrameTime() const {
+    return gpuFrameTime;
+}
+
+void SDFRenderer::packObject(int index, int slot) {
+    // Position, and the slice size with the flags (type in bits 0-7, selected in bit 8)
+    // in the mantissa bits sliceSize leaves clear
+    glm::vec3 pos = objectManager.getObject3DPosition(index); // Get mapped 3D position
+    uint32_t flags = (objectManager.getObjectType(index) & 255) | (objectManager.isObjectSelected(index) ? 256 : 0);
+    float size = objectManager.getObjectSliceSize(index);
+    uint32_t sizeBits;
+    std::memcpy(&sizeBits, &size, sizeof(sizeBits));
+    sizeBits = (sizeBits & ~SDF_SLICE_FLAG_BITS) | flags;
+    float* texel = &objectData[static_cast<size_t>(slot) * 4];
+    texel[0] = pos.x;
+    texel[1] = pos.y;
+    texel[2] = pos.z;
+    std::memcpy(&texel[3], &sizeBits, sizeof(sizeBits));
+}
+
+void SDFRenderer::uploadObjectData() {
+    ProfileScope scope(profiler, "object upload");
+    const GLsizeiptr texelBytes = 4 * sizeof(float);
+    const std::vector<int>& visible = culler.getVisibleObjects();
+    int objectCount = static_cast<int>(visible.size());
+    if (objectCount > maxObjectTexels) {
+        std::cerr << "Visible object count " << objectCount << " exceeds GL_MAX_TEXTURE_BUFFER_SIZE ("
+                  << maxObjectTexels << "), extra objects are not drawn" << std::endl;
+        objectCount = maxObjectTexels;
+    }
+    uploadStats.visibleObjects = objectCount;
+    uploadStats.culledObjects = culler.getCulledCount();
+    
+    uploadStats.lastFrameBytes = 0;
+    glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
     
-    for (int i = 0; i < objectManager.getObjectCount(); i++) {
-        float dist = sdfObject(p, i);
-        if (dist < minDist) {
-            minDist = dist;
+    // The texels stay where they are as long as the same objects are visible
+    unsigned long long generation = objectManager.getGeneration();
+    bool sameObjects = objectBufferValid && uploadedObjects.size() == static_cast<size_t>(objectCount) &&
+                       std::equal(uploadedObjects.begin(), uploadedObjects.end(), visible.begin());
+    if (sameObjects && generation == uploadedGeneration) {
+        // Nothing changed since the last frame
+        uploadStats.skippedUploads++;
+    } else if (!sameObjects || !objectManager.getChangedObjects(uploadedGeneration, changedObjects)) {
+        // First upload, other objects visible or change log overrun: resend everything
+        if (objectCount > objectCapacity) {
+            // Grow with headroom so adding objects (or seeing more of them) doesn't reallocate
+            // every frame, on the GPU or in the CPU mirrors
+            objectCapacity = std::min(std::max(objectCount + objectCount / 2, 64), static_cast<int>(maxObjectTexels));
+            glBufferData(GL_TEXTURE_BUFFER, objectCapacity * texelBytes, NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, objectIdBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, objectCapacity * sizeof(GLint), NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, objectBuffer);
+            objectData.reserve(static_cast<size_t>(objectCapacity) * 4);
+            uploadedObjects.reserve(objectCapacity);
+        }
+        objectData.resize(static_cast<size_t>(objectCount) * 4);
+        for (int slot = 0; slot < objectCount; slot++) {
+            packObject(visible[slot], slot);
         }
+        uploadedObjects.assign(visible.begin(), visible.begin() + objectCount);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, objectCount * texelBytes, objectData.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, objectIdBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, objectCount * sizeof(GLint), uploadedObjects.data());
+        uploadStats.lastFrameBytes = objectCount * (texelBytes + sizeof(GLint));
+        uploadStats.fullUploads++;
+    } else {
+        // Repack only the changed visible objects and send their texels as merged ranges
+        // (both lists are sorted, so the slots come out in ascending order)
+        std::sort(changedObjects.begin(), changedObjects.end());
+        auto sendSlots = [&](int first, int last) {
+            if (first < 0) return;
+            GLsizeiptr bytes = (last - first + 1) * texelBytes;
+            glBufferSubData(GL_TEXTURE_BUFFER, first * texelBytes, bytes, &objectData[static_cast<size_t>(first) * 4]);
+            uploadStats.lastFrameBytes += bytes;
+        };
+        int first = -1, last = -1;
+        auto found = uploadedObjects.begin();
+        for (int index : changedObjects) {
+            found = std::lower_bound(found, uploadedObjects.end(), index);
+            if (found == uploadedObjects.end()) break;
+            if (*found != index) continue; // Culled
+            int slot = static_cast<int>(found - uploadedObjects.begin());
+            packObject(index, slot);
+            if (slot != last + 1) {
+                sendSlots(first, last);
+                first = slot;
+            }
+            last = slot;
+        }
+        sendSlots(first, last);
+        uploadStats.partialUploads++;
     }
+    uploadStats.totalBytes += uploadStats.lastFrameBytes;
     
-    return minDist;
+    objectBufferValid = true;
+    uploadedGeneration = generation;
+    
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_BUFFER, objectIdTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, objectTexture);
+    sceneShader->setInt("u_objects", 0);
+    sceneShader->setInt("u_objectIds", 4);
+    sceneShader->setInt("u_objectCount", objectCount);
 }
 
-// Find closest object hit by ray
-int SDFRenderer::getHitObjectIndex(const glm::vec3& p) {
-    float minDist = 1000.0f;
-    int closestIndex = -1;
+void SDFRenderer::uploadTileBins(const glm::vec3& viewPosition, const ViewBasis& viewBasis, int renderWidth, int renderHeight) {
+    ProfileScope scope(profiler, "tile binning");
     
-    for (int i = 0; i < objectManager.getObjectCount(); i++) {
-        float dist = sdfObject(p, i);
-        if (dist < minDist && dist < 0.01f) {
-            minDist = dist;
-            closestIndex = i;
+    // Specialised shaders march their own object lists
+    bool binned = tileBinningEnabled && sceneShader == &shader;
+    unsigned long long uploads = uploadStats.fullUploads + uploadStats.partialUploads;
+    if (binned && !(tileBinsValid && uploads == binnedUploads && viewPosition == binnedPosition &&
+                    viewBasis.forward == binnedForward && renderWidth == binnedWidth && renderHeight == binnedHeight)) {
+        binner.bin(objectManager, uploadedObjects, static_cast<int>(uploadedObjects.size()), viewPosition, viewBasis,
+                   renderWidth, renderHeight, frameArena);
+        const std::vector<int>& ranges = binner.getTileRanges();
+        const std::vector<int>& tileObjects = binner.getTileObjects();
+        if (static_cast<GLint>(tileObjects.size()) <= maxObjectTexels) {
+            glBindBuffer(GL_TEXTURE_BUFFER, tileRangeBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(GLint), ranges.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, tileObjectBuffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(tileObjects.size(), 1) * sizeof(GLint),
+                         tileObjects.empty() ? NULL : tileObjects.data(), GL_STREAM_DRAW);
+            tileBinsValid = true;
+        } else {
+            // More than a texture buffer holds: march every visible object this frame
+            tileBinsValid = false;
         }
+        binnedUploads = uploads;
+        binnedPosition = viewPosition;
+        binnedForward = viewBasis.forward;
+        binnedWidth = renderWidth;
+        binnedHeight = renderHeight;
+    }
+    binned = binned && tileBinsValid;
+    
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_BUFFER, tileRangeTexture);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_BUFFER, tileObjectTexture);
+    glActiveTexture(GL_TEXTURE0);
+    sceneShader->setInt("u_tileRanges", 5);
+    sceneShader->setInt("u_tileObjects", 6);
+    sceneShader->setInt("u_useTileBins", binned ? 1 : 0);
+    sceneShader->setInt("u_binTileSize", SDF_BIN_TILE_SIZE);
+    sceneShader->setInt("u_binTilesX", binner.getStats().tilesX);
+}
+
+void SDFRenderer::uploadBrickCache() {
+    ProfileScope scope(profiler, "brick cache");
+    bool changed = brickCache.update(objectManager);
+    const std::vector<float>& brickMap = brickCache.getBrickMap();
+    const GLsizeiptr entryBytes = 2 * sizeof(float);
+    
+    glBindBuffer(GL_TEXTURE_BUFFER, brickMapBuffer);
+    if (!brickCacheUploaded || brickCache.wasRebuilt()) {
+        // New grid or a bigger atlas: resend everything
+        if (!brickMap.empty()) {
+            glBufferData(GL_TEXTURE_BUFFER, brickMap.size() * sizeof(float), brickMap.data(), GL_DYNAMIC_DRAW);
+        }
+        glBindTexture(GL_TEXTURE_3D, brickAtlasTexture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, BRICK_ATLAS_SLOTS_X * BRICK_SAMPLES, BRICK_ATLAS_SLOTS_Y * BRICK_SAMPLES,
+                     std::max(brickCache.getAtlasLayers(), 1) * BRICK_SAMPLES, 0, GL_RED, GL_FLOAT, NULL);
+        for (int slot = 0; slot < brickCache.getSlotCount(); slot++) {
+            uploadBrickSlot(slot);
+        }
+        brickCacheUploaded = true;
+    } else if (changed) {
+        // Changed map entries as sorted, merged ranges, plus the re-baked slots
+        const std::vector<int>& changedBricks = brickCache.getDirtyBricks();
+        size_t dirtyCount = changedBricks.size();
+        int* dirtyBricks = frameArena.allocate<int>(dirtyCount);
+        std::copy(changedBricks.begin(), changedBricks.end(), dirtyBricks);
+        std::sort(dirtyBricks, dirtyBricks + dirtyCount);
+        glBindTexture(GL_TEXTURE_3D, brickAtlasTexture);
+        size_t i = 0;
+        while (i < dirtyCount) {
+            int first = dirtyBricks[i];
+            int last = first;
+            while (i < dirtyCount && dirtyBricks[i] <= last + 1) {
+                last = dirtyBricks[i];
+                int slot = static_cast<int>(brickMap[static_cast<size_t>(last) * 2]);
+                if (slot >= 0) uploadBrickSlot(slot);
+                i++;
+            }
+            glBufferSubData(GL_TEXTURE_BUFFER, first * entryBytes, (last - first + 1) * entryBytes,
+                            &brickMap[static_cast<size_t>(first) * 2]);
+        }
+    }
+    
+    glm::vec3 gridMin = brickCache.getGridMin();
+    glm::ivec3 gridSize = brickCache.getGridSize();
+    sceneShader->setVec3("u_brickGridMin", gridMin.x, gridMin.y, gridMin.z);
+    sceneShader->setIVec3("u_brickGridSize", gridSize.x, gridSize.y, gridSize.z);
+    sceneShader->setIVec2("u_brickAtlasSlots", BRICK_ATLAS_SLOTS_X, BRICK_ATLAS_SLOTS_Y);
+    sceneShader->setFloat("u_brickSize", brickCache.getBrickSize());
+    sceneShader->setFloat("u_brickMargin", brickCache.getTruncation());
+}
+
+void SDFRenderer::uploadBrickSlot(int slot) {
+    int x = slot % BRICK_ATLAS_SLOTS_X;
+    int y = (slot / BRICK_ATLAS_SLOTS_X) % BRICK_ATLAS_SLOTS_Y;
+    int z = slot / (BRICK_ATLAS_SLOTS_X * BRICK_ATLAS_SLOTS_Y);
+    glTexSubImage3D(GL_TEXTURE_3D, 0, x * BRICK_SAMPLES, y * BRICK_SAMPLES, z * BRICK_SAMPLES,
+                    BRICK_SAMPLES, BRICK_SAMPLES, BRICK_SAMPLES, GL_RED, GL_FLOAT, brickCache.getSlotSamples(slot));
+}
+
+void SDFRenderer::setShaderSpecialisationEnabled(bool enabled) {
+    shaderSpecialisationEnabled = enabled;
+}
+
+bool SDFRenderer::isShaderSpecialisationEnabled() const {
+    return shaderSpecialisationEnabled;
+}
+
+void SDFRenderer::setBrickCacheEnabled(bool enabled) {
+    brickCacheEnabled = enabled;
+}
+
+bool SDFRenderer::isBrickCacheEnabled() const {
+    return brickCacheEnabled;
+}
+
+const BrickCacheStats& SDFRenderer::getBrickCacheStats() const {
+    return brickCache.getStats();
+}
+
+void SDFRenderer::setBlendMode(BlendMode mode) {
+    blendMode = mode;
+}
+
+BlendMode SDFRenderer::getBlendMode() const {
+    return blendMode;
+}
+
+const SDFRenderer::UploadStats& SDFRenderer::getUploadStats() const {
+    return uploadStats;
+}
+
+unsigned long long SDFRenderer::getFrameAllocations() const {
+    return frameAllocations;
+}
+
+void SDFRenderer::cleanup() {
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+    if (objectTexture) glDeleteTextures(1, &objectTexture);
+    if (objectBuffer) glDeleteBuffers(1, &objectBuffer);
+    if (objectIdTexture) glDeleteTextures(1, &objectIdTexture);
+    if (objectIdBuffer) glDeleteBuffers(1, &objectIdBuffer);
+    if (tileRangeTexture) glDeleteTextures(1, &tileRangeTexture);
+    if (tileRangeBuffer) glDeleteBuffers(1, &tileRangeBuffer);
+    if (tileObjectTexture) glDeleteTextures(1, &tileObjectTexture);
+    if (tileObjectBuffer) glDeleteBuffers(1, &tileObjectBuffer);
+    if (brickMapTexture) glDeleteTextures(1, &brickMapTexture);
+    if (brickMapBuffer) glDeleteBuffers(1, &brickMapBuffer);
+    if (brickAtlasTexture) glDeleteTextures(1, &brickAtlasTexture);
+    if (sceneFramebuffer) glDeleteFramebuffers(1, &sceneFramebuffer);
+    if (sceneColorTexture) glDeleteTextures(1, &sceneColorTexture);
+    if (sceneObjectIdTexture) glDeleteTextures(1, &sceneObjectIdTexture);
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        if (pickFences[i]) glDeleteSync(pickFences[i]);
+        pickFences[i] = 0;
     }
+    if (pickBuffers[0]) glDeleteBuffers(PICK_READBACKS, pickBuffers);
+    if (coneFramebuffer) glDeleteFramebuffers(1, &coneFramebuffer);
+    if (coneDepthTexture) glDeleteTextures(1, &coneDepthTexture);
+    if (gpuTimerQueries[0]) glDeleteQueries(GPU_TIMER_QUERIES, gpuTimerQueries);
+    if (overlayVAO) glDeleteVertexArrays(1, &overlayVAO);
+    if (overlayVBO) glDeleteBuffers(1, &overlayVBO);
+    profiler.cleanupGpu();
+    sceneShaders.cleanup();
+    
+    // Shader cleanup is handled by the Shader class destructor
     
-    return closestIndex;
+    // Reset IDs
+    VAO = VBO = EBO = 0;
+    objectBuffer = objectTexture = 0;
+    objectIdBuffer = objectIdTexture = 0;
+    tileRangeBuffer = tileRangeTexture = tileObjectBuffer = tileObjectTexture = 0;
+    brickMapBuffer = brickMapTexture = brickAtlasTexture = 0;
+    sceneFramebuffer = sceneColorTexture = sceneObjectIdTexture = 0;
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        pickBuffers[i] = 0;
+    }
+    sceneTargetWidth = sceneTargetHeight = 0;
+    coneFramebuffer = coneDepthTexture = 0;
+    coneTargetWidth = coneTargetHeight = 0;
+    overlayVAO = overlayVBO = 0;
+    for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        gpuTimerQueries[i] = 0;
+        gpuTimerPending[i] = false;
+    }
+    brickCacheUploaded = false;
+    objectCapacity = 0;
+    objectBufferValid = false;
+    uploadedObjects.clear();
+    tileBinsValid = false;
 }
 
-// Raymarch algorithm to find intersection with scene
-float SDFRenderer::raymarch(const glm::vec3& ro, const glm::vec3& rd) {
-    float t = 0.0f; // Distance along ray
-    for (int i = 0; i < 64; i++) {
-        glm::vec3 p = ro + rd * t; // Current position
-        float d = sdfScene(p); // Distance to scene
-        if (d < 0.001f) return t; // Hit (close enough)
-        t += d; // Step forward
-        if (t > 20.0f) return -1.0f; // Too far, miss
+void SDFRenderer::setMousePosition(float x, float y) {
+    mouseX = x;
+    mouseY = y;
+    
+    // Hand the new cursor ray to the picking worker (GPU picking reads the object back
+    // from the next frames instead). Only the latest ray is traced, so fast mice cost nothing extra.
+    if (!gpuPickingEnabled) {
+        requestCursorPick();
     }
-    return -1.0f; // Missed after max steps
 }
 
 // Helper function to determine which object is under the cursor
 void SDFRenderer::updateObjectUnderCursor() {
+    ProfileScope scope(profiler, "picking");
+    
+    // Publish the scene if it changed (skipped for a frame if the worker still holds both
+    // snapshots), queue the current ray and take the newest result without waiting
+    pickingWorker.publishScene(objectManager);
+    requestCursorPick();
+    objectUnderCursor = pickingWorker.getObjectUnderCursor();
+    if (objectUnderCursor >= objectManager.getObjectCount()) {
+        objectUnderCursor = -1;
+    }
+}
+
+void SDFRenderer::requestCursorPick() {
     // Calculate ray direction based on mouse position and camera orientation
     float horizontalAngle = -(mouseX / static_cast<float>(width)) * 2.0f * 3.14159f;
     float verticalAngle = ((1.0f - mouseY / static_cast<float>(height)) - 0.5f) * 3.14159f * 0.5f;
@@ -247,19 +999,15 @@ void SDFRenderer::updateObjectUnderCursor() {
     );
     
     // Camera position (mapped from 4D to 3D)
-    glm::vec3 rayOrigin = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
-    
-    // Perform raymarching to find intersection with scene
-    float t = raymarch(rayOrigin, rayDir);
-    
-    // Reset object under cursor
-    objectUnderCursor = -1;
+    glm::vec3 rayOrigin = mapCameraPosition();
     
-    // If we hit something, determine which object it was
-    if (t > 0.0f) {
-        glm::vec3 hitPoint = rayOrigin + rayDir * t;
-        objectUnderCursor = getHitObjectIndex(hitPoint);
+    // The same ray again doesn't need waking the worker
+    if (rayOrigin == pickRayOrigin && rayDir == pickRayDirection) {
+        return;
     }
+    pickRayOrigin = rayOrigin;
+    pickRayDirection = rayDir;
+    pickingWorker.requestPick(rayOrigin, rayDir);
 }
 
 void SDFRenderer::setWindowSize(int w, int h) {
@@ -278,8 +1026,8 @@ void SDFRenderer::setMouseButtonState(bool pressed) {
             // Store initial position and distance from camera
             draggedObjectInitialPos = objectManager.getObjectPosition(draggedObjectIndex);
             // Calculate distance using the 3D mapped positions
-            glm::vec3 mappedObjectPos = getmapcoord(draggedObjectInitialPos);
-            glm::vec3 mappedCameraPos = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
+            glm::vec3 mappedObjectPos = projection.project(draggedObjectInitialPos, cameraW);
+            glm::vec3 mappedCameraPos = mapCameraPosition();
             draggedObjectDistance = glm::length(mappedObjectPos - mappedCameraPos);
         }
     } else {
@@ -307,11 +1055,11 @@ void SDFRenderer::storeDragOffset() {
 
 void SDFRenderer::moveCamera(float dx, float dy, float dz) {
     // Calculate new position in 4D by adding the 3D movement vector to the mapped position
-    glm::vec3 mappedPos = getmapcoord(glm::vec4(cameraX, cameraY, cameraZ, cameraW));
+    glm::vec3 mappedPos = mapCameraPosition();
     glm::vec3 newMappedPos = mappedPos + glm::vec3(dx, dy, dz);
     
-    // Convert back to 4D
-    glm::vec4 newPos4D = getrealcoord(newMappedPos);
+    // Convert back to 4D, staying at the camera's W
+    glm::vec4 newPos4D = projection.unproject(newMappedPos, glm::vec4(cameraX, cameraY, cameraZ, cameraW), cameraW, true);
     
     // Update camera position
     cameraX = newPos4D.x;
@@ -326,8 +1074,8 @@ void SDFRenderer::moveCamera(float dx, float dy, float dz) {
 }
 
 void SDFRenderer::setCameraPosition(float x, float y, float z) {
-    // Create a 4D position with w=7
-    glm::vec4 newPos = getrealcoord(glm::vec3(x, y, z));
+    // The 4D position at the camera's W that maps to this position
+    glm::vec4 newPos = projection.unproject(glm::vec3(x, y, z), glm::vec4(cameraX, cameraY, cameraZ, cameraW), cameraW, true);
     
     cameraX = newPos.x;
     cameraY = newPos.y;
@@ -339,3 +1087,73 @@ void SDFRenderer::setCameraPosition(float x, float y, float z) {
     ::cameraY = cameraY;
     ::cameraZ = cameraZ;
 }
+
+glm::vec3 SDFRenderer::getCameraPosition() const {
+    return mapCameraPosition();
+}
+
+glm::vec3 SDFRenderer::mapCameraPosition() const {
+    return projection.project(glm::vec4(cameraX, cameraY, cameraZ, cameraW), cameraW);
+}
+
+void SDFRenderer::setCameraW(float w) {
+    cameraW = w;
+}
+
+float SDFRenderer::getCameraW() const {
+    return cameraW;
+}
+
+void SDFRenderer::setManifoldProjection(const ManifoldProjection& newProjection) {
+    projection = newProjection;
+}
+
+const ManifoldProjection& SDFRenderer::getManifoldProjection() const {
+    return projection;
+}
+
+bool SDFRenderer::loadScene(const std::string& path) {
+    SceneFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    world.close();
+    objectManager.clearObjects();
+    file.appendTo(objectManager);
+    discardObjectIndices();
+    return true;
+}
+
+bool SDFRenderer::saveScene(const std::string& path) const {
+    return SceneWriter::write(path, objectManager);
+}
+
+const ObjectManager& SDFRenderer::getObjectManager() const {
+    return objectManager;
+}
+
+bool SDFRenderer::openWorld(const std::string& path) {
+    if (!world.open(path)) {
+        return false;
+    }
+    objectManager.clearObjects();
+    discardObjectIndices();
+    return true;
+}
+
+WorldStore& SDFRenderer::getWorld() {
+    return world;
+}
+
+void SDFRenderer::discardObjectIndices() {
+    draggingShape = false;
+    draggedObjectIndex = -1;
+    objectUnderCursor = -1;
+    pickingWorker.discardResult();
+    for (int i = 0; i < PICK_READBACKS; i++) {
+        if (pickFences[i]) {
+            glDeleteSync(pickFences[i]);
+            pickFences[i] = 0;
+        }
+    }
+}
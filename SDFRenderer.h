@@ -1,8 +1,21 @@
 
 #pragma once
 #include <GL/glew.h>
+#include <string>
+#include <vector>
 #include "Shader.h"
+#include "SceneShaderCache.h"
 #include "ObjectManager.h"
+#include "ManifoldProjection.h"
+#include "PickingWorker.h"
+#include "WorldStore.h"
+#include "SDFBrickCache.h"
+#include "ViewCuller.h"
+#include "TileBinner.h"
+#include "SDFMath.h"
+#include "ResolutionGovernor.h"
+#include "Profiler.h"
+#include "FrameArena.h"
 
 class SDFRenderer {
 public:
@@ -39,31 +52,260 @@ public:
     // Camera movement methods
     void moveCamera(float dx, float dy, float dz);
     void setCameraPosition(float x, float y, float z);
+    glm::vec3 getCameraPosition() const; // Mapped (3D) position
+    
+    // Camera W, which the manifold projection measures w from
+    void setCameraW(float w);
+    float getCameraW() const;
+    
+    // Map from the 4D manifold to the rendered 3D space (drops w by default). The objects
+    // are reprojected in one batch at the start of the next frame, and only when this or
+    // the camera's W changed in a way that affects them.
+    void setManifoldProjection(const ManifoldProjection& projection);
+    const ManifoldProjection& getManifoldProjection() const;
+    
+    // Replace the objects with the scene in a scene file (see SceneFile). Returns false,
+    // keeping the current objects, if the file can't be read.
+    bool loadScene(const std::string& path);
+    
+    // Write the objects to a scene file
+    bool saveScene(const std::string& path) const;
+    const ObjectManager& getObjectManager() const;
+    
+    // Page the objects of a world file (see WorldStore) in and out around the camera from
+    // now on, replacing the current objects. Returns false, keeping them, if the world
+    // can't be opened.
+    bool openWorld(const std::string& path);
+    WorldStore& getWorld();
     
     // Input state tracking
     void setShiftKeyState(bool pressed);
     
-private:
-    // SDF helper functions that match the shader implementations
-    float sdfSphere(const glm::vec3& p);
-    float sdfCube(const glm::vec3& p);
-    float sdfObject(const glm::vec3& p, int objIndex);
-    float sdfScene(const glm::vec3& p);
-    int getHitObjectIndex(const glm::vec3& p);
-    float raymarch(const glm::vec3& ro, const glm::vec3& rd);
+    // Smooth-min blend mode used by the shader (pruned by default)
+    void setBlendMode(BlendMode mode);
+    BlendMode getBlendMode() const;
+    
+    // Draw with shaders generated for the scene's object types, compiled in the background
+    // (the generic shader is used until they're ready) and kept where they time faster than
+    // the generic one (on by default)
+    void setShaderSpecialisationEnabled(bool enabled);
+    bool isShaderSpecialisationEnabled() const;
+    
+    // March through a baked distance cache instead of evaluating every object (off by default)
+    void setBrickCacheEnabled(bool enabled);
+    bool isBrickCacheEnabled() const;
+    const BrickCacheStats& getBrickCacheStats() const;
+    
+    // Frustum culling: only objects that can reach a pixel this frame (see ViewCuller) are
+    // sent to the shader (on by default). Shaders specialised to the scene always get every
+    // object, since they're generated for the whole scene.
+    void setCullingEnabled(bool enabled);
+    bool isCullingEnabled() const;
+    
+    // Tile binning: every SDF_BIN_TILE_SIZE^2 pixel tile only marches the objects that can
+    // reach its rays (see TileBinner), so pixels pay for the objects around them rather
+    // than for everything visible (on by default; not with specialised shaders either)
+    void setTileBinningEnabled(bool enabled);
+    bool isTileBinningEnabled() const;
+    const TileBinStats& getTileBinStats() const;
+    
+    // Dynamic resolution: the SDF pass renders at a fraction of the window size chosen to
+    // keep its GPU time near the target, and is upscaled to the window (on by default)
+    void setDynamicResolutionEnabled(bool enabled);
+    bool isDynamicResolutionEnabled() const;
+    void setTargetFrameTime(float milliseconds);
+    float getTargetFrameTime() const;
+    
+    // Scale the last frame was rendered at (1 = full window resolution)
+    float getResolutionScale() const;
+    
+    // Most recent measured GPU time of the SDF pass in milliseconds (0 until one is available)
+    float getGpuFrameTime() const;
     
+    // Cone pre-pass: one cone-marched ray per SDF_CONE_TILE_SIZE^2 pixels finds how far all
+    // rays of the tile can skip before the full-resolution pass marches them (on by default)
+    void setConePrepassEnabled(bool enabled);
+    bool isConePrepassEnabled() const;
+    
+    // Shaded output or the raymarch step heatmap
+    void setDebugView(DebugView view);
+    DebugView getDebugView() const;
+    
+    // Picking through the object ID buffer the shader writes: the pixel under the cursor
+    // is read back a frame or two late without stalling (on by default). When off, the
+    // object under the cursor is raymarched on the CPU by a background worker.
+    void setGpuPickingEnabled(bool enabled);
+    bool isGpuPickingEnabled() const;
+    
+    // Profiling of the frame phases (CPU zones and GPU passes) with a frame-time graph
+    // drawn over the scene (off by default)
+    void setProfilingEnabled(bool enabled);
+    bool isProfilingEnabled() const;
+    Profiler& getProfiler();
+    
+    // Object data upload accounting
+    struct UploadStats {
+        unsigned long long lastFrameBytes; // Bytes sent to the object buffer by the last render()
+        unsigned long long totalBytes;     // Bytes sent since initialize()
+        unsigned long long fullUploads;    // Frames that re-sent the whole buffer
+        unsigned long long partialUploads; // Frames that only sent changed ranges
+        unsigned long long skippedUploads; // Frames where nothing had changed
+        int visibleObjects;                // Objects the last render() sent to the shader
+        int culledObjects;                 // Objects the last render() culled
+    };
+    const UploadStats& getUploadStats() const;
+    
+    // Heap allocations the last render() made on the calling thread, counted by
+    // AllocationCounter. Once the scene, view and window sizes have been seen, a frame
+    // allocates nothing.
+    unsigned long long getFrameAllocations() const;
+    
+private:
     // Helper function to determine which object is under the cursor
     void updateObjectUnderCursor();
+    
+    // Camera position mapped to 3D through the manifold projection
+    glm::vec3 mapCameraPosition() const;
+    
+    // Send the ray under the cursor to the picking worker (if it changed)
+    void requestCursorPick();
+
+    // Upload the objects that changed since the last frame to the object texture buffer
+    void uploadObjectData();
+    
+    // Pack one object into texel `slot` of objectData
+    void packObject(int index, int slot);
+    
+    // Rebuild and upload the tile object lists if the view or the uploaded objects changed
+    // since the last frame, and set the binning uniforms
+    void uploadTileBins(const glm::vec3& viewPosition, const ViewBasis& viewBasis, int renderWidth, int renderHeight);
+    
+    // Re-bake the brick cache if objects changed and send the changed bricks to the GPU
+    void uploadBrickCache();
+    
+    // Copy one atlas slot of the brick cache into the atlas texture
+    void uploadBrickSlot(int slot);
+    
+    // Collect finished GPU timer queries and feed them to the resolution governor
+    void readGpuTimers();
+    
+    // Make sure the offscreen target can hold a full window-sized frame
+    void resizeSceneTarget();
+    
+    // Make sure the cone depth target has a texel per tile of a full window-sized frame
+    void resizeConeTarget();
+    
+    // Queue a copy of the object ID at (x, y) of the offscreen target into the next pick buffer
+    void requestPickReadback(int x, int y);
+    
+    // Take the newest finished pick readback as the object under the cursor
+    void readPickResults();
+    
+    // Forget object indices held across frames (drag, hover, pick readbacks in flight, the
+    // picking worker's result) after objects were removed or replaced
+    void discardObjectIndices();
+    
+    // Draw the profiler's frame-time graph into the bottom-left corner of the window
+    void drawProfilerOverlay();
 
     // OpenGL objects
     GLuint VAO, VBO, EBO;
     
+    // Object data texture buffer (one RGBA32F texel per visible object, see
+    // fragmentShaderSource) and the index of each texel's object (R32I)
+    GLuint objectBuffer, objectTexture;
+    GLuint objectIdBuffer, objectIdTexture;
+    GLint maxObjectTexels;
+    std::vector<float> objectData; // CPU mirror of the buffer contents
+    GLint objectCapacity;          // Objects the GL buffers have room for
+    std::vector<int> uploadedObjects; // Objects of the texels valid in the GL buffers, ascending
+    bool objectBufferValid;        // False until the first full upload
+    unsigned long long uploadedGeneration; // ObjectManager generation the buffer matches
+    std::vector<int> changedObjects;       // Scratch list of changed object indices
+    UploadStats uploadStats;
+    
+    // Objects that can show up in this frame
+    ViewCuller culler;
+    bool cullingEnabled;
+    
+    // Tile object lists: (first, count) per tile (RG32I) and the lists of object texels
+    // (R32I), with the view and object upload they were built for
+    TileBinner binner;
+    bool tileBinningEnabled;
+    GLuint tileRangeBuffer, tileRangeTexture, tileObjectBuffer, tileObjectTexture;
+    bool tileBinsValid;
+    glm::vec3 binnedPosition;
+    glm::vec3 binnedForward;
+    int binnedWidth, binnedHeight;
+    unsigned long long binnedUploads;  // Full and partial object uploads when binned
+    
+    // Smooth-min blend mode passed to the shader
+    BlendMode blendMode;
+    
+    // Baked distance cache: brick map texture buffer (RG32F) and sample atlas (3D, R16F)
+    SDFBrickCache brickCache;
+    bool brickCacheEnabled;
+    bool brickCacheUploaded;       // False until the whole cache was sent once
+    GLuint brickMapBuffer, brickMapTexture, brickAtlasTexture;
+    
+    // Dynamic resolution: offscreen colour target (window-sized; scaled frames use its
+    // lower-left corner) and the governor picking the scale
+    bool dynamicResolutionEnabled;
+    ResolutionGovernor resolutionGovernor;
+    float resolutionScale;
+    GLuint sceneFramebuffer, sceneColorTexture;
+    GLuint sceneObjectIdTexture;  // R32I, the object hit by each pixel (-1 = none)
+    int sceneTargetWidth, sceneTargetHeight;
+    
+    // GPU picking: pixel buffers of the object ID under the cursor, each with a fence
+    // signalling that its copy has finished (0 = free)
+    bool gpuPickingEnabled;
+    static const int PICK_READBACKS = 3;
+    GLuint pickBuffers[PICK_READBACKS];
+    GLsync pickFences[PICK_READBACKS];
+    int pickNext;
+    
+    // Cone pre-pass depth target (R32F, one texel per tile; scaled frames use its corner)
+    bool conePrepassEnabled;
+    GLuint coneFramebuffer, coneDepthTexture;
+    int coneTargetWidth, coneTargetHeight;
+    
+    DebugView debugView;
+    
+    // GL_TIME_ELAPSED queries around the SDF passes, read a few frames later so the CPU never waits
+    static const int GPU_TIMER_QUERIES = 4;
+    GLuint gpuTimerQueries[GPU_TIMER_QUERIES];
+    float gpuTimerScales[GPU_TIMER_QUERIES];  // Scale each timed frame was rendered at
+    int gpuTimerShaderSamples[GPU_TIMER_QUERIES]; // Shader cache sample ID of each timed frame
+    bool gpuTimerPending[GPU_TIMER_QUERIES];
+    int gpuTimerNext;
+    float gpuFrameTime;
+    
+    // Frame profiler and its overlay: one column per recorded frame, CPU zones stacked on
+    // the left half and GPU zones on the right, coloured by zone
+    Profiler profiler;
+    Shader overlayShader;
+    GLuint overlayVAO, overlayVBO;
+    std::vector<const char*> overlayZoneNames; // Zones in order of first appearance (picks the colour)
+    
+    // Scratch memory of the frame being rendered (reset at the start of render()) and the
+    // heap allocations of the last render()
+    FrameArena frameArena;
+    unsigned long long frameAllocations;
+    
     // Camera position in 4D space (x,y,z components stored separately for convenience)
     float cameraX, cameraY, cameraZ;
     float cameraW; // W-component of camera position
     
-    // Shader program
+    // Manifold projection applied to the objects at the start of each frame
+    ManifoldProjection projection;
+    
+    // Shader program (generic), the program drawing this frame and the programs
+    // specialised to scene signatures
     Shader shader;
+    Shader* sceneShader;
+    SceneShaderCache sceneShaders;
+    bool shaderSpecialisationEnabled;
     
     // Window dimensions
     int width, height;
@@ -88,6 +330,14 @@ private:
     // Object manager to handle objects in the scene
     ObjectManager objectManager;
     
+    // World paged into objectManager around the camera, when one is open
+    WorldStore world;
+    
+    // CPU picking on a background thread against snapshots of objectManager, and the last
+    // ray sent to it
+    PickingWorker pickingWorker;
+    glm::vec3 pickRayOrigin, pickRayDirection;
+    
     // Currently dragged object index (-1 if none)
     int draggedObjectIndex;
     
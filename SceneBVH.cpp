@@ -0,0 +1,348 @@
+#include "SceneBVH.h"
+#include "SDFMath.h"
+#include <algorithm>
+
+// Objects per leaf: one AVX2 step of the point kernel
+static const int BVH_LEAF_SIZE = 8;
+
+// Deepest traversal stack a median-split tree can need
+static const int BVH_STACK_SIZE = 128;
+
+SceneBVH::SceneBVH() : m_root(-1), m_synced(false), m_generation(0), m_lastVisits(0) {
+}
+
+void SceneBVH::build(const ObjectManager& objects) {
+    int count = objects.getObjectCount();
+
+    std::vector<glm::vec3> centers(count);
+    m_objectOfSlot.resize(count);
+    for (int i = 0; i < count; i++) {
+        centers[i] = objects.getObject3DPosition(i);
+        m_objectOfSlot[i] = i;
+    }
+
+    m_nodes.clear();
+    m_nodes.reserve(count > 0 ? 2 * (count / BVH_LEAF_SIZE + 1) : 0);
+    m_leafOfSlot.resize(count);
+    m_root = count > 0 ? buildNode(0, count, -1, centers) : -1;
+
+    // Lay the objects out in leaf order
+    m_types.resize(count);
+    m_x.resize(count);
+    m_y.resize(count);
+    m_z.resize(count);
+    m_size.resize(count);
+    m_slotOfObject.resize(count);
+    for (int slot = 0; slot < count; slot++) {
+        int object = m_objectOfSlot[slot];
+        m_types[slot] = objects.getObjectType(object);
+        m_x[slot] = centers[object].x;
+        m_y[slot] = centers[object].y;
+        m_z[slot] = centers[object].z;
+        m_size[slot] = objects.getObjectSliceSize(object);
+        m_slotOfObject[object] = slot;
+    }
+
+    // Bounds bottom-up (children always come after their parent)
+    for (int i = static_cast<int>(m_nodes.size()) - 1; i >= 0; i--) {
+        updateBounds(i);
+    }
+
+    m_synced = true;
+    m_generation = objects.getGeneration();
+}
+
+int SceneBVH::buildNode(int first, int count, int parent, const std::vector<glm::vec3>& centers) {
+    int nodeIndex = static_cast<int>(m_nodes.size());
+    Node node;
+    node.parent = parent;
+    node.left = node.right = -1;
+    node.first = first;
+    node.count = count;
+    m_nodes.push_back(node);
+
+    if (count <= BVH_LEAF_SIZE) {
+        for (int slot = first; slot < first + count; slot++) {
+            m_leafOfSlot[slot] = nodeIndex;
+        }
+        return nodeIndex;
+    }
+
+    // Split at the median along the widest axis of the centres
+    glm::vec3 lo(1e30f), hi(-1e30f);
+    for (int slot = first; slot < first + count; slot++) {
+        lo = glm::min(lo, centers[m_objectOfSlot[slot]]);
+        hi = glm::max(hi, centers[m_objectOfSlot[slot]]);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+
+    int half = count / 2;
+    std::nth_element(m_objectOfSlot.begin() + first, m_objectOfSlot.begin() + first + half,
+                     m_objectOfSlot.begin() + first + count,
+                     [&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+
+    int left = buildNode(first, half, nodeIndex, centers);
+    int right = buildNode(first + half, count - half, nodeIndex, centers);
+    m_nodes[nodeIndex].left = left;
+    m_nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+void SceneBVH::refit(const ObjectManager& objects, int objectIndex) {
+    if (objectIndex < 0 || objectIndex >= static_cast<int>(m_slotOfObject.size())) {
+        return;
+    }
+
+    int slot = m_slotOfObject[objectIndex];
+    glm::vec3 position = objects.getObject3DPosition(objectIndex);
+    m_types[slot] = objects.getObjectType(objectIndex);
+    m_x[slot] = position.x;
+    m_y[slot] = position.y;
+    m_z[slot] = position.z;
+    m_size[slot] = objects.getObjectSliceSize(objectIndex);
+
+    // Walk from the leaf to the root, stopping once a box no longer changes
+    for (int nodeIndex = m_leafOfSlot[slot]; nodeIndex >= 0; nodeIndex = m_nodes[nodeIndex].parent) {
+        glm::vec3 oldMin = m_nodes[nodeIndex].boundsMin;
+        glm::vec3 oldMax = m_nodes[nodeIndex].boundsMax;
+        updateBounds(nodeIndex);
+        if (m_nodes[nodeIndex].boundsMin == oldMin && m_nodes[nodeIndex].boundsMax == oldMax) {
+            break;
+        }
+    }
+}
+
+bool SceneBVH::needsRebuild(const ObjectManager& objects) const {
+    return objects.getObjectCount() != getObjectCount();
+}
+
+void SceneBVH::update(const ObjectManager& objects) {
+    if (m_synced && objects.getGeneration() == m_generation) {
+        return;
+    }
+
+    if (!m_synced || needsRebuild(objects) || !objects.getChangedObjects(m_generation, m_changedObjects)) {
+        build(objects);
+        return;
+    }
+
+    for (int index : m_changedObjects) {
+        refit(objects, index);
+    }
+    m_generation = objects.getGeneration();
+}
+
+int SceneBVH::getObjectCount() const {
+    return static_cast<int>(m_types.size());
+}
+
+int SceneBVH::getLastVisitCount() const {
+    return m_lastVisits;
+}
+
+void SceneBVH::objectBounds(int slot, glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    // Every slice fits in a box of half-size SDF_PRIMITIVE_SIZE around its centre; using the
+    // largest size keeps the boxes still while the slices change with the camera's W
+    glm::vec3 center(m_x[slot], m_y[slot], m_z[slot]);
+    boundsMin = center - glm::vec3(SDF_PRIMITIVE_SIZE);
+    boundsMax = center + glm::vec3(SDF_PRIMITIVE_SIZE);
+}
+
+void SceneBVH::updateBounds(int nodeIndex) {
+    Node& node = m_nodes[nodeIndex];
+    if (node.left < 0) {
+        node.boundsMin = glm::vec3(1e30f);
+        node.boundsMax = glm::vec3(-1e30f);
+        for (int slot = node.first; slot < node.first + node.count; slot++) {
+            glm::vec3 lo, hi;
+            objectBounds(slot, lo, hi);
+            node.boundsMin = glm::min(node.boundsMin, lo);
+            node.boundsMax = glm::max(node.boundsMax, hi);
+        }
+    } else {
+        node.boundsMin = glm::min(m_nodes[node.left].boundsMin, m_nodes[node.right].boundsMin);
+        node.boundsMax = glm::max(m_nodes[node.left].boundsMax, m_nodes[node.right].boundsMax);
+    }
+}
+
+float SceneBVH::boxDistance(const Node& node, const glm::vec3& p) const {
+    // Objects are inside their box and their SDFs are exact, so this never overestimates.
+    // Inside the box an object can be as close as -SDF_PRIMITIVE_SIZE (the centre of a primitive).
+    glm::vec3 outside = glm::max(glm::max(node.boundsMin - p, p - node.boundsMax), glm::vec3(0.0f));
+    float dist = glm::length(outside);
+    return dist > 0.0f ? dist : -SDF_PRIMITIVE_SIZE;
+}
+
+PacketScene SceneBVH::leafScene(const Node& node) const {
+    PacketScene scene;
+    scene.types = m_types.data() + node.first;
+    scene.x = m_x.data() + node.first;
+    scene.y = m_y.data() + node.first;
+    scene.z = m_z.data() + node.first;
+    scene.size = m_size.data() + node.first;
+    scene.count = node.count;
+    return scene;
+}
+
+float SceneBVH::distance(const glm::vec3& p) const {
+    int visits = 0;
+    float best = nearestDistance(p, visits);
+    m_lastVisits = visits;
+    return best;
+}
+
+float SceneBVH::nearestDistance(const glm::vec3& p, int& visits) const {
+    float best = 1000.0f;
+    if (m_root < 0) {
+        return best;
+    }
+
+    const PacketKernels& kernels = getPacketKernels();
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = m_root;
+
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        visits++;
+        if (boxDistance(node, p) >= best) {
+            continue;
+        }
+
+        if (node.left < 0) {
+            best = std::min(best, kernels.pointDistance(leafScene(node), p));
+            continue;
+        }
+
+        // Visit the nearer child first so the bound tightens early
+        float leftDist = boxDistance(m_nodes[node.left], p);
+        float rightDist = boxDistance(m_nodes[node.right], p);
+        if (leftDist < rightDist) {
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        } else {
+            stack[stackSize++] = node.left;
+            stack[stackSize++] = node.right;
+        }
+    }
+
+    return best;
+}
+
+int SceneBVH::closestObject(const glm::vec3& p, float maxDist) const {
+    float best = maxDist;
+    int bestObject = -1;
+    m_lastVisits = 0;
+    if (m_root < 0) {
+        return -1;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = m_root;
+
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        m_lastVisits++;
+        if (boxDistance(node, p) > best) {
+            continue;
+        }
+
+        if (node.left < 0) {
+            for (int slot = node.first; slot < node.first + node.count; slot++) {
+                float dist = sdfPrimitive(m_types[slot], p - glm::vec3(m_x[slot], m_y[slot], m_z[slot]), m_size[slot]);
+                int object = m_objectOfSlot[slot];
+                // Ties go to the lower index, like the linear scan
+                if (dist < best || (dist == best && bestObject >= 0 && object < bestObject)) {
+                    best = dist;
+                    bestObject = object;
+                }
+            }
+            continue;
+        }
+
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+
+    return bestObject;
+}
+
+void SceneBVH::objectsNear(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float radius,
+                           std::vector<int>& objects) const {
+    objects.clear();
+    if (m_root < 0) {
+        return;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = m_root;
+
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        glm::vec3 gap = glm::max(glm::max(node.boundsMin - boundsMax, boundsMin - node.boundsMax), glm::vec3(0.0f));
+        if (glm::length(gap) >= radius) {
+            continue;
+        }
+
+        if (node.left < 0) {
+            for (int slot = node.first; slot < node.first + node.count; slot++) {
+                glm::vec3 lo, hi;
+                objectBounds(slot, lo, hi);
+                glm::vec3 objectGap = glm::max(glm::max(lo - boundsMax, boundsMin - hi), glm::vec3(0.0f));
+                if (glm::length(objectGap) < radius) {
+                    objects.push_back(m_objectOfSlot[slot]);
+                }
+            }
+            continue;
+        }
+
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+
+    std::sort(objects.begin(), objects.end());
+}
+
+void SceneBVH::gatherBlendCandidates(const glm::vec3& p, BlendCandidates& candidates) const {
+    candidates.reset();
+    if (m_root < 0) {
+        return;
+    }
+
+    // Everything that matters lies within SDF_BLEND_K of the closest distance
+    int visits = 0;
+    float limit = nearestDistance(p, visits) + SDF_BLEND_K;
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = m_root;
+
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (boxDistance(node, p) >= limit) {
+            continue;
+        }
+
+        if (node.left < 0) {
+            for (int slot = node.first; slot < node.first + node.count; slot++) {
+                float dist = sdfPrimitive(m_types[slot], p - glm::vec3(m_x[slot], m_y[slot], m_z[slot]), m_size[slot]);
+                if (dist < limit) {
+                    candidates.add(m_objectOfSlot[slot], dist);
+                }
+            }
+            continue;
+        }
+
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+}
+
+BlendResult SceneBVH::blendedDistance(const glm::vec3& p) const {
+    BlendCandidates candidates;
+    gatherBlendCandidates(p, candidates);
+    return candidates.blend();
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SDFMath.h"
+#include "SDFPacket.h"
+
+// Bounding volume hierarchy over the (3D mapped) object positions, used to answer
+// scene distance queries without visiting every object.
+//
+// Objects are stored in leaf order as struct-of-arrays so a leaf is evaluated with one
+// call to the SIMD point kernel. Moving a single object only refits the boxes on the path
+// from its leaf to the root.
+class SceneBVH {
+public:
+    // Constructor
+    SceneBVH();
+
+    // Rebuild the hierarchy over all objects
+    void build(const ObjectManager& objects);
+
+    // Update the hierarchy after one object moved (or changed type)
+    void refit(const ObjectManager& objects, int objectIndex);
+
+    // True if the hierarchy was built for a different number of objects
+    bool needsRebuild(const ObjectManager& objects) const;
+
+    // Bring the hierarchy up to date with objects: objects that changed since the last
+    // build or update are refit, and it is rebuilt when objects were added (or the change
+    // log no longer reaches back far enough)
+    void update(const ObjectManager& objects);
+
+    // Minimum distance from p to any object (same result as a linear scan)
+    float distance(const glm::vec3& p) const;
+
+    // Index of the closest object whose distance is below maxDist (-1 if none)
+    int closestObject(const glm::vec3& p, float maxDist) const;
+
+    // Objects whose bounds come within radius of the box [boundsMin, boundsMax], in ascending order
+    void objectsNear(const glm::vec3& boundsMin, const glm::vec3& boundsMax, float radius, std::vector<int>& objects) const;
+
+    // Collect the objects that can take part in the smooth-min blend at p (see BlendCandidates).
+    // Doesn't touch the visit counter, so several threads may query at once.
+    void gatherBlendCandidates(const glm::vec3& p, BlendCandidates& candidates) const;
+
+    // Pruned smooth-min blend at p (same result as the shader's sdfScenePruned; thread safe)
+    BlendResult blendedDistance(const glm::vec3& p) const;
+
+    // Number of nodes visited by the last query (for profiling)
+    int getLastVisitCount() const;
+
+    // Number of objects in the hierarchy
+    int getObjectCount() const;
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        int parent;
+        int left, right;   // Children (-1 for leaves)
+        int first, count;  // Leaf range in leaf order
+    };
+
+    // Recursively build the subtree over leaf order [first, first + count)
+    int buildNode(int first, int count, int parent, const std::vector<glm::vec3>& centers);
+
+    // Recompute a node's bounds from its objects or children
+    void updateBounds(int nodeIndex);
+
+    // Bounds of the object in leaf slot
+    void objectBounds(int slot, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+    // Minimum distance from p to any object, counting visited nodes into visits
+    float nearestDistance(const glm::vec3& p, int& visits) const;
+
+    // Lower bound of the distance from p to anything inside a node
+    float boxDistance(const Node& node, const glm::vec3& p) const;
+
+    // Leaf evaluated through the packet kernel
+    PacketScene leafScene(const Node& node) const;
+
+    std::vector<Node> m_nodes;
+    int m_root;
+
+    // Objects in leaf order
+    std::vector<int> m_types;
+    std::vector<float> m_x, m_y, m_z;
+    std::vector<float> m_size;        // Slice sizes
+    std::vector<int> m_objectOfSlot;  // Leaf slot -> object index
+    std::vector<int> m_slotOfObject;  // Object index -> leaf slot
+    std::vector<int> m_leafOfSlot;    // Leaf slot -> node index
+
+    // Change tracking for update()
+    bool m_synced;
+    unsigned long long m_generation;
+    std::vector<int> m_changedObjects;
+
+    mutable int m_lastVisits;
+};
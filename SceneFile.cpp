@@ -0,0 +1,361 @@
+#include "SceneFile.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    const char SCENE_FILE_MAGIC[4] = {'S', 'D', 'F', 'S'};
+
+    // Bytes moved at a time when the writer moves an array
+    const size_t MOVE_CHUNK_BYTES = 1 << 20;
+
+    uint64_t alignUp(uint64_t value) {
+        return (value + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+    }
+}
+
+SceneFile::SceneFile()
+    : m_mapping(nullptr), m_mappingSize(0), m_objectCount(0),
+      m_types(nullptr), m_x(nullptr), m_y(nullptr), m_z(nullptr), m_w(nullptr) {
+}
+
+SceneFile::~SceneFile() {
+    close();
+}
+
+bool isLittleEndian() {
+    uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+bool SceneFile::open(const std::string& path) {
+    close();
+    if (!isLittleEndian()) {
+        std::cerr << "Scene files can only be read on little-endian hosts" << std::endl;
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open scene file " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SceneFileHeader))) {
+        std::cerr << "Scene file " << path << " is too small" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map scene file " << path << std::endl;
+        return false;
+    }
+
+    SceneFileHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    const char* problem = nullptr;
+    if (std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        problem = "is not a scene file";
+    } else if (header.version != SCENE_FILE_VERSION || header.headerSize != sizeof(SceneFileHeader)) {
+        problem = "has an unsupported version";
+    } else if (header.objectCount > static_cast<uint64_t>(INT_MAX)) {
+        problem = "has too many objects";
+    } else {
+        // Every array aligned and inside the file (objectCount is small enough not to overflow)
+        uint64_t offsets[5] = {header.typesOffset, header.xOffset, header.yOffset, header.zOffset, header.wOffset};
+        for (uint64_t offset : offsets) {
+            if (offset % SCENE_FILE_ALIGNMENT != 0 || offset < sizeof(SceneFileHeader) ||
+                offset > size || header.objectCount * 4 > size - offset) {
+                problem = "is truncated or corrupt";
+            }
+        }
+    }
+    if (problem) {
+        std::cerr << "Scene file " << path << " " << problem << std::endl;
+        munmap(mapping, size);
+        return false;
+    }
+
+    // The objects are read front to back by appendTo and the uploads
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(mapping);
+    m_mapping = mapping;
+    m_mappingSize = size;
+    m_objectCount = static_cast<int>(header.objectCount);
+    m_types = reinterpret_cast<const int*>(base + header.typesOffset);
+    m_x = reinterpret_cast<const float*>(base + header.xOffset);
+    m_y = reinterpret_cast<const float*>(base + header.yOffset);
+    m_z = reinterpret_cast<const float*>(base + header.zOffset);
+    m_w = reinterpret_cast<const float*>(base + header.wOffset);
+    return true;
+}
+
+void SceneFile::close() {
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+    m_objectCount = 0;
+    m_types = nullptr;
+    m_x = m_y = m_z = m_w = nullptr;
+}
+
+bool SceneFile::isOpen() const {
+    return m_mapping != nullptr;
+}
+
+int SceneFile::getObjectCount() const {
+    return m_objectCount;
+}
+
+const int* SceneFile::getTypesArray() const {
+    return m_types;
+}
+
+const float* SceneFile::getXArray() const {
+    return m_x;
+}
+
+const float* SceneFile::getYArray() const {
+    return m_y;
+}
+
+const float* SceneFile::getZArray() const {
+    return m_z;
+}
+
+const float* SceneFile::getWArray() const {
+    return m_w;
+}
+
+void SceneFile::appendTo(ObjectManager& objects) const {
+    objects.addObjects(m_types, m_x, m_y, m_z, m_w, m_objectCount);
+}
+
+SceneWriter::SceneWriter() : m_fd(-1), m_written(0), m_capacity(0), m_failed(false) {
+}
+
+SceneWriter::~SceneWriter() {
+    discard();
+}
+
+bool SceneWriter::open(const std::string& path, int expectedObjects) {
+    discard();
+    if (!isLittleEndian()) {
+        std::cerr << "Scene files can only be written on little-endian hosts" << std::endl;
+        return false;
+    }
+    m_path = path;
+    m_tempPath = path + ".tmp";
+    m_fd = ::open(m_tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        std::cerr << "Failed to create scene file " << m_tempPath << std::endl;
+        return false;
+    }
+    m_written = 0;
+    m_capacity = static_cast<uint64_t>(std::max(expectedObjects, 1));
+    m_failed = false;
+    m_blockTypes.clear();
+    m_blockTypes.reserve(BLOCK_OBJECTS);
+    for (std::vector<float>& component : m_block) {
+        component.clear();
+        component.reserve(BLOCK_OBJECTS);
+    }
+    return true;
+}
+
+bool SceneWriter::addObject(int type, const glm::vec4& position) {
+    if (m_fd < 0 || m_failed) {
+        return false;
+    }
+    m_blockTypes.push_back(type);
+    for (int component = 0; component < 4; component++) {
+        m_block[component].push_back(position[component]);
+    }
+    if (m_blockTypes.size() >= static_cast<size_t>(BLOCK_OBJECTS)) {
+        return flushBlock();
+    }
+    return true;
+}
+
+bool SceneWriter::addObjects(const ObjectManager& objects) {
+    int count = objects.getObjectCount();
+    for (int i = 0; i < count; i++) {
+        if (!addObject(objects.getObjectType(i), objects.getObjectPosition(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneWriter::finish() {
+    if (m_fd < 0 || m_failed || !flushBlock()) {
+        discard();
+        return false;
+    }
+
+    // Pack the arrays down to the object count, front to back so nothing is overwritten
+    // before it's moved
+    for (int array = 1; array < 5; array++) {
+        if (!moveArray(array, m_capacity, m_written)) {
+            discard();
+            return false;
+        }
+    }
+
+    SceneFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_FILE_VERSION;
+    header.headerSize = sizeof(SceneFileHeader);
+    header.objectCount = m_written;
+    header.typesOffset = arrayOffset(0, m_written);
+    header.xOffset = arrayOffset(1, m_written);
+    header.yOffset = arrayOffset(2, m_written);
+    header.zOffset = arrayOffset(3, m_written);
+    header.wOffset = arrayOffset(4, m_written);
+    uint64_t end = header.wOffset + m_written * 4;
+    if (!writeAt(&header, sizeof(header), 0) || ftruncate(m_fd, static_cast<off_t>(end)) != 0) {
+        std::cerr << "Failed to write scene file " << m_tempPath << std::endl;
+        discard();
+        return false;
+    }
+    ::close(m_fd);
+    m_fd = -1;
+    if (std::rename(m_tempPath.c_str(), m_path.c_str()) != 0) {
+        std::cerr << "Failed to move scene file to " << m_path << std::endl;
+        std::remove(m_tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+int SceneWriter::getObjectCount() const {
+    return static_cast<int>(m_written + m_blockTypes.size());
+}
+
+bool SceneWriter::write(const std::string& path, const ObjectManager& objects) {
+    SceneWriter writer;
+    return writer.open(path, objects.getObjectCount()) && writer.addObjects(objects) && writer.finish();
+}
+
+bool SceneWriter::flushBlock() {
+    uint64_t count = m_blockTypes.size();
+    if (count == 0) {
+        return !m_failed;
+    }
+    if (m_written + count > static_cast<uint64_t>(INT_MAX)) {
+        std::cerr << "Scene file " << m_tempPath << " has too many objects" << std::endl;
+        m_failed = true;
+        return false;
+    }
+    if (m_written + count > m_capacity && !grow(std::max(m_capacity * 2, m_written + count))) {
+        m_failed = true;
+        return false;
+    }
+    bool written = writeAt(m_blockTypes.data(), count * 4, arrayOffset(0, m_capacity) + m_written * 4);
+    for (int component = 0; component < 4 && written; component++) {
+        written = writeAt(m_block[component].data(), count * 4, arrayOffset(component + 1, m_capacity) + m_written * 4);
+    }
+    if (!written) {
+        std::cerr << "Failed to write scene file " << m_tempPath << std::endl;
+        m_failed = true;
+        return false;
+    }
+    m_written += count;
+    m_blockTypes.clear();
+    for (std::vector<float>& component : m_block) {
+        component.clear();
+    }
+    return true;
+}
+
+bool SceneWriter::grow(uint64_t capacity) {
+    // Back to front, so every array moves into space its successors have already left
+    for (int array = 4; array > 0; array--) {
+        if (!moveArray(array, m_capacity, capacity)) {
+            return false;
+        }
+    }
+    m_capacity = capacity;
+    return true;
+}
+
+bool SceneWriter::moveArray(int array, uint64_t oldCapacity, uint64_t newCapacity) {
+    uint64_t from = arrayOffset(array, oldCapacity);
+    uint64_t to = arrayOffset(array, newCapacity);
+    uint64_t bytes = m_written * 4;
+    if (from == to || bytes == 0) {
+        return true;
+    }
+
+    // Chunk order as in memmove, so overlapping source and destination are safe
+    std::vector<char> chunk(static_cast<size_t>(std::min<uint64_t>(bytes, MOVE_CHUNK_BYTES)));
+    for (uint64_t done = 0; done < bytes;) {
+        uint64_t size = std::min<uint64_t>(chunk.size(), bytes - done);
+        uint64_t position = to > from ? bytes - done - size : done;
+        if (!readAt(chunk.data(), size, from + position) || !writeAt(chunk.data(), size, to + position)) {
+            std::cerr << "Failed to move data in scene file " << m_tempPath << std::endl;
+            return false;
+        }
+        done += size;
+    }
+    return true;
+}
+
+uint64_t SceneWriter::arrayOffset(int array, uint64_t capacity) {
+    return alignUp(sizeof(SceneFileHeader)) + array * alignUp(capacity * 4);
+}
+
+bool SceneWriter::writeAt(const void* data, size_t bytes, uint64_t offset) {
+    const char* bytesLeft = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t written = pwrite(m_fd, bytesLeft, bytes, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        bytesLeft += written;
+        bytes -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool SceneWriter::readAt(void* data, size_t bytes, uint64_t offset) {
+    char* bytesLeft = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t read = pread(m_fd, bytesLeft, bytes, static_cast<off_t>(offset));
+        if (read <= 0) {
+            return false;
+        }
+        bytesLeft += read;
+        bytes -= read;
+        offset += read;
+    }
+    return true;
+}
+
+void SceneWriter::discard() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        std::remove(m_tempPath.c_str());
+    }
+    m_blockTypes.clear();
+    for (std::vector<float>& component : m_block) {
+        component.clear();
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+
+// Binary scene files: the object arrays of ObjectManager as they are in memory, so a
+// mapped file can be used in place. All values are little-endian.
+//
+//   SceneFileHeader (64 bytes)
+//   int32 types[objectCount]    at typesOffset
+//   float x[objectCount]        at xOffset
+//   float y[objectCount], z[objectCount], w[objectCount] likewise
+//
+// Every array starts on a SCENE_FILE_ALIGNMENT boundary, so mapped arrays are as aligned
+// as AlignedVector storage and can go straight to the SIMD code. Readers use the offsets
+// in the header rather than assuming the arrays are packed.
+const uint32_t SCENE_FILE_VERSION = 1;
+const uint64_t SCENE_FILE_ALIGNMENT = 64;
+
+struct SceneFileHeader {
+    char magic[4];         // "SDFS"
+    uint32_t version;      // SCENE_FILE_VERSION
+    uint32_t headerSize;   // sizeof(SceneFileHeader)
+    uint32_t reserved;
+    uint64_t objectCount;
+    uint64_t typesOffset;
+    uint64_t xOffset, yOffset, zOffset, wOffset;
+};
+
+// Whether the host is little-endian; scene and world files are only read and written on
+// such hosts, since their values are used as they are in the file
+bool isLittleEndian();
+
+// A scene file mapped read-only. The arrays point into the mapping and stay valid until
+// the file is closed; opening checks the header and that every array lies inside the file,
+// but doesn't read the objects themselves.
+class SceneFile {
+public:
+    SceneFile();
+    ~SceneFile();
+
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    // Map a scene file (closing any open one). Returns false, with the reason on stderr,
+    // if it can't be mapped or isn't a valid scene file.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    int getObjectCount() const;
+    const int* getTypesArray() const;
+    const float* getXArray() const;
+    const float* getYArray() const;
+    const float* getZArray() const;
+    const float* getWArray() const;
+
+    // Append every object of the file to `objects` in one batch
+    void appendTo(ObjectManager& objects) const;
+
+private:
+    void* m_mapping;
+    size_t m_mappingSize;
+    int m_objectCount;
+    const int* m_types;
+    const float* m_x;
+    const float* m_y;
+    const float* m_z;
+    const float* m_w;
+};
+
+// Writes a scene file one object at a time without holding the scene: objects are buffered
+// in blocks and written to their place in each array. The arrays are laid out for a
+// capacity that doubles (moving them on disk) when it's exceeded, and packed by finish.
+// The file is written under a temporary name and only appears at `path` once finished, so
+// readers never see a partial scene.
+class SceneWriter {
+public:
+    // Objects buffered before a write
+    static const int BLOCK_OBJECTS = 16384;
+
+    SceneWriter();
+
+    // Discards an unfinished file
+    ~SceneWriter();
+
+    SceneWriter(const SceneWriter&) = delete;
+    SceneWriter& operator=(const SceneWriter&) = delete;
+
+    // Start writing to `path`; expectedObjects sizes the arrays (a wrong guess only costs a move)
+    bool open(const std::string& path, int expectedObjects = BLOCK_OBJECTS);
+
+    // Append one object. Returns false once a write has failed.
+    bool addObject(int type, const glm::vec4& position);
+
+    // Append every object of `objects`
+    bool addObjects(const ObjectManager& objects);
+
+    // Write the remaining objects and the header and move the file into place
+    bool finish();
+
+    // Objects added so far
+    int getObjectCount() const;
+
+    // Write a whole scene to `path`
+    static bool write(const std::string& path, const ObjectManager& objects);
+
+private:
+    // Write the buffered block to the arrays, growing them first if needed
+    bool flushBlock();
+
+    // Move the arrays apart to hold `capacity` objects each
+    bool grow(uint64_t capacity);
+
+    // Move the written part of array `array` from its offset at oldCapacity to its
+    // offset at newCapacity
+    bool moveArray(int array, uint64_t oldCapacity, uint64_t newCapacity);
+
+    // Offset of array `array` (0 types, 1-4 x-w) when the arrays hold `capacity` objects
+    static uint64_t arrayOffset(int array, uint64_t capacity);
+
+    bool writeAt(const void* data, size_t bytes, uint64_t offset);
+    bool readAt(void* data, size_t bytes, uint64_t offset);
+
+    void discard();
+
+    int m_fd;
+    std::string m_path;
+    std::string m_tempPath;
+    uint64_t m_written;   // Objects in the file
+    uint64_t m_capacity;  // Objects each array has room for
+    bool m_failed;
+
+    // Buffered block, one array per component
+    std::vector<int32_t> m_blockTypes;
+    std::vector<float> m_block[4];
+};
@@ -0,0 +1,240 @@
+#include "SceneShaderCache.h"
+#include "ShaderSources.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // Markers around the generic scene loops in fragmentShaderSource
+    const char* const SCENE_LOOPS_BEGIN = "// @scene-loops-begin";
+    const char* const SCENE_LOOPS_END = "// @scene-loops-end";
+
+    // Object types the generator knows: SDF of an object texel, constant index list and
+    // name in comments
+    const int SCENE_SHADER_TYPES = 2;
+    const char* const TYPE_SDF[SCENE_SHADER_TYPES] = {"sdfSphereObject", "sdfCubeObject"};
+    const char* const TYPE_LIST[SCENE_SHADER_TYPES] = {"SPHERE_OBJECTS", "CUBE_OBJECTS"};
+    const char* const TYPE_NAME[SCENE_SHADER_TYPES] = {"hyperspheres", "tesseracts"};
+
+    // Frames a compile gets before it's checked, for drivers that can't say whether it's done
+    const unsigned long long COMPILE_GRACE_FRAMES = 2;
+
+    // Whether a group's indices are consecutive (then it loops over the range, not a list)
+    bool isContiguous(const std::vector<int>& group) {
+        return group.back() - group.front() + 1 == static_cast<int>(group.size());
+    }
+
+    // Call `visit` (e.g. "blendObject(result") with every object and its distance, group by group
+    void appendObjectVisits(std::string& out, const std::vector<int>* groups, bool unrolled, const char* visit) {
+        for (int type = 0; type < SCENE_SHADER_TYPES; type++) {
+            const std::vector<int>& group = groups[type];
+            if (group.empty()) {
+                continue;
+            }
+            if (unrolled) {
+                for (int index : group) {
+                    std::string i = std::to_string(index);
+                    out += "    " + std::string(visit) + ", " + i + ", " + TYPE_SDF[type] +
+                           "(p, texelFetch(u_objects, " + i + ")));\n";
+                }
+            } else if (isContiguous(group)) {
+                std::string first = std::to_string(group.front());
+                std::string last = std::to_string(group.back() + 1);
+                out += "    for (int i = " + first + "; i < " + last + "; i++) {\n";
+                out += "        " + std::string(visit) + ", i, " + TYPE_SDF[type] + "(p, texelFetch(u_objects, i)));\n";
+                out += "    }\n";
+            } else {
+                out += "    for (int k = 0; k < " + std::to_string(group.size()) + "; k++) {\n";
+                out += "        int i = " + std::string(TYPE_LIST[type]) + "[k];\n";
+                out += "        " + std::string(visit) + ", i, " + TYPE_SDF[type] + "(p, texelFetch(u_objects, i)));\n";
+                out += "    }\n";
+            }
+        }
+    }
+}
+
+std::string generateSceneShader(const int* types, int count) {
+    std::string generic = fragmentShaderSource;
+    size_t begin = generic.find(SCENE_LOOPS_BEGIN);
+    size_t end = generic.find(SCENE_LOOPS_END);
+    if (count <= 0 || count > SCENE_SHADER_MAX_OBJECTS || begin == std::string::npos || end == std::string::npos) {
+        return std::string();
+    }
+
+    // Objects grouped by type, in index order within each group
+    std::vector<int> groups[SCENE_SHADER_TYPES];
+    for (int i = 0; i < count; i++) {
+        if (types[i] < 0 || types[i] >= SCENE_SHADER_TYPES) {
+            return std::string();
+        }
+        groups[types[i]].push_back(i);
+    }
+    bool unrolled = count <= SCENE_SHADER_UNROLL_LIMIT;
+
+    std::string scene = "// Scene loops specialised to " + std::to_string(count) + " objects (";
+    for (int type = 0; type < SCENE_SHADER_TYPES; type++) {
+        scene += std::to_string(groups[type].size()) + " " + TYPE_NAME[type] + (type + 1 < SCENE_SHADER_TYPES ? ", " : ")\n");
+    }
+    if (!unrolled) {
+        for (int type = 0; type < SCENE_SHADER_TYPES; type++) {
+            const std::vector<int>& group = groups[type];
+            if (group.empty() || isContiguous(group)) {
+                continue;
+            }
+            std::string size = std::to_string(group.size());
+            scene += "const int " + std::string(TYPE_LIST[type]) + "[" + size + "] = int[" + size + "](";
+            for (size_t k = 0; k < group.size(); k++) {
+                scene += (k > 0 ? ", " : "") + std::to_string(group[k]);
+            }
+            scene += ");\n";
+        }
+    }
+
+    // Grouping changes the order objects are blended in; the blended distance doesn't
+    // depend on it (see blendObject), and the pruned blend sorts its candidates anyway
+    scene += "\nBlendResult sdfSceneFull(vec3 p) {\n    BlendResult result = emptyBlend();\n";
+    appendObjectVisits(scene, groups, unrolled, "blendObject(result");
+    scene += "    return result;\n}\n";
+    scene += "\nBlendResult sdfScenePruned(vec3 p) {\n    BlendCandidates candidates = emptyCandidates();\n";
+    appendObjectVisits(scene, groups, unrolled, "addCandidate(candidates");
+    scene += "    return blendCandidates(candidates);\n}\n\n";
+
+    return generic.substr(0, begin) + scene + generic.substr(end + std::string(SCENE_LOOPS_END).size());
+}
+
+SceneShaderCache::SceneShaderCache() : m_compiling(-1), m_frame(0), m_compileCount(0), m_rejectedCount(0) {
+}
+
+Shader* SceneShaderCache::getProgram(const ObjectManager& objects, int& sampleId) {
+    m_frame++;
+    sampleId = -1;
+    pollCompile();
+
+    int count = objects.getObjectCount();
+    if (count <= 0 || count > SCENE_SHADER_MAX_OBJECTS) {
+        return nullptr;
+    }
+    const int* types = objects.getTypesArray();
+    m_signature.resize(count);
+    for (int i = 0; i < count; i++) {
+        if (types[i] < 0 || types[i] >= SCENE_SHADER_TYPES) {
+            return nullptr;
+        }
+        m_signature[i] = static_cast<char>('0' + types[i]);
+    }
+
+    for (Entry& entry : m_entries) {
+        if (entry.signature != m_signature) {
+            continue;
+        }
+        entry.lastUsed = m_frame;
+        if (entry.state == PROGRAM_EVALUATING) {
+            // Draw with whichever program is short of samples
+            int specialised = entry.sampleCount[1] <= entry.sampleCount[0] ? 1 : 0;
+            sampleId = entry.id * 2 + specialised;
+            return specialised ? entry.shader.get() : nullptr;
+        }
+        return entry.state == PROGRAM_READY ? entry.shader.get() : nullptr;
+    }
+    if (m_compiling < 0) {
+        startCompile(objects);
+    }
+    return nullptr;
+}
+
+void SceneShaderCache::reportGpuTime(int sampleId, float milliseconds) {
+    if (sampleId < 0) {
+        return;
+    }
+    for (Entry& entry : m_entries) {
+        if (entry.id != sampleId / 2) {
+            continue;
+        }
+        int specialised = sampleId % 2;
+        if (entry.state == PROGRAM_EVALUATING && entry.sampleCount[specialised] < EVALUATION_SAMPLES) {
+            entry.samples[specialised][entry.sampleCount[specialised]++] = milliseconds;
+            if (entry.sampleCount[0] == EVALUATION_SAMPLES && entry.sampleCount[1] == EVALUATION_SAMPLES) {
+                finishEvaluation(entry);
+            }
+        }
+        return;
+    }
+}
+
+void SceneShaderCache::finishEvaluation(Entry& entry) {
+    // Medians, so one-off spikes (like the first draw with a new program) don't decide
+    float median[2];
+    for (int specialised = 0; specialised < 2; specialised++) {
+        float* samples = entry.samples[specialised];
+        std::nth_element(samples, samples + EVALUATION_SAMPLES / 2, samples + EVALUATION_SAMPLES);
+        median[specialised] = samples[EVALUATION_SAMPLES / 2];
+    }
+    if (median[1] < median[0]) {
+        entry.state = PROGRAM_READY;
+    } else {
+        entry.state = PROGRAM_REJECTED;
+        entry.shader.reset();
+        m_rejectedCount++;
+    }
+}
+
+void SceneShaderCache::pollCompile() {
+    if (m_compiling < 0) {
+        return;
+    }
+    Entry& entry = m_entries[m_compiling];
+    if (m_frame - entry.compileStarted < COMPILE_GRACE_FRAMES || !entry.shader->isCompileFinished()) {
+        return;
+    }
+    if (entry.shader->finishCompile()) {
+        entry.state = PROGRAM_EVALUATING;
+    } else {
+        std::cerr << "Failed to compile the shader specialised to " << entry.signature.size()
+                  << " objects, using the generic shader" << std::endl;
+        entry.state = PROGRAM_FAILED;
+        entry.shader.reset();
+    }
+    m_compiling = -1;
+}
+
+void SceneShaderCache::startCompile(const ObjectManager& objects) {
+    // Nothing is compiling, so any entry can go
+    if (static_cast<int>(m_entries.size()) >= MAX_PROGRAMS) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < m_entries.size(); i++) {
+            if (m_entries[i].lastUsed < m_entries[oldest].lastUsed) {
+                oldest = i;
+            }
+        }
+        m_entries.erase(m_entries.begin() + oldest);
+    }
+
+    Entry entry;
+    entry.id = m_compileCount++;
+    entry.signature = m_signature;
+    entry.lastUsed = m_frame;
+    entry.compileStarted = m_frame;
+    entry.sampleCount[0] = entry.sampleCount[1] = 0;
+    std::string source = generateSceneShader(objects.getTypesArray(), objects.getObjectCount());
+    if (source.empty()) {
+        entry.state = PROGRAM_FAILED;
+    } else {
+        entry.shader.reset(new Shader());
+        entry.shader->compileAsync(vertexShaderSource, source.c_str());
+        entry.state = PROGRAM_COMPILING;
+        m_compiling = static_cast<int>(m_entries.size());
+    }
+    m_entries.push_back(std::move(entry));
+}
+
+void SceneShaderCache::cleanup() {
+    m_entries.clear();
+    m_compiling = -1;
+}
+
+int SceneShaderCache::getCompileCount() const {
+    return m_compileCount;
+}
+
+int SceneShaderCache::getRejectedCount() const {
+    return m_rejectedCount;
+}
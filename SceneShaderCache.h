@@ -0,0 +1,99 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Shader.h"
+#include "ObjectManager.h"
+
+// Largest scene that gets a specialised shader; bigger scenes use the generic one
+const int SCENE_SHADER_MAX_OBJECTS = 256;
+
+// Scenes up to this size are fully unrolled, bigger ones loop over each type's objects
+const int SCENE_SHADER_UNROLL_LIMIT = 16;
+
+// Fragment shader source specialised to a scene: fragmentShaderSource with the scene loops
+// replaced by code for exactly these object types (types[i] of object i). Objects are
+// grouped by type, so every group calls its SDF directly instead of branching on the type
+// of each object, and small scenes are unrolled. Returns an empty string if the scene
+// can't be specialised (too many objects or an unknown type).
+std::string generateSceneShader(const int* types, int count);
+
+// Programs specialised to the scene signature (the type of every object), compiled in the
+// background. getProgram returns nullptr until the program of the current signature is
+// ready, and the renderer keeps drawing with the generic shader meanwhile, so a new
+// signature never stalls a frame. One program compiles at a time; the least recently used
+// program is dropped when the cache is full.
+//
+// Whether specialising pays off depends on the driver: constant trip counts invite it to
+// unroll the scene loops inside the raymarch loop, which some compilers turn into slower
+// code. So a new program is first alternated with the generic one, and kept only if its
+// measured GPU time (reported back through reportGpuTime) is lower.
+class SceneShaderCache {
+public:
+    // Programs kept at once
+    static const int MAX_PROGRAMS = 8;
+
+    // GPU time samples of each program compared before choosing between them
+    static const int EVALUATION_SAMPLES = 8;
+
+    SceneShaderCache();
+
+    SceneShaderCache(const SceneShaderCache&) = delete;
+    SceneShaderCache& operator=(const SceneShaderCache&) = delete;
+
+    // Once per frame on the GL thread: check the compile in flight, start one for the
+    // objects' signature if it has none, and return the program to draw with (nullptr for
+    // the generic one). sampleId identifies the frame for reportGpuTime (-1 if its time
+    // isn't needed).
+    Shader* getProgram(const ObjectManager& objects, int& sampleId);
+
+    // GPU time of a frame drawn after getProgram, as milliseconds at full resolution
+    void reportGpuTime(int sampleId, float milliseconds);
+
+    // Delete all programs (needs the GL context)
+    void cleanup();
+
+    // Programs compiled so far (including failed ones)
+    int getCompileCount() const;
+
+    // Programs that turned out slower than the generic shader
+    int getRejectedCount() const;
+
+private:
+    enum ProgramState {
+        PROGRAM_COMPILING,
+        PROGRAM_EVALUATING,  // Alternated with the generic shader and timed
+        PROGRAM_READY,
+        PROGRAM_REJECTED,    // Slower than the generic shader
+        PROGRAM_FAILED       // Kept so the signature isn't tried again
+    };
+
+    struct Entry {
+        int id;
+        std::string signature;  // One character per object: '0' + type
+        std::unique_ptr<Shader> shader;
+        ProgramState state;
+        unsigned long long lastUsed;
+        unsigned long long compileStarted;  // Frame the compile was started in
+
+        // GPU times while evaluating: [0] generic, [1] specialised
+        float samples[2][EVALUATION_SAMPLES];
+        int sampleCount[2];
+    };
+
+    // Finish the compile in flight once the driver is done with it
+    void pollCompile();
+
+    // Start compiling the current signature, evicting the least recently used program if needed
+    void startCompile(const ObjectManager& objects);
+
+    // Keep or reject an evaluated program by the median times
+    void finishEvaluation(Entry& entry);
+
+    std::vector<Entry> m_entries;
+    int m_compiling;              // Entry being compiled (-1 if none)
+    std::string m_signature;      // Scratch for the current frame's signature
+    unsigned long long m_frame;
+    int m_compileCount;
+    int m_rejectedCount;
+};
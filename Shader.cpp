@@ -1,61 +1,304 @@
 
 #include "Shader.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <vector>
 
-Shader::Shader() : ID(0) {
+namespace {
+    // Cache file header, followed by `length` bytes of program binary
+    struct BinaryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format;       // Driver binary format from glGetProgramBinary
+        uint32_t length;
+        float compileMilliseconds;  // How long the program took to build from source
+    };
+    
+    const uint32_t BINARY_MAGIC = 0x42464453;  // "SDFB"
+    const uint32_t BINARY_VERSION = 1;
+    
+    // Cached binaries bigger than this are treated as corrupt
+    const uint32_t MAX_BINARY_LENGTH = 64u << 20;
+    
+    // 64-bit FNV-1a, including the terminating zero so "ab" + "c" and "a" + "bc" differ
+    uint64_t hashString(uint64_t hash, const char* text) {
+        if (!text) {
+            text = "";
+        }
+        do {
+            hash ^= static_cast<unsigned char>(*text);
+            hash *= 0x100000001b3ULL;
+        } while (*text++);
+        return hash;
+    }
+    
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+std::string Shader::binaryCacheDirectory;
+Shader::BinaryCacheStats Shader::binaryCacheStats = {};
+
+void Shader::setBinaryCacheDirectory(const std::string& directory) {
+    binaryCacheDirectory = directory;
+}
+
+const Shader::BinaryCacheStats& Shader::getBinaryCacheStats() {
+    return binaryCacheStats;
+}
+
+Shader::Shader() : ID(0), pendingVertex(0), pendingFragment(0) {
 }
 
 Shader::~Shader() {
+    glDeleteShader(pendingVertex);
+    glDeleteShader(pendingFragment);
     glDeleteProgram(ID);
 }
 
 bool Shader::compile(const char* vertexSource, const char* fragmentSource) {
+    pendingCachePath = binaryCachePath(vertexSource, fragmentSource);
+    if (!pendingCachePath.empty() && loadBinary(pendingCachePath)) {
+        return true;
+    }
+    compileStart = std::chrono::steady_clock::now();
+    
     // Create shader objects
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexSource, NULL);
     glCompileShader(vertexShader);
-    checkCompileErrors(vertexShader, "VERTEX");
+    bool success = checkCompileErrors(vertexShader, "VERTEX");
     
     GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
     glCompileShader(fragmentShader);
-    checkCompileErrors(fragmentShader, "FRAGMENT");
+    success = checkCompileErrors(fragmentShader, "FRAGMENT") && success;
     
     // Create shader program
     ID = glCreateProgram();
     glAttachShader(ID, vertexShader);
     glAttachShader(ID, fragmentShader);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    linkProgram();
+    success = checkCompileErrors(ID, "PROGRAM") && success;
     
     // Delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
     
+    double milliseconds = millisecondsSince(compileStart);
+    binaryCacheStats.programsCompiled++;
+    binaryCacheStats.compileMilliseconds += milliseconds;
+    if (success) {
+        saveBinary(milliseconds);
+    }
+    return success;
+}
+
+void Shader::compileAsync(const char* vertexSource, const char* fragmentSource) {
+    pendingCachePath = binaryCachePath(vertexSource, fragmentSource);
+    if (!pendingCachePath.empty() && loadBinary(pendingCachePath)) {
+        return;
+    }
+    compileStart = std::chrono::steady_clock::now();
+    
+    pendingVertex = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pendingVertex, 1, &vertexSource, NULL);
+    glCompileShader(pendingVertex);
+    
+    pendingFragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pendingFragment, 1, &fragmentSource, NULL);
+    glCompileShader(pendingFragment);
+    
+    // Linking right away lets the driver carry on with the whole program in the background
+    ID = glCreateProgram();
+    glAttachShader(ID, pendingVertex);
+    glAttachShader(ID, pendingFragment);
+    linkProgram();
+}
+
+bool Shader::isCompileFinished() const {
+    if (!GLEW_ARB_parallel_shader_compile || (!pendingVertex && !pendingFragment)) {
+        return true;
+    }
+    GLint finished = GL_FALSE;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_ARB, &finished);
+    return finished == GL_TRUE;
+}
+
+bool Shader::finishCompile() {
+    if (!pendingVertex && !pendingFragment) {
+        // Loaded from the binary cache
+        GLint linked = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+    
+    bool success = checkCompileErrors(pendingVertex, "VERTEX");
+    success = checkCompileErrors(pendingFragment, "FRAGMENT") && success;
+    success = checkCompileErrors(ID, "PROGRAM") && success;
+    glDeleteShader(pendingVertex);
+    glDeleteShader(pendingFragment);
+    pendingVertex = pendingFragment = 0;
+    
+    // For a background compile this is how long the program took to become usable
+    double milliseconds = millisecondsSince(compileStart);
+    binaryCacheStats.programsCompiled++;
+    binaryCacheStats.compileMilliseconds += milliseconds;
+    if (success) {
+        saveBinary(milliseconds);
+    }
+    return success;
+}
+
+void Shader::linkProgram() {
+    if (!pendingCachePath.empty()) {
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(ID);
+}
+
+std::string Shader::binaryCachePath(const char* vertexSource, const char* fragmentSource) {
+    if (binaryCacheDirectory.empty() || !GLEW_ARB_get_program_binary) {
+        return std::string();
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+        return std::string();
+    }
+    
+    // A driver update can change or invalidate the binaries, so it's part of the key
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashString(hash, vertexSource);
+    hash = hashString(hash, fragmentSource);
+    hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return binaryCacheDirectory + "/" + name;
+}
+
+bool Shader::loadBinary(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    BinaryHeader header;
+    std::vector<char> binary;
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                 header.magic == BINARY_MAGIC && header.version == BINARY_VERSION &&
+                 header.length > 0 && header.length <= MAX_BINARY_LENGTH;
+    if (valid) {
+        binary.resize(header.length);
+        valid = std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    std::fclose(file);
+    
+    // The format must be one the driver still accepts (glProgramBinary raises an error otherwise)
+    if (valid) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        std::vector<GLint> formats(formatCount > 0 ? formatCount : 0);
+        if (formatCount > 0) {
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        }
+        valid = std::find(formats.begin(), formats.end(), static_cast<GLint>(header.format)) != formats.end();
+    }
+    
+    GLint linked = GL_FALSE;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (valid) {
+        ID = glCreateProgram();
+        glProgramBinary(ID, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    }
+    if (linked != GL_TRUE) {
+        // Stale or corrupt: drop it, and the caller rebuilds from source and saves a fresh one
+        glDeleteProgram(ID);
+        ID = 0;
+        std::remove(path.c_str());
+        binaryCacheStats.binariesRejected++;
+        return false;
+    }
+    
+    double milliseconds = millisecondsSince(start);
+    binaryCacheStats.programsLoaded++;
+    binaryCacheStats.loadMilliseconds += milliseconds;
+    binaryCacheStats.savedMilliseconds += std::max(0.0, header.compileMilliseconds - milliseconds);
     return true;
 }
 
+void Shader::saveBinary(double compileMilliseconds) {
+    if (pendingCachePath.empty()) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0 || static_cast<uint32_t>(length) > MAX_BINARY_LENGTH) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, &length, &format, binary.data());
+    
+    BinaryHeader header;
+    header.magic = BINARY_MAGIC;
+    header.version = BINARY_VERSION;
+    header.format = format;
+    header.length = static_cast<uint32_t>(length);
+    header.compileMilliseconds = static_cast<float>(compileMilliseconds);
+    
+    // Write to a temporary file and rename it, so another instance never reads half a binary
+    std::error_code error;
+    std::filesystem::create_directories(binaryCacheDirectory, error);
+    std::string temporaryPath = pendingCachePath + ".tmp";
+    FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(binary.data(), 1, header.length, file) == header.length;
+    written = std::fclose(file) == 0 && written;
+    if (!written || std::rename(temporaryPath.c_str(), pendingCachePath.c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+    }
+}
+
 void Shader::use() {
     glUseProgram(ID);
 }
 
-void Shader::setInt(const std::string &name, int value) {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setInt(const char* name, int value) {
+    glUniform1i(glGetUniformLocation(ID, name), value);
+}
+
+void Shader::setFloat(const char* name, float value) {
+    glUniform1f(glGetUniformLocation(ID, name), value);
+}
+
+void Shader::setVec2(const char* name, float x, float y) {
+    glUniform2f(glGetUniformLocation(ID, name), x, y);
 }
 
-void Shader::setFloat(const std::string &name, float value) {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setVec3(const char* name, float x, float y, float z) {
+    glUniform3f(glGetUniformLocation(ID, name), x, y, z);
 }
 
-void Shader::setVec2(const std::string &name, float x, float y) {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+void Shader::setIVec2(const char* name, int x, int y) {
+    glUniform2i(glGetUniformLocation(ID, name), x, y);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+void Shader::setIVec3(const char* name, int x, int y, int z) {
+    glUniform3i(glGetUniformLocation(ID, name), x, y, z);
 }
 
-void Shader::checkCompileErrors(GLuint shader, std::string type) {
+bool Shader::checkCompileErrors(GLuint shader, std::string type) {
     GLint success;
     GLchar infoLog[1024];
     if (type != "PROGRAM") {
@@ -73,4 +316,5 @@ void Shader::checkCompileErrors(GLuint shader, std::string type) {
                       << infoLog << "\n" << std::endl;
         }
     }
+    return success == GL_TRUE;
 }
@@ -1,24 +1,57 @@
 
 #pragma once
 #include <GL/glew.h>
+#include <chrono>
 #include <string>
 
 class Shader {
 public:
+    // Program binary cache totals since startup
+    struct BinaryCacheStats {
+        int programsLoaded;          // Programs restored from cached binaries
+        int programsCompiled;        // Programs built from source (cache miss or cache off)
+        int binariesRejected;        // Cached binaries the driver refused (recompiled and replaced)
+        double loadMilliseconds;     // Time spent loading cached binaries
+        double compileMilliseconds;  // Time spent building from source
+        double savedMilliseconds;    // Build time the loaded programs originally took, minus loading them
+    };
+    
+    // Directory linked programs are cached in, as driver binaries keyed by a hash of the
+    // sources and the driver's vendor, renderer and version, so later launches skip the
+    // compile. Empty (the default) turns the cache off. Needs ARB_get_program_binary.
+    static void setBinaryCacheDirectory(const std::string& directory);
+    
+    static const BinaryCacheStats& getBinaryCacheStats();
+    
     // Constructor reads and builds the shader
     Shader();
     
     // Use the shader program
     void use();
     
-    // Compile and link shaders from source strings
+    // Compile and link shaders from source strings (or load them from the binary cache);
+    // false if they didn't compile or link
     bool compile(const char* vertexSource, const char* fragmentSource);
     
-    // Utility uniform functions
-    void setInt(const std::string &name, int value);
-    void setFloat(const std::string &name, float value);
-    void setVec2(const std::string &name, float x, float y);
-    void setVec3(const std::string &name, float x, float y, float z);
+    // Start compiling and linking without waiting for the driver. The program must not be
+    // used before isCompileFinished() and finishCompile() say it's ready. A cached binary
+    // is loaded right away instead.
+    void compileAsync(const char* vertexSource, const char* fragmentSource);
+    
+    // Whether the driver is done with compileAsync, so finishCompile won't stall. Only known
+    // with ARB_parallel_shader_compile; without it this is always true.
+    bool isCompileFinished() const;
+    
+    // Report errors of a compileAsync and release its shader objects; false if it didn't link
+    bool finishCompile();
+    
+    // Utility uniform functions (names are C strings so setting a uniform never allocates)
+    void setInt(const char* name, int value);
+    void setFloat(const char* name, float value);
+    void setVec2(const char* name, float x, float y);
+    void setVec3(const char* name, float x, float y, float z);
+    void setIVec2(const char* name, int x, int y);
+    void setIVec3(const char* name, int x, int y, int z);
     
     // Get the shader program ID
     GLuint getID() const { return ID; }
@@ -30,6 +63,30 @@ private:
     // Program ID
     GLuint ID;
     
-    // Utility function for checking shader compilation/linking errors
-    void checkCompileErrors(GLuint shader, std::string type);
+    // Shader objects of a compileAsync until finishCompile
+    GLuint pendingVertex, pendingFragment;
+    
+    // Cache file the program is saved to once built from source (empty if not cached) and
+    // when the build started
+    std::string pendingCachePath;
+    std::chrono::steady_clock::time_point compileStart;
+    
+    static std::string binaryCacheDirectory;
+    static BinaryCacheStats binaryCacheStats;
+    
+    // Cache file for these sources on the current driver; empty if the cache is off or unsupported
+    static std::string binaryCachePath(const char* vertexSource, const char* fragmentSource);
+    
+    // Load the program from a cache file; false (deleting the file if the driver refuses it)
+    // if it has to be built from source
+    bool loadBinary(const std::string& path);
+    
+    // Write the linked program to pendingCachePath, recording how long it took to build
+    void saveBinary(double compileMilliseconds);
+    
+    // Link the attached shaders, asking the driver to keep the binary if it will be cached
+    void linkProgram();
+    
+    // Utility function for checking shader compilation/linking errors; false on errors
+    bool checkCompileErrors(GLuint shader, std::string type);
 };
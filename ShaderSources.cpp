@@ -18,33 +18,117 @@ void main() {
 // Fragment Shader: Renders merged sphere and cube with lighting
 const char* fragmentShaderSource = R"(
 #version 330 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out int FragObjectID; // Object hit by this pixel's ray (-1 if none), read back for picking
 uniform vec2 u_resolution; 
 uniform float u_time;      
 uniform vec2 u_mouse;      
 uniform vec3 u_cameraPos;  
 uniform float u_isDragging;
 
-// Define maximum number of objects
-#define MAX_OBJECTS 50
-
-// Object data arrays
+// Object data: one RGBA32F texel per object in a texture buffer
+//   xyz = position, w = size of the object's 3D slice (hypersphere -> sphere radius,
+//   tesseract -> cube half side; -1000 where the slice misses it, which puts it out of
+//   reach) with the flags in its 9 low mantissa bits, which the CPU leaves clear
+//   (bits 0-7: type, 0 = hypersphere, 1 = tesseract; bit 8: selected)
 uniform int u_objectCount;
-uniform int u_objectTypes[MAX_OBJECTS];        // 0 = sphere, 1 = cube
-uniform vec3 u_objectPositions[MAX_OBJECTS];   // Object positions
-uniform int u_objectSelected[MAX_OBJECTS];     // 1 if selected, 0 if not
+uniform samplerBuffer u_objects;
+
+// Index in the scene of the object in each u_objects texel (the CPU only sends the objects
+// the frame can show, so texel i isn't object i), reported through FragObjectID
+uniform isamplerBuffer u_objectIds;
+
+// Object binning (see TileBinner): with u_useTileBins = 1 each fragment only marches the
+// objects listed for its u_binTileSize^2 pixel tile. u_tileRanges holds (first, count) of
+// every tile, row by row from the bottom left, into u_tileObjects, which lists u_objects
+// texels in ascending order.
+uniform int u_useTileBins;
+uniform int u_binTileSize;
+uniform int u_binTilesX;
+uniform isamplerBuffer u_tileRanges;
+uniform isamplerBuffer u_tileObjects;
+
+// The objects this fragment marches (set by selectTile before anything is marched)
+int g_tileFirst = 0;
+int g_tileCount = 0;
+
+// How objects are blended: 0 = every object (full), 1 = only those near the closest (pruned)
+uniform int u_blendMode;
+
+// Smooth-min blend radius
+const float BLEND_K = 0.3;
+
+// Baked distance cache (see SDFBrickCache): a grid of bricks over the scene.
+// Each brick map texel is (slot, bound): slot >= 0 points at (BRICK_VOXELS + 1)^3 samples
+// in the atlas, -1 is empty space at least bound away from any surface, -2 means the
+// exact SDF has to be used.
+uniform int u_useBrickCache;
+uniform samplerBuffer u_brickMap;
+uniform sampler3D u_brickAtlas;
+uniform vec3 u_brickGridMin;
+uniform ivec3 u_brickGridSize;
+uniform float u_brickSize;
+uniform float u_brickMargin;     // Nothing is closer than this to the outside of the grid
+uniform ivec2 u_brickAtlasSlots; // Slots per atlas row and per layer
+
+#define BRICK_VOXELS 8
+#define BAKED_MAX_STEPS 192
+
+// Cone pre-pass: with u_conePass = 1 each fragment is a tile of u_coneTileSize^2 pixels
+// (of u_resolution) and outputs the distance up to which no ray of the tile hits anything.
+// With u_useConeDepth = 1 the main pass starts its rays there.
+uniform int u_conePass;
+uniform int u_useConeDepth;
+uniform int u_coneTileSize;
+uniform sampler2D u_coneDepth;
+
+// Debug view: 0 = shaded, 1 = raymarch steps per pixel as a heatmap
+uniform int u_debugView;
+
+// Most objects the pruned blend keeps around the closest one
+#define MAX_BLEND_CANDIDATES 8
+
+int objectFlags(vec4 data) {
+    return int(floatBitsToUint(data.w) & 511u);
+}
+
+float objectSliceSize(vec4 data) {
+    return uintBitsToFloat(floatBitsToUint(data.w) & ~511u);
+}
+
+int getObjectType(int objIndex) {
+    return objectFlags(texelFetch(u_objects, objIndex)) & 255;
+}
 
-// SDF for a sphere: distance to a sphere of radius 0.5
-float sdfSphere(vec3 p) {
-    return length(p) - 0.5;
+bool isObjectSelected(int objIndex) {
+    return ((objectFlags(texelFetch(u_objects, objIndex)) >> 8) & 1) == 1;
 }
 
-// SDF for a cube: distance to a cube with side length 1.0
-float sdfCube(vec3 p) {
-    vec3 d = abs(p) - vec3(0.5); // Half-size of cube is 0.5
+// Scene index of the object in a u_objects texel (-1 stays -1)
+int sceneObjectId(int objIndex) {
+    return objIndex >= 0 ? texelFetch(u_objectIds, objIndex).r : -1;
+}
+
+// SDF for a sphere: distance to a sphere of the given radius
+float sdfSphere(vec3 p, float radius) {
+    return length(p) - radius;
+}
+
+// SDF for a cube: distance to a cube of the given half side
+float sdfCube(vec3 p, float halfSize) {
+    vec3 d = abs(p) - vec3(halfSize);
     return length(max(d, 0.0)) + min(max(d.x, max(d.y, d.z)), 0.0);
 }
 
+// Distance to the slice of the hypersphere or tesseract in an object texel
+float sdfSphereObject(vec3 p, vec4 data) {
+    return sdfSphere(p - data.xyz, objectSliceSize(data));
+}
+
+float sdfCubeObject(vec3 p, vec4 data) {
+    return sdfCube(p - data.xyz, objectSliceSize(data));
+}
+
 // Smooth minimum: blends two distances smoothly
 float smoothMin(float a, float b, float k) {
     float h = max(k - abs(a - b), 0.0) / k;
@@ -65,114 +149,361 @@ vec2 smoothMinWeight(float a, float b, float k) {
 
 // Object-specific SDFs with world position
 float sdfObject(vec3 p, int objIndex) {
-    // Get object data
-    int type = u_objectTypes[objIndex];
-    vec3 position = u_objectPositions[objIndex];
+    // Get object data (one fetch for position, slice size and type)
+    vec4 data = texelFetch(u_objects, objIndex);
+    int type = objectFlags(data) & 255;
     
     // Calculate distance based on object type
     if (type == 0) {
-        // Sphere
-        return sdfSphere(p - position);
+        // Hypersphere
+        return sdfSphereObject(p, data);
     } else if (type == 1) {
-        // Cube
-        return sdfCube(p - position);
+        // Tesseract
+        return sdfCubeObject(p, data);
     }
     
     return 1000.0; // Default large distance for unknown types
 }
 
-// Structure to hold both distance and color information
-struct SDFResult {
-    float distance;
-    vec3 color;
-};
-
 // Get color for object based on type and selection state
 vec3 getObjectColor(int objIndex) {
-    int objType = u_objectTypes[objIndex];
-    bool isSelected = u_objectSelected[objIndex] == 1;
+    int objType = getObjectType(objIndex);
+    bool isSelected = isObjectSelected(objIndex);
     
     if (isSelected) {
         return vec3(0.2, 0.4, 0.9); // Selected objects are blue
     } else if (objType == 0) {
-        return vec3(0.8, 0.2, 0.2); // Sphere - red
+        return vec3(0.8, 0.2, 0.2); // Hypersphere - red
     } else if (objType == 1) {
-        return vec3(0.8, 0.4, 0.0); // Cube - orange
+        return vec3(0.8, 0.4, 0.0); // Tesseract - orange
     }
     return vec3(1.0); // Default white
 }
 
-// Combined SDF: finds minimum distance to any object in the scene and calculates blended color
-SDFResult sdfScene(vec3 p) {
-    float minDist = 1000.0;
-    vec3 blendedColor = vec3(0.0);
-    float totalWeight = 0.0;
+// Gradient of sdfSphere (unit length; straight up at the centre)
+vec3 sdfSphereGradient(vec3 p) {
+    float len = length(p);
+    return len > 0.0 ? p / len : vec3(0.0, 1.0, 0.0);
+}
+
+// Gradient of sdfCube: towards the nearest point of the box outside, along the
+// axis of the nearest face inside
+vec3 sdfCubeGradient(vec3 p, float halfSize) {
+    vec3 d = abs(p) - vec3(halfSize);
+    vec3 s = vec3(p.x < 0.0 ? -1.0 : 1.0, p.y < 0.0 ? -1.0 : 1.0, p.z < 0.0 ? -1.0 : 1.0);
+    float g = max(d.x, max(d.y, d.z));
+    if (g > 0.0) {
+        return s * normalize(max(d, 0.0));
+    }
+    if (d.x >= d.y && d.x >= d.z) return vec3(s.x, 0.0, 0.0);
+    if (d.y >= d.z) return vec3(0.0, s.y, 0.0);
+    return vec3(0.0, 0.0, s.z);
+}
+
+// Object-specific SDF gradient with world position
+vec3 sdfObjectGradient(vec3 p, int objIndex) {
+    vec4 data = texelFetch(u_objects, objIndex);
+    int type = objectFlags(data) & 255;
+    if (type == 0) {
+        return sdfSphereGradient(p - data.xyz);
+    } else if (type == 1) {
+        return sdfCubeGradient(p - data.xyz, objectSliceSize(data));
+    }
+    return vec3(0.0);
+}
+
+// Partial derivatives of smoothMin(a, b, k) with respect to a and b: the nearer input
+// gets 1 - h / 2 and the other h / 2, so the blended gradient is their weighted sum
+vec2 smoothMinGradientWeight(float a, float b, float k) {
+    float h = max(k - abs(a - b), 0.0) / k;
+    float m = h * 0.5;
+    return (a < b) ? vec2(1.0 - m, m) : vec2(m, 1.0 - m);
+}
+
+// Blended scene distance and the objects it comes from. Marching only needs the distance;
+// colour and normal are resolved from the two objects once, where a pixel is shaded.
+struct BlendResult {
+    float distance;
+    int objectA;        // -1 if nothing is nearer than 1000
+    int objectB;        // -1 if the distance comes from objectA alone
+    float distA;
+    float distB;
+    int nearestObject;  // Closest object (the first one on ties)
+    float nearestDist;
+};
+
+BlendResult emptyBlend() {
+    return BlendResult(1000.0, -1, -1, 1000.0, 1000.0, -1, 1000.0);
+}
+
+// Add object i to the blend. Each object is blended against the nearest of the objects
+// before it. smoothMin is monotonic in both arguments, so that partner gives the lowest
+// value of all pairs (j < i), and one pass produces the same result as comparing every pair.
+void blendObject(inout BlendResult result, int i, float dist) {
+    // Smooth blend with the nearest previous object
+    if (result.nearestObject >= 0) {
+        float smoothed = smoothMin(dist, result.nearestDist, BLEND_K);
+        if (smoothed < result.distance) {
+            result.distance = smoothed;
+            result.objectA = i;
+            result.objectB = result.nearestObject;
+            result.distA = dist;
+            result.distB = result.nearestDist;
+        }
+    }
     
-    // First pass: calculate distances for each object
-    float objectDists[MAX_OBJECTS];
-    for (int i = 0; i < u_objectCount && i < MAX_OBJECTS; i++) {
-        objectDists[i] = sdfObject(p, i);
+    // Also check individual object distances
+    if (dist < result.distance) {
+        result.distance = dist;
+        result.objectA = i;
+        result.objectB = -1;
+        result.distA = dist;
     }
     
-    // Second pass: blend distances and calculate color weights
-    minDist = 1000.0;
-    for (int i = 0; i < u_objectCount && i < MAX_OBJECTS; i++) {
-        float dist = objectDists[i];
-        
-        // For each object pair, calculate smooth blending
-        for (int j = 0; j < i; j++) {
-            float smoothed = smoothMin(dist, objectDists[j], 0.3);
-            
-            // If this blend creates a new minimum, update distances
-            if (smoothed < minDist) {
-                // Calculate blend weights
-                vec2 weights = smoothMinWeight(dist, objectDists[j], 0.3);
-                
-                // Get colors for both objects including selection state
-                vec3 color_i = getObjectColor(i);
-                vec3 color_j = getObjectColor(j);
-                
-                // Blend colors based on weights
-                blendedColor = color_i * weights.x + color_j * weights.y;
-                minDist = smoothed;
+    if (dist < result.nearestDist) {
+        result.nearestDist = dist;
+        result.nearestObject = i;
+    }
+}
+
+// Pruned blending keeps the objects that can affect the blend: the nearest
+// MAX_BLEND_CANDIDATES of those within BLEND_K of the closest distance d0 (a pair can only
+// blend below d0 if both objects are that close). The candidate arrays are only indexed
+// by loop counters, never by per-pixel values, so they can stay in registers.
+struct BlendCandidates {
+    int index[MAX_BLEND_CANDIDATES];
+    float dist[MAX_BLEND_CANDIDATES];
+    float nearestDist;
+};
+
+BlendCandidates emptyCandidates() {
+    BlendCandidates candidates;
+    for (int c = 0; c < MAX_BLEND_CANDIDATES; c++) {
+        candidates.index[c] = -1;
+        candidates.dist[c] = 1e20; // Free slot
+    }
+    candidates.nearestDist = 1000.0;
+    return candidates;
+}
+
+// First pass: offer object i at plain distance dist
+void addCandidate(inout BlendCandidates candidates, int i, float dist) {
+    if (dist >= candidates.nearestDist + BLEND_K) {
+        return; // Too far from the closest object to affect the blend
+    }
+    candidates.nearestDist = min(candidates.nearestDist, dist);
+    
+    // Replace the farthest slot if this object is nearer. Free slots and candidates
+    // that fell out of range are always farther, so they are reused first.
+    int farthest = 0;
+    float farthestDist = candidates.dist[0];
+    for (int c = 1; c < MAX_BLEND_CANDIDATES; c++) {
+        if (candidates.dist[c] > farthestDist) {
+            farthest = c;
+            farthestDist = candidates.dist[c];
+        }
+    }
+    if (dist < farthestDist) {
+        for (int c = 0; c < MAX_BLEND_CANDIDATES; c++) {
+            if (c == farthest) {
+                candidates.index[c] = i;
+                candidates.dist[c] = dist;
             }
         }
-        
-        // Also check individual object distances
-        if (dist < minDist) {
-            minDist = dist;
-            
-            // Set color based on object (including selection state)
-            blendedColor = getObjectColor(i);
+    }
+}
+
+// Second pass: blend the candidates still in range exactly like sdfSceneFull
+BlendResult blendCandidates(BlendCandidates candidates) {
+    // Blending needs the candidates in index order for identical colours
+    for (int pass = 0; pass < MAX_BLEND_CANDIDATES - 1; pass++) {
+        for (int c = 0; c < MAX_BLEND_CANDIDATES - 1 - pass; c++) {
+            if (candidates.index[c] > candidates.index[c + 1]) {
+                int index = candidates.index[c];
+                candidates.index[c] = candidates.index[c + 1];
+                candidates.index[c + 1] = index;
+                float dist = candidates.dist[c];
+                candidates.dist[c] = candidates.dist[c + 1];
+                candidates.dist[c + 1] = dist;
+            }
         }
     }
     
-    // Return both distance and blended color
-    return SDFResult(minDist, blendedColor);
+    BlendResult result = emptyBlend();
+    for (int c = 0; c < MAX_BLEND_CANDIDATES; c++) {
+        if (candidates.index[c] >= 0 && candidates.dist[c] < candidates.nearestDist + BLEND_K) {
+            blendObject(result, candidates.index[c], candidates.dist[c]);
+        }
+    }
+    return result;
+}
+
+// March the objects of the tile holding fragment coordinate `pixel` from now on (every
+// object without binning)
+void selectTile(vec2 pixel) {
+    if (u_useTileBins == 1) {
+        ivec2 tile = ivec2(pixel) / u_binTileSize;
+        ivec2 range = texelFetch(u_tileRanges, tile.y * u_binTilesX + tile.x).xy;
+        g_tileFirst = range.x;
+        g_tileCount = range.y;
+    } else {
+        g_tileFirst = 0;
+        g_tileCount = u_objectCount;
+    }
+}
+
+// u_objects texel of the k-th object of the tile
+int tileObject(int k) {
+    return u_useTileBins == 1 ? texelFetch(u_tileObjects, g_tileFirst + k).r : k;
+}
+
+// @scene-loops-begin (specialised variants replace the loops up to @scene-loops-end,
+// see generateSceneShader)
+
+// Combined SDF: every object of the tile blended
+BlendResult sdfSceneFull(vec3 p) {
+    BlendResult result = emptyBlend();
+    for (int k = 0; k < g_tileCount; k++) {
+        int i = tileObject(k);
+        blendObject(result, i, sdfObject(p, i));
+    }
+    return result;
+}
+
+// Pruned SDF: same result as sdfSceneFull without blending every object
+BlendResult sdfScenePruned(vec3 p) {
+    BlendCandidates candidates = emptyCandidates();
+    for (int k = 0; k < g_tileCount; k++) {
+        int i = tileObject(k);
+        addCandidate(candidates, i, sdfObject(p, i));
+    }
+    return blendCandidates(candidates);
+}
+
+// @scene-loops-end
+
+// Scene SDF in the selected blend mode
+BlendResult sdfScene(vec3 p) {
+    if (u_blendMode == 1) {
+        return sdfScenePruned(p);
+    }
+    return sdfSceneFull(p);
+}
+
+// Everything needed to shade a point, from one scene evaluation
+struct SDFSample {
+    float distance;
+    vec3 normal;
+    vec3 color;
+    int objectIndex;  // Object hit at p (closest within 0.01), or -1
+};
+
+// Distance, analytic normal, blended colour and hit object at p. Replaces six sdfScene
+// calls for central differences, one for the colour and a scan for the hit object.
+SDFSample evaluateScene(vec3 p) {
+    BlendResult blend = sdfScene(p);
+    SDFSample result;
+    result.distance = blend.distance;
+    result.objectIndex = blend.nearestDist < 0.01 ? blend.nearestObject : -1;
+    result.normal = vec3(0.0, 1.0, 0.0);
+    result.color = vec3(0.0);
+    if (blend.objectA < 0) {
+        return result;
+    }
+    
+    vec3 gradient = sdfObjectGradient(p, blend.objectA);
+    result.color = getObjectColor(blend.objectA);
+    if (blend.objectB >= 0) {
+        // Blend colors (including selection state) and gradients based on weights
+        vec2 weights = smoothMinWeight(blend.distA, blend.distB, BLEND_K);
+        vec2 gradientWeights = smoothMinGradientWeight(blend.distA, blend.distB, BLEND_K);
+        result.color = result.color * weights.x + getObjectColor(blend.objectB) * weights.y;
+        gradient = gradient * gradientWeights.x + sdfObjectGradient(p, blend.objectB) * gradientWeights.y;
+    }
+    result.normal = normalize(gradient);
+    return result;
 }
 
-// Find the closest object hit (returns index, or -1 if none)
-int getHitObjectIndex(vec3 p) {
-    float minDist = 1000.0;
-    int closestIndex = -1;
+// Safe step along rd from the baked cache, or 0 if p is too close to a surface
+// and the exact SDF is needed
+float bakedStep(vec3 p, vec3 rd) {
+    vec3 local = (p - u_brickGridMin) / u_brickSize;
+    ivec3 brick = ivec3(floor(local));
+    if (any(lessThan(brick, ivec3(0))) || any(greaterThanEqual(brick, u_brickGridSize))) {
+        // Outside the grid: everything is at least the margin beyond the grid box
+        vec3 gridMax = u_brickGridMin + vec3(u_brickGridSize) * u_brickSize;
+        vec3 outside = max(max(u_brickGridMin - p, p - gridMax), 0.0);
+        return length(outside) + u_brickMargin;
+    }
     
-    for (int i = 0; i < u_objectCount && i < MAX_OBJECTS; i++) {
-        float dist = sdfObject(p, i);
-        if (dist < minDist && dist < 0.01) {
-            minDist = dist;
-            closestIndex = i;
-        }
+    vec2 entry = texelFetch(u_brickMap, brick.x + u_brickGridSize.x * (brick.y + u_brickGridSize.y * brick.z)).xy;
+    int slot = int(entry.x);
+    vec3 brickMin = u_brickGridMin + vec3(brick) * u_brickSize;
+    
+    if (slot == -1) {
+        // Empty brick: no surface inside, so it can be crossed in one step
+        vec3 exitPlane = brickMin + step(0.0, rd) * u_brickSize;
+        vec3 exitT = vec3(
+            abs(rd.x) > 1e-6 ? (exitPlane.x - p.x) / rd.x : 1e6,
+            abs(rd.y) > 1e-6 ? (exitPlane.y - p.y) / rd.y : 1e6,
+            abs(rd.z) > 1e-6 ? (exitPlane.z - p.z) / rd.z : 1e6
+        );
+        return max(entry.y, min(exitT.x, min(exitT.y, exitT.z)) + 1e-4);
     }
+    if (slot < 0) {
+        return 0.0;
+    }
+    
+    // Surface brick: trilinear sample of the baked distances
+    ivec3 slotCoord = ivec3(slot % u_brickAtlasSlots.x,
+                            (slot / u_brickAtlasSlots.x) % u_brickAtlasSlots.y,
+                            slot / (u_brickAtlasSlots.x * u_brickAtlasSlots.y));
+    vec3 voxel = clamp((p - brickMin) / u_brickSize, 0.0, 1.0) * float(BRICK_VOXELS);
+    vec3 texel = vec3(slotCoord * (BRICK_VOXELS + 1)) + voxel + 0.5;
+    float baked = texture(u_brickAtlas, texel / vec3(textureSize(u_brickAtlas, 0))).r;
     
-    return closestIndex;
+    // Interpolation can be off by up to a voxel; nearer than that, refine exactly
+    float voxelSize = u_brickSize / float(BRICK_VOXELS);
+    float bound = baked - voxelSize;
+    return bound > voxelSize ? bound : 0.0;
 }
 
-// Raymarching: traces a ray to find the scene
-float raymarch(vec3 ro, vec3 rd) {
-    float t = 0.0; // Distance along ray
+// Raymarching through the baked cache: the exact SDF is only evaluated near surfaces,
+// and at most as often as the plain raymarch would
+float raymarchBaked(vec3 ro, vec3 rd, float tStart, out int steps) {
+    float t = tStart;
+    int exactSteps = 0;
+    steps = 0;
+    for (int i = 0; i < BAKED_MAX_STEPS; i++) {
+        vec3 p = ro + rd * t;
+        float d = bakedStep(p, rd);
+        steps++;
+        if (d <= 0.0) {
+            d = sdfScene(p).distance;
+            if (d < 0.001) return t; // Hit (close enough)
+            if (++exactSteps >= 64) return -1.0;
+        }
+        t += d;
+        if (t > 20.0) return -1.0; // Too far, miss
+    }
+    return -1.0;
+}
+
+// Raymarching: traces a ray to find the scene, starting tStart along it
+float raymarch(vec3 ro, vec3 rd, float tStart, out int steps) {
+    steps = 0;
+    if (tStart > 20.0) {
+        return -1.0; // The pre-pass found nothing in reach
+    }
+    if (u_useBrickCache == 1) {
+        return raymarchBaked(ro, rd, tStart, steps);
+    }
+    
+    float t = tStart; // Distance along ray
     for (int i = 0; i < 64; i++) {
         vec3 p = ro + rd * t; // Current position
         float d = sdfScene(p).distance; // Distance to scene
+        steps++;
         if (d < 0.001) return t; // Hit (close enough)
         t += d; // Step forward
         if (t > 20.0) return -1.0; // Too far, miss
@@ -180,29 +511,36 @@ float raymarch(vec3 ro, vec3 rd) {
     return -1.0; // Missed after max steps
 }
 
-// Normal: calculates surface direction for lighting
-vec3 getNormal(vec3 p) {
-    float eps = 0.001; // Small offset
-    vec3 n = vec3(
-        sdfScene(p + vec3(eps, 0.0, 0.0)).distance - sdfScene(p - vec3(eps, 0.0, 0.0)).distance,
-        sdfScene(p + vec3(0.0, eps, 0.0)).distance - sdfScene(p - vec3(0.0, eps, 0.0)).distance,
-        sdfScene(p + vec3(0.0, 0.0, eps)).distance - sdfScene(p - vec3(0.0, 0.0, eps)).distance
-    );
-    return normalize(n); // Unit vector
+// Cone marching for the pre-pass. Every ray of the tile stays within coneSlope * t of
+// the centre ray at distance t, so the scene is at least d - coneSlope * t away from all of
+// them, and a step of that clearance / (1 + coneSlope) can't skip a surface for any of them.
+// Returns the distance the tile's rays can safely start at (beyond 20 if they all miss).
+float coneMarch(vec3 ro, vec3 rd, float coneSlope) {
+    float t = 0.0;
+    for (int i = 0; i < 64; i++) {
+        float clearance = sdfScene(ro + rd * t).distance - coneSlope * t;
+        if (clearance < 0.001 + coneSlope * t) {
+            return t; // The cone is about as wide as the gap: leave the rest to the pixels
+        }
+        t += clearance / (1.0 + coneSlope);
+        if (t > 20.0) return 1e6; // Too far, every ray of the tile misses
+    }
+    return t;
 }
 
-void main() {
-    // Convert pixel coords to [-1, 1], adjust for aspect ratio
-    vec2 uv = (gl_FragCoord.xy / u_resolution.xy) * 2.0 - 1.0;
+// Pixel coords to [-1, 1], adjusted for aspect ratio
+vec2 pixelToUV(vec2 fragCoord) {
+    vec2 uv = (fragCoord / u_resolution.xy) * 2.0 - 1.0;
     uv.x *= u_resolution.x / u_resolution.y;
+    return uv;
+}
 
+// Ray direction through uv for the mouse-controlled camera
+vec3 cameraRay(vec2 uv) {
     // Mouse-controlled camera rotation with natural (non-inverted) controls
     float horizontalAngle = -(u_mouse.x / u_resolution.x) * 2.0 * 3.14159; // Map mouse X to full rotation (negative for natural control)
     float verticalAngle = ((1.0 - u_mouse.y / u_resolution.y) - 0.5) * 3.14159 * 0.5; // Map mouse Y to limited tilt (inverted for natural control)
     
-    // Use camera position from uniform
-    vec3 ro = u_cameraPos;
-    
     // Calculate view direction based on mouse rotation
     vec3 lookDir = normalize(vec3(
         sin(horizontalAngle) * cos(verticalAngle),
@@ -215,27 +553,66 @@ void main() {
     vec3 up = normalize(cross(right, forward));
     
     // Ray direction with perspective
-    vec3 rd = normalize(forward + uv.x * right + uv.y * up);
+    return normalize(forward + uv.x * right + uv.y * up);
+}
+
+// Blue (few steps) through green to red (the 64-step limit)
+vec3 stepHeatmap(int steps) {
+    float x = clamp(float(steps) / 64.0, 0.0, 1.0);
+    return vec3(smoothstep(0.5, 1.0, x), 1.0 - abs(2.0 * x - 1.0), 1.0 - smoothstep(0.0, 0.5, x));
+}
+
+void main() {
+    // Use camera position from uniform
+    vec3 ro = u_cameraPos;
+    FragObjectID = -1;
+    
+    if (u_conePass == 1) {
+        // Pre-pass: one cone around the centre ray of this fragment's tile, wide enough
+        // to contain the rays of all its pixels (half the tile diagonal in uv units)
+        vec2 tileCenter = gl_FragCoord.xy * float(u_coneTileSize);
+        float coneSlope = float(u_coneTileSize) * 1.41421 / u_resolution.y;
+        selectTile(tileCenter);
+        FragColor = vec4(coneMarch(ro, cameraRay(pixelToUV(tileCenter)), coneSlope), 0.0, 0.0, 1.0);
+        return;
+    }
+    
+    vec2 uv = pixelToUV(gl_FragCoord.xy);
+    vec3 rd = cameraRay(uv);
+    selectTile(gl_FragCoord.xy);
     
     // Check if the center ray (cursor) is pointing at an object
     bool centerRay = abs(uv.x) < 0.01 && abs(uv.y) < 0.01;
 
+    // Start where the pre-pass found the tile's rays still clear of everything
+    float tStart = 0.0;
+    if (u_useConeDepth == 1) {
+        tStart = texelFetch(u_coneDepth, ivec2(gl_FragCoord.xy) / u_coneTileSize, 0).r;
+    }
+
     // Raymarch the scene
-    float t = raymarch(ro, rd);
+    int steps;
+    float t = raymarch(ro, rd, tStart, steps);
+    if (u_debugView == 1) {
+        // Still report the object under the ray so picking works in this view
+        if (t > 0.0) {
+            FragObjectID = sceneObjectId(evaluateScene(ro + rd * t).objectIndex);
+        }
+        FragColor = vec4(stepHeatmap(steps), 1.0);
+        return;
+    }
     if (t > 0.0) { // Hit something
         vec3 p = ro + rd * t; // Hit point
-        vec3 normal = getNormal(p); // Surface normal
         
-        // Get the blended color from our scene evaluation
-        SDFResult sceneResult = sdfScene(p);
-        vec3 baseColor = sceneResult.color;
-        
-        // Find which object was hit (for cursor hover highlighting)
-        int hitObjectIndex = getHitObjectIndex(p);
+        // Normal, blended color and the object under the ray from one scene evaluation
+        SDFSample hit = evaluateScene(p);
+        vec3 normal = hit.normal;
+        vec3 baseColor = hit.color;
+        FragObjectID = sceneObjectId(hit.objectIndex);
         
         // Only override with blue if it's the center ray (cursor hovering) but not already selected
-        if (hitObjectIndex >= 0 && hitObjectIndex < MAX_OBJECTS) {
-            bool isSelected = u_objectSelected[hitObjectIndex] == 1;
+        if (hit.objectIndex >= 0) {
+            bool isSelected = isObjectSelected(hit.objectIndex);
             if (centerRay && !isSelected) {
                 // Object under cursor (hovered) is highlighted in blue
                 baseColor = vec3(0.2, 0.4, 0.9);
@@ -260,3 +637,24 @@ void main() {
     }
 }
 )";
+
+// Profiler overlay: flat-coloured triangles given in normalized device coordinates
+const char* overlayVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec3 aColor;
+out vec3 vColor;
+void main() {
+    vColor = aColor;
+    gl_Position = vec4(aPos, 0.0, 1.0);
+}
+)";
+
+const char* overlayFragmentShaderSource = R"(
+#version 330 core
+in vec3 vColor;
+out vec4 FragColor;
+void main() {
+    FragColor = vec4(vColor, 1.0);
+}
+)";
@@ -7,6 +7,10 @@ extern const char* vertexShaderSource;
 // Fragment Shader: Renders merged sphere and cube with lighting
 extern const char* fragmentShaderSource;
 
+// Profiler overlay shaders: flat-coloured triangles in normalized device coordinates
+extern const char* overlayVertexShaderSource;
+extern const char* overlayFragmentShaderSource;
+
 // Variables for camera movement
 extern float cameraX;
 extern float cameraY;
@@ -0,0 +1,169 @@
+#include "Simulation.h"
+#include <chrono>
+#include <cmath>
+
+namespace {
+    const long long TICK_NS = 1000000000LL / Simulation::TICK_RATE;
+
+    // Ticks run back to back after a stall before the simulation gives up catching up
+    const int MAX_CATCH_UP_TICKS = 8;
+
+    long long steadyNowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+Simulation::Simulation(const SimulationState& initialState, int windowWidth)
+    : m_droppedEvents(0), m_state(initialState), m_keys(), m_windowWidth(windowWidth),
+      m_writeSlot(0), m_readSlot(1), m_middleSlot(2), m_epochNs(steadyNowNs()), m_stopping(false) {
+    // Until the first tick, every slot holds the initial state at rest
+    for (TickPair& slot : m_slots) {
+        slot.previous = m_state;
+        slot.current = m_state;
+        slot.tickTimeNs = 0;
+    }
+    m_thread = std::thread(&Simulation::threadLoop, this);
+}
+
+Simulation::~Simulation() {
+    m_stopping.store(true, std::memory_order_release);
+    m_thread.join();
+}
+
+void Simulation::pushEvent(const InputEvent& event) {
+    if (!m_events.push(event)) {
+        m_droppedEvents++;
+    }
+}
+
+void Simulation::pushKey(SimulationKey key, bool pressed) {
+    InputEvent event = {INPUT_EVENT_KEY, key, pressed, 0.0f, 0.0f};
+    pushEvent(event);
+}
+
+void Simulation::pushCursor(float x, float y) {
+    InputEvent event = {INPUT_EVENT_CURSOR, 0, false, x, y};
+    pushEvent(event);
+}
+
+void Simulation::pushMouseButton(bool pressed) {
+    InputEvent event = {INPUT_EVENT_MOUSE_BUTTON, 0, pressed, 0.0f, 0.0f};
+    pushEvent(event);
+}
+
+void Simulation::pushResize(int width, int height) {
+    InputEvent event = {INPUT_EVENT_RESIZE, 0, false, static_cast<float>(width), static_cast<float>(height)};
+    pushEvent(event);
+}
+
+unsigned long long Simulation::getDroppedEvents() const {
+    return m_droppedEvents;
+}
+
+SimulationState Simulation::getInterpolatedState() {
+    // Take the newest published tick if there is one
+    if (m_middleSlot.load(std::memory_order_relaxed) & FRESH_SLOT) {
+        m_readSlot = m_middleSlot.exchange(m_readSlot, std::memory_order_acq_rel) & ~FRESH_SLOT;
+    }
+    const TickPair& ticks = m_slots[m_readSlot];
+
+    // Draw one tick behind: the newer tick is fully shown once a tick has passed since it was due
+    float alpha = static_cast<float>(now() - ticks.tickTimeNs) / static_cast<float>(TICK_NS);
+    alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+    SimulationState state = ticks.current;
+    state.cameraPosition = glm::mix(ticks.previous.cameraPosition, ticks.current.cameraPosition, alpha);
+    state.cameraW = ticks.previous.cameraW + (ticks.current.cameraW - ticks.previous.cameraW) * alpha;
+    state.mouseX = ticks.previous.mouseX + (ticks.current.mouseX - ticks.previous.mouseX) * alpha;
+    state.mouseY = ticks.previous.mouseY + (ticks.current.mouseY - ticks.previous.mouseY) * alpha;
+    return state;
+}
+
+void Simulation::threadLoop() {
+    long long nextTick = now() + TICK_NS;
+    while (!m_stopping.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(m_epochNs + nextTick)));
+
+        // Run every tick that is due (several if the thread was held up), but after a long
+        // stall skip ahead rather than replaying it all at once
+        long long current = now();
+        for (int i = 0; i < MAX_CATCH_UP_TICKS && nextTick <= current; i++) {
+            tick(nextTick);
+            nextTick += TICK_NS;
+        }
+        if (nextTick <= current) {
+            nextTick = current + TICK_NS;
+        }
+    }
+}
+
+void Simulation::tick(long long tickTimeNs) {
+    SimulationState previous = m_state;
+
+    InputEvent event;
+    while (m_events.pop(event)) {
+        applyEvent(event);
+    }
+    step(static_cast<float>(TICK_NS) * 1e-9f);
+    m_state.tick++;
+
+    // Publish the tick pair and take back whichever slot the renderer isn't holding
+    TickPair& slot = m_slots[m_writeSlot];
+    slot.previous = previous;
+    slot.current = m_state;
+    slot.tickTimeNs = tickTimeNs;
+    m_writeSlot = m_middleSlot.exchange(m_writeSlot | FRESH_SLOT, std::memory_order_acq_rel) & ~FRESH_SLOT;
+}
+
+void Simulation::applyEvent(const InputEvent& event) {
+    switch (event.type) {
+        case INPUT_EVENT_KEY:
+            if (event.key >= 0 && event.key < SIM_KEY_COUNT) {
+                m_keys[event.key] = event.pressed;
+            }
+            break;
+        case INPUT_EVENT_CURSOR:
+            m_state.mouseX = event.x;
+            m_state.mouseY = event.y;
+            break;
+        case INPUT_EVENT_MOUSE_BUTTON:
+            m_state.mouseLeftPressed = event.pressed;
+            break;
+        case INPUT_EVENT_RESIZE:
+            m_windowWidth = static_cast<int>(event.x);
+            break;
+    }
+}
+
+void Simulation::step(float dt) {
+    if (m_windowWidth <= 0) {
+        return;
+    }
+
+    // Calculate horizontal angle - use negative for consistent control with shader
+    float horizontalAngle = -(m_state.mouseX / m_windowWidth) * 2.0f * 3.14159f;
+    float cameraSpeed = CAMERA_SPEED * dt;
+
+    // Forward/backward along the view direction, strafing perpendicular to it
+    glm::vec3 forward(std::sin(horizontalAngle), 0.0f, std::cos(horizontalAngle));
+    glm::vec3 left(std::cos(horizontalAngle), 0.0f, -std::sin(horizontalAngle));
+
+    glm::vec3 move(0.0f);
+    if (m_keys[SIM_KEY_FORWARD]) move += forward;
+    if (m_keys[SIM_KEY_BACKWARD]) move -= forward;
+    if (m_keys[SIM_KEY_LEFT]) move += left;
+    if (m_keys[SIM_KEY_RIGHT]) move -= left;
+    if (m_keys[SIM_KEY_UP]) move.y += 1.0f;
+    if (m_keys[SIM_KEY_DOWN]) move.y -= 1.0f;
+    m_state.cameraPosition += move * cameraSpeed;
+    
+    // Ana/kata move the slicing hyperplane through the 4D scene
+    if (m_keys[SIM_KEY_ANA]) m_state.cameraW += cameraSpeed;
+    if (m_keys[SIM_KEY_KATA]) m_state.cameraW -= cameraSpeed;
+}
+
+long long Simulation::now() const {
+    return steadyNowNs() - m_epochNs;
+}
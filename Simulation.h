@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <glm/glm.hpp>
+#include "SpscQueue.h"
+
+// Movement keys the simulation understands (the window layer maps its key codes onto these)
+enum SimulationKey {
+    SIM_KEY_FORWARD,
+    SIM_KEY_BACKWARD,
+    SIM_KEY_LEFT,
+    SIM_KEY_RIGHT,
+    SIM_KEY_UP,
+    SIM_KEY_DOWN,
+    SIM_KEY_ANA,   // Towards +w (the fourth dimension)
+    SIM_KEY_KATA,  // Towards -w
+    SIM_KEY_COUNT
+};
+
+enum InputEventType {
+    INPUT_EVENT_KEY,           // key, pressed
+    INPUT_EVENT_CURSOR,        // x, y in window coordinates
+    INPUT_EVENT_MOUSE_BUTTON,  // pressed (left button)
+    INPUT_EVENT_RESIZE         // x, y = window size
+};
+
+struct InputEvent {
+    InputEventType type;
+    int key;
+    bool pressed;
+    float x, y;
+};
+
+// What the renderer needs from one simulation tick
+struct SimulationState {
+    glm::vec3 cameraPosition;  // Mapped (3D) camera position
+    float cameraW;             // Camera W, where the scene is sliced
+    float mouseX, mouseY;      // Cursor, which also sets the view direction
+    bool mouseLeftPressed;
+    unsigned long long tick;   // Ticks simulated so far
+};
+
+// Camera and cursor simulation on its own thread at a fixed tick rate.
+//
+// Input callbacks push events into a lock-free single-producer queue and return; every
+// tick drains the queue and advances the camera by exactly one tick's worth of movement,
+// so speed doesn't depend on the frame rate or on vsync stalls. Each tick publishes
+// itself together with the tick before it through a triple buffer, and the renderer
+// interpolates between the two for the time it draws at (one tick behind), so movement
+// stays smooth when frames are dropped or take irregular time.
+class Simulation {
+public:
+    // Ticks per second
+    static const int TICK_RATE = 120;
+
+    // Camera speed in units per second (per held key)
+    static constexpr float CAMERA_SPEED = 2.0f;
+
+    // Starts the simulation thread from the given state
+    Simulation(const SimulationState& initialState, int windowWidth);
+
+    // Stops and joins the simulation thread
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // Producer side (one thread, normally the one polling window events). Events are
+    // dropped and counted if the queue is full.
+    void pushEvent(const InputEvent& event);
+    void pushKey(SimulationKey key, bool pressed);
+    void pushCursor(float x, float y);
+    void pushMouseButton(bool pressed);
+    void pushResize(int width, int height);
+
+    // Events dropped because the queue was full (producer thread)
+    unsigned long long getDroppedEvents() const;
+
+    // Consumer side (one thread, normally the renderer): the state one tick ago, interpolated
+    // between the two newest ticks. Never waits for the simulation thread.
+    SimulationState getInterpolatedState();
+
+private:
+    // Two consecutive ticks and when the newer one was due on the simulation clock
+    struct TickPair {
+        SimulationState previous;
+        SimulationState current;
+        long long tickTimeNs;
+    };
+
+    // Simulation thread entry point
+    void threadLoop();
+
+    // Drain the input queue, advance one tick due at tickTimeNs and publish it
+    void tick(long long tickTimeNs);
+
+    // Apply one input event to the simulated state
+    void applyEvent(const InputEvent& event);
+
+    // Move the camera for the keys held during one tick of dt seconds
+    void step(float dt);
+
+    // Nanoseconds since the simulation was created
+    long long now() const;
+
+    SpscQueue<InputEvent, 1024> m_events;
+    unsigned long long m_droppedEvents;
+
+    // Simulation thread state
+    SimulationState m_state;
+    bool m_keys[SIM_KEY_COUNT];
+    int m_windowWidth;  // Turns the cursor into a view angle
+
+    // Triple buffer of published ticks: the simulation thread fills m_slots[m_writeSlot],
+    // the renderer reads m_slots[m_readSlot], and the third slot index is swapped between
+    // them through m_middleSlot (FRESH_SLOT set when it holds a tick the renderer hasn't taken)
+    static const int FRESH_SLOT = 4;
+    TickPair m_slots[3];
+    int m_writeSlot;
+    int m_readSlot;
+    std::atomic<int> m_middleSlot;
+
+    long long m_epochNs;
+    std::atomic<bool> m_stopping;
+    std::thread m_thread;
+};
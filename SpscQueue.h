@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for one producer thread and one consumer thread.
+// Capacity must be a power of two. The head and tail indices live on separate cache
+// lines, and each side keeps a cached copy of the other's index so a push or pop only
+// touches shared memory when the cached copy says the queue looks full or empty.
+template <typename T, std::size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer: append an item; false if the queue is full
+    bool push(const T& item) {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == Capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == Capacity) {
+                return false;
+            }
+        }
+        m_items[tail & (Capacity - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: take the oldest item; false if the queue is empty
+    bool pop(T& item) {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return false;
+            }
+        }
+        item = m_items[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Consumer side
+    alignas(64) std::atomic<std::size_t> m_head;
+    std::size_t m_cachedTail;
+
+    // Producer side
+    alignas(64) std::atomic<std::size_t> m_tail;
+    std::size_t m_cachedHead;
+
+    alignas(64) T m_items[Capacity];
+};
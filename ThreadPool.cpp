@@ -0,0 +1,156 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int workerCount) : m_func(nullptr), m_context(nullptr), m_remaining(0), m_steals(0),
+    m_lastSteals(0), m_batchId(0), m_activeWorkers(0), m_stopping(false) {
+    if (workerCount <= 0) {
+        workerCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    m_workerCount = workerCount > 0 ? workerCount : 1;
+    m_slices = std::vector<WorkerSlice>(m_workerCount);
+
+    // Worker 0 is whichever thread calls parallelFor
+    for (int i = 1; i < m_workerCount; i++) {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stopping = true;
+    }
+    m_startCondition.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(int taskCount, TaskFunc func, void* context) {
+    if (taskCount <= 0) {
+        m_lastSteals = 0;
+        return;
+    }
+
+    // Hand every worker an equal contiguous slice of the task range
+    for (int i = 0; i < m_workerCount; i++) {
+        std::lock_guard<std::mutex> guard(m_slices[i].lock);
+        m_slices[i].begin.store(static_cast<int>(static_cast<long long>(taskCount) * i / m_workerCount));
+        m_slices[i].end.store(static_cast<int>(static_cast<long long>(taskCount) * (i + 1) / m_workerCount));
+    }
+
+    m_func = func;
+    m_context = context;
+    m_remaining.store(taskCount);
+    m_steals.store(0);
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_activeWorkers = m_workerCount - 1;
+        m_batchId++;
+    }
+    m_startCondition.notify_all();
+
+    runTasks(0);
+
+    // Wait until the other workers have left runTasks, so the slices can be reused
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_activeWorkers == 0; });
+    m_lastSteals = m_steals.load();
+}
+
+int ThreadPool::getWorkerCount() const {
+    return m_workerCount;
+}
+
+int ThreadPool::getLastStealCount() const {
+    return m_lastSteals;
+}
+
+void ThreadPool::workerLoop(int workerIndex) {
+    unsigned long long seenBatch = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_startCondition.wait(lock, [&] { return m_stopping || m_batchId != seenBatch; });
+            if (m_stopping) return;
+            seenBatch = m_batchId;
+        }
+
+        runTasks(workerIndex);
+
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_activeWorkers--;
+        }
+        m_doneCondition.notify_all();
+    }
+}
+
+void ThreadPool::runTasks(int workerIndex) {
+    while (m_remaining.load(std::memory_order_acquire) > 0) {
+        int task = popLocal(workerIndex);
+        if (task < 0) {
+            // Own slice is empty, try to take work from someone else
+            if (!steal(workerIndex)) {
+                // Nothing left to steal: the remaining tasks are already running elsewhere
+                return;
+            }
+            continue;
+        }
+
+        m_func(m_context, task, workerIndex);
+        m_remaining.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+int ThreadPool::popLocal(int workerIndex) {
+    WorkerSlice& slice = m_slices[workerIndex];
+    std::lock_guard<std::mutex> guard(slice.lock);
+    int task = slice.begin.load();
+    if (task >= slice.end.load()) {
+        return -1;
+    }
+    slice.begin.store(task + 1);
+    return task;
+}
+
+bool ThreadPool::steal(int workerIndex) {
+    // Pick the victim with the most work left (sizes are read without locks, it's only a hint)
+    int victim = -1;
+    int victimSize = 0;
+    for (int i = 0; i < m_workerCount; i++) {
+        if (i == workerIndex) continue;
+        int size = m_slices[i].end.load(std::memory_order_relaxed) - m_slices[i].begin.load(std::memory_order_relaxed);
+        if (size > victimSize) {
+            victimSize = size;
+            victim = i;
+        }
+    }
+    if (victim < 0) {
+        return false;
+    }
+
+    int stolenBegin, stolenEnd;
+    {
+        WorkerSlice& slice = m_slices[victim];
+        std::lock_guard<std::mutex> guard(slice.lock);
+        int size = slice.end.load() - slice.begin.load();
+        if (size <= 0) {
+            return true; // Lost the race, look for another victim
+        }
+        // Take the back half, rounding up so a single task can still be stolen
+        int take = (size + 1) / 2;
+        stolenEnd = slice.end.load();
+        stolenBegin = stolenEnd - take;
+        slice.end.store(stolenBegin);
+    }
+
+    {
+        WorkerSlice& own = m_slices[workerIndex];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.begin.store(stolenBegin);
+        own.end.store(stolenEnd);
+    }
+    m_steals.fetch_add(stolenEnd - stolenBegin, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads that runs batches of indexed tasks with work stealing.
+// Each worker starts with a contiguous slice of the task range and takes tasks from the
+// front of it; a worker that runs dry steals the back half of the busiest slice.
+// Submitting a batch does not allocate, so it is safe to use once per frame.
+class ThreadPool {
+public:
+    // Task callback: context pointer, task index, index of the worker running it
+    typedef void (*TaskFunc)(void* context, int taskIndex, int workerIndex);
+
+    // Create the pool (0 = one worker per hardware thread, the calling thread counts as one)
+    explicit ThreadPool(int workerCount = 0);
+
+    // Stops and joins all worker threads
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Run tasks [0, taskCount) across all workers and block until they have finished.
+    // The calling thread participates as worker 0.
+    void parallelFor(int taskCount, TaskFunc func, void* context);
+
+    // Number of workers including the calling thread
+    int getWorkerCount() const;
+
+    // Number of tasks taken from another worker's slice during the last batch
+    int getLastStealCount() const;
+
+private:
+    // Task range owned by one worker, padded so workers don't share cache lines
+    struct alignas(64) WorkerSlice {
+        std::mutex lock;
+        std::atomic<int> begin{0}; // Written under lock, read without it as a hint when stealing
+        std::atomic<int> end{0};
+    };
+
+    // Worker thread entry point
+    void workerLoop(int workerIndex);
+
+    // Run tasks for one worker until no slice has work left
+    void runTasks(int workerIndex);
+
+    // Take the next task from this worker's own slice (-1 if empty)
+    int popLocal(int workerIndex);
+
+    // Move the back half of the largest other slice into this worker's slice
+    bool steal(int workerIndex);
+
+    int m_workerCount;
+    std::vector<std::thread> m_threads;
+    std::vector<WorkerSlice> m_slices;
+
+    // Current batch
+    TaskFunc m_func;
+    void* m_context;
+    std::atomic<int> m_remaining;
+    std::atomic<int> m_steals;
+    int m_lastSteals;
+
+    // Batch start/finish signalling
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+    unsigned long long m_batchId;
+    int m_activeWorkers;
+    bool m_stopping;
+};
@@ -0,0 +1,107 @@
+#include "TileBinner.h"
+#include <algorithm>
+
+TileBinner::TileBinner() : m_stats() {
+}
+
+bool TileBinner::tileSpan(float across, float depth, float radius, float extent, int pixels, int tiles,
+                          int& first, int& last) {
+    if (depth <= radius) {
+        return false;
+    }
+    // Tangents from the camera to the sphere's circle in the plane of this axis and forward:
+    // the uv u where (across - u * depth)^2 = radius^2 * (1 + u^2), then fragment coordinates
+    float denominator = depth * depth - radius * radius;
+    float spread = radius * std::sqrt(across * across + denominator);
+    float scale = 0.5f * pixels / (extent * denominator);
+    float low = (across * depth - spread) * scale + 0.5f * pixels;
+    float high = (across * depth + spread) * scale + 0.5f * pixels;
+    if (high < 0.0f || low > static_cast<float>(pixels)) {
+        first = 1;
+        last = 0;
+        return true;
+    }
+    first = std::max(static_cast<int>(std::floor(low)) / SDF_BIN_TILE_SIZE, 0);
+    last = std::min(static_cast<int>(high) / SDF_BIN_TILE_SIZE, tiles - 1);
+    return true;
+}
+
+void TileBinner::bin(const ObjectManager& objects, const std::vector<int>& list, int listCount,
+                     const glm::vec3& cameraPosition, const ViewBasis& basis, int width, int height, FrameArena& arena) {
+    int tilesX = (width + SDF_BIN_TILE_SIZE - 1) / SDF_BIN_TILE_SIZE;
+    int tilesY = (height + SDF_BIN_TILE_SIZE - 1) / SDF_BIN_TILE_SIZE;
+    int tileCount = tilesX * tilesY;
+    float aspect = static_cast<float>(width) / static_cast<float>(height);
+    const int* types = objects.getTypesArray();
+    const float* px = objects.getProjectedXArray();
+    const float* py = objects.getProjectedYArray();
+    const float* pz = objects.getProjectedZArray();
+    const float* sizes = objects.getSliceSizeArray();
+    const float margin = SDF_BLEND_K + SDF_HIT_EPSILON;
+
+    // Tile rectangle (x0, x1, y0, y1) of every object, counting the objects of each tile
+    int* rects = arena.allocate<int>(static_cast<size_t>(listCount) * 4);
+    int* counts = arena.allocate<int>(tileCount);
+    std::fill(counts, counts + tileCount, 0);
+    for (int k = 0; k < listCount; k++) {
+        int i = list[k];
+        int* rect = &rects[static_cast<size_t>(k) * 4];
+        float bound = sliceBoundingRadius(types[i], sizes[i]);
+        glm::vec3 offset(px[i] - cameraPosition.x, py[i] - cameraPosition.y, pz[i] - cameraPosition.z);
+        float depth = glm::dot(offset, basis.forward);
+        float radius = bound + margin;
+        if (bound < 0.0f) {
+            rect[0] = rect[2] = 1;
+            rect[1] = rect[3] = 0;
+        } else if (!tileSpan(glm::dot(offset, basis.right), depth, radius, aspect, width, tilesX, rect[0], rect[1]) ||
+                   !tileSpan(glm::dot(offset, basis.up), depth, radius, 1.0f, height, tilesY, rect[2], rect[3])) {
+            rect[0] = rect[2] = 0;
+            rect[1] = tilesX - 1;
+            rect[3] = tilesY - 1;
+        }
+        for (int y = rect[2]; y <= rect[3]; y++) {
+            for (int x = rect[0]; x <= rect[1]; x++) {
+                counts[y * tilesX + x]++;
+            }
+        }
+    }
+
+    // Tile ranges from the counts, then the lists filled in object order (so ascending)
+    m_ranges.resize(static_cast<size_t>(tileCount) * 2);
+    int entries = 0;
+    int maxTileObjects = 0;
+    for (int tile = 0; tile < tileCount; tile++) {
+        m_ranges[tile * 2] = entries;
+        m_ranges[tile * 2 + 1] = 0;
+        entries += counts[tile];
+        maxTileObjects = std::max(maxTileObjects, counts[tile]);
+    }
+    m_tileObjects.resize(entries);
+    for (int k = 0; k < listCount; k++) {
+        const int* rect = &rects[static_cast<size_t>(k) * 4];
+        for (int y = rect[2]; y <= rect[3]; y++) {
+            for (int x = rect[0]; x <= rect[1]; x++) {
+                int* range = &m_ranges[(y * tilesX + x) * 2];
+                m_tileObjects[range[0] + range[1]++] = k;
+            }
+        }
+    }
+
+    m_stats.tilesX = tilesX;
+    m_stats.tilesY = tilesY;
+    m_stats.objects = listCount;
+    m_stats.entries = entries;
+    m_stats.maxTileObjects = maxTileObjects;
+}
+
+const std::vector<int>& TileBinner::getTileRanges() const {
+    return m_ranges;
+}
+
+const std::vector<int>& TileBinner::getTileObjects() const {
+    return m_tileObjects;
+}
+
+const TileBinStats& TileBinner::getStats() const {
+    return m_stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameArena.h"
+#include "ObjectManager.h"
+#include "SDFMath.h"
+
+// Size of the last binning
+struct TileBinStats {
+    int tilesX, tilesY;
+    int objects;          // Objects binned
+    int entries;          // Object references over all tiles
+    int maxTileObjects;   // Objects in the fullest tile
+};
+
+// Per-tile object lists for the shader: the frame is split into SDF_BIN_TILE_SIZE^2 pixel
+// tiles, and each tile lists the objects whose bounding sphere, grown by the smooth-min
+// blend radius (and the hit epsilon), overlaps the rays of its pixels. No ray of a tile
+// comes that close to an object it doesn't list, so marching only the listed objects finds
+// the same hits and blends, and the per-pixel cost follows the local density instead of
+// the scene size. Objects that reach behind the camera are listed in every tile.
+//
+// Objects are given as a list (the texels the shader sees, in order); tile lists hold
+// positions in that list, in ascending order, so the shader blends them in the same order
+// as the full list. The rays are the ones of the shader's cameraRay for a frame of
+// width x height pixels.
+class TileBinner {
+public:
+    TileBinner();
+
+    // Bin the objects list[0 .. listCount) for a camera, with scratch space from `arena`
+    void bin(const ObjectManager& objects, const std::vector<int>& list, int listCount,
+             const glm::vec3& cameraPosition, const ViewBasis& basis, int width, int height, FrameArena& arena);
+
+    // (first, count) of every tile, row by row from the bottom left, into getTileObjects
+    const std::vector<int>& getTileRanges() const;
+    const std::vector<int>& getTileObjects() const;
+    const TileBinStats& getStats() const;
+
+private:
+    // Range of tiles [first, last] along one axis covered by a sphere at `across` sideways
+    // and `depth` ahead of the camera; `extent` is the uv half size of the frame along the
+    // axis. Returns false if the sphere reaches behind the camera (unbounded on screen);
+    // first > last if it misses the frame.
+    static bool tileSpan(float across, float depth, float radius, float extent, int pixels, int tiles,
+                         int& first, int& last);
+
+    std::vector<int> m_ranges;
+    std::vector<int> m_tileObjects;
+    TileBinStats m_stats;
+};
@@ -0,0 +1,65 @@
+#include "ViewCuller.h"
+
+ViewCuller::ViewCuller() : m_objectCount(0) {
+}
+
+void ViewCuller::cull(const ObjectManager& objects, const glm::vec3& cameraPosition, const ViewBasis& basis, float aspect) {
+    int count = objects.getObjectCount();
+    const int* types = objects.getTypesArray();
+    const float* px = objects.getProjectedXArray();
+    const float* py = objects.getProjectedYArray();
+    const float* pz = objects.getProjectedZArray();
+    const float* sizes = objects.getSliceSizeArray();
+
+    // Unit outward normals of the four side planes through the camera; an object is outside
+    // a plane when it's more than its radius beyond it (the near plane faces back along forward)
+    glm::vec3 rightPlane = (basis.right - aspect * basis.forward) / std::sqrt(1.0f + aspect * aspect);
+    glm::vec3 leftPlane = (-basis.right - aspect * basis.forward) / std::sqrt(1.0f + aspect * aspect);
+    glm::vec3 topPlane = (basis.up - basis.forward) / std::sqrt(2.0f);
+    glm::vec3 bottomPlane = (-basis.up - basis.forward) / std::sqrt(2.0f);
+    const float margin = SDF_BLEND_K + SDF_HIT_EPSILON;
+
+    // Branchless compaction: every index is written, and only visible ones are kept
+    m_visible.resize(count);
+    int* visible = m_visible.data();
+    int visibleCount = 0;
+    for (int i = 0; i < count; i++) {
+        float bound = sliceBoundingRadius(types[i], sizes[i]);
+        float radius = bound + margin;
+        glm::vec3 offset(px[i] - cameraPosition.x, py[i] - cameraPosition.y, pz[i] - cameraPosition.z);
+        float reach = SDF_FAR_PLANE + radius;
+        bool inside = bound >= 0.0f && glm::dot(offset, offset) <= reach * reach &&
+                      glm::dot(offset, basis.forward) >= -radius &&
+                      glm::dot(offset, rightPlane) <= radius && glm::dot(offset, leftPlane) <= radius &&
+                      glm::dot(offset, topPlane) <= radius && glm::dot(offset, bottomPlane) <= radius;
+        visible[visibleCount] = i;
+        visibleCount += inside ? 1 : 0;
+    }
+    m_visible.resize(visibleCount);
+    m_objectCount = count;
+}
+
+void ViewCuller::selectAll(const ObjectManager& objects) {
+    int count = objects.getObjectCount();
+    m_visible.resize(count);
+    for (int i = 0; i < count; i++) {
+        m_visible[i] = i;
+    }
+    m_objectCount = count;
+}
+
+const std::vector<int>& ViewCuller::getVisibleObjects() const {
+    return m_visible;
+}
+
+int ViewCuller::getVisibleCount() const {
+    return static_cast<int>(m_visible.size());
+}
+
+int ViewCuller::getCulledCount() const {
+    return m_objectCount - static_cast<int>(m_visible.size());
+}
+
+float ViewCuller::getCulledFraction() const {
+    return m_objectCount > 0 ? static_cast<float>(getCulledCount()) / m_objectCount : 0.0f;
+}
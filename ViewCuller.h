@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SDFMath.h"
+
+// Objects that can show up in a frame: those whose 3D slice, grown by the smooth-min
+// blend radius (and the hit epsilon), reaches into the view frustum within the far plane.
+// Everything else is too far from every ray the shader marches to be hit, blend with
+// what is hit, or shorten a step, so leaving it out doesn't change the image. Objects
+// whose slice misses them (SDF_EMPTY_SLICE) are always left out.
+//
+// The frustum is the one of the shader's cameraRay: rays forward + u * right + v * up for
+// |u| <= aspect and |v| <= 1, from the camera out to SDF_FAR_PLANE.
+class ViewCuller {
+public:
+    ViewCuller();
+
+    // Collect the visible objects, in ascending index order, from their projected positions
+    // and slice sizes
+    void cull(const ObjectManager& objects, const glm::vec3& cameraPosition, const ViewBasis& basis, float aspect);
+
+    // Take every object as visible (for draws that need the whole scene)
+    void selectAll(const ObjectManager& objects);
+
+    // Objects found by the last cull or selectAll, in ascending order
+    const std::vector<int>& getVisibleObjects() const;
+    int getVisibleCount() const;
+
+    // Objects the last cull left out, and their share of the scene (0 for an empty scene)
+    int getCulledCount() const;
+    float getCulledFraction() const;
+
+private:
+    std::vector<int> m_visible;
+    int m_objectCount;  // Scene size at the last cull
+};
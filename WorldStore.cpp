@@ -0,0 +1,500 @@
+#include "WorldStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <climits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SDFMath.h"
+
+namespace {
+    const char WORLD_FILE_MAGIC[4] = {'S', 'D', 'F', 'W'};
+    const uint32_t WORLD_FILE_VERSION = 1;
+
+    // Start of a world file; the cell table follows it
+    struct WorldFileHeader {
+        char magic[4];
+        uint32_t version;
+        float cellSize;
+        uint32_t cellCount;
+    };
+
+    // A cell's block holds objectCount types, then as many x, y, z and w values
+    struct WorldCellEntry {
+        int32_t x, y, z;
+        uint32_t objectCount;
+        uint64_t offset;
+    };
+
+    // Bytes of one object in a cell's block
+    const uint64_t WORLD_OBJECT_BYTES = sizeof(int32_t) + 4 * sizeof(float);
+
+    // Grid coordinates are kept to 21 bits each so a cell packs into 64 bits
+    const int GRID_LIMIT = (1 << 20) - 1;
+
+    int gridCoordinate(float value, float cellSize) {
+        float cell = std::floor(value / cellSize);
+        if (!(cell > -GRID_LIMIT)) return -GRID_LIMIT;  // Also catches NaN
+        if (cell > GRID_LIMIT) return GRID_LIMIT;
+        return static_cast<int>(cell);
+    }
+
+    uint64_t cellKey(int x, int y, int z) {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (static_cast<uint64_t>(x) & mask) | (static_cast<uint64_t>(y) & mask) << 21 |
+               (static_cast<uint64_t>(z) & mask) << 42;
+    }
+
+    bool readFully(int fd, void* data, size_t bytes, uint64_t offset) {
+        char* bytesLeft = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t read = pread(fd, bytesLeft, bytes, static_cast<off_t>(offset));
+            if (read <= 0) {
+                return false;
+            }
+            bytesLeft += read;
+            bytes -= read;
+            offset += read;
+        }
+        return true;
+    }
+}
+
+WorldStore::WorldStore()
+    : m_fd(-1), m_cellSize(0.0f), m_memoryBudget(DEFAULT_MEMORY_BUDGET), m_loadRadius(SDF_FAR_PLANE + SDF_PRIMITIVE_SIZE),
+      m_frame(0), m_stopping(false) {
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+WorldStore::~WorldStore() {
+    close();
+}
+
+bool WorldStore::build(const SceneFile& scene, const std::string& path, float cellSize) {
+    if (!scene.isOpen() || !(cellSize > 0.0f)) {
+        return false;
+    }
+    if (!isLittleEndian()) {
+        std::cerr << "World files can only be written on little-endian hosts" << std::endl;
+        return false;
+    }
+
+    // Objects in cell order (scene order within a cell)
+    int count = scene.getObjectCount();
+    const float* arrays[4] = {scene.getXArray(), scene.getYArray(), scene.getZArray(), scene.getWArray()};
+    std::vector<uint64_t> keys(count);
+    for (int i = 0; i < count; i++) {
+        keys[i] = cellKey(gridCoordinate(arrays[0][i], cellSize), gridCoordinate(arrays[1][i], cellSize),
+                          gridCoordinate(arrays[2][i], cellSize));
+    }
+    std::vector<int> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+    std::vector<WorldCellEntry> cells;
+    for (int begin = 0; begin < count;) {
+        int end = begin;
+        while (end < count && keys[order[end]] == keys[order[begin]]) {
+            end++;
+        }
+        int first = order[begin];
+        WorldCellEntry cell;
+        cell.x = gridCoordinate(arrays[0][first], cellSize);
+        cell.y = gridCoordinate(arrays[1][first], cellSize);
+        cell.z = gridCoordinate(arrays[2][first], cellSize);
+        cell.objectCount = static_cast<uint32_t>(end - begin);
+        cell.offset = 0;
+        cells.push_back(cell);
+        begin = end;
+    }
+
+    // Header and cell table, then the blocks in table order. Written under a temporary name
+    // so a world is only ever opened complete.
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    WorldFileHeader header;
+    std::memcpy(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic));
+    header.version = WORLD_FILE_VERSION;
+    header.cellSize = cellSize;
+    header.cellCount = static_cast<uint32_t>(cells.size());
+    uint64_t offset = sizeof(header) + cells.size() * sizeof(WorldCellEntry);
+    for (WorldCellEntry& cell : cells) {
+        cell.offset = offset;
+        offset += uint64_t(cell.objectCount) * WORLD_OBJECT_BYTES;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(cells.data()), cells.size() * sizeof(WorldCellEntry));
+
+    std::vector<int32_t> types;
+    std::vector<float> block;
+    for (size_t begin = 0, c = 0; c < cells.size(); begin += cells[c].objectCount, c++) {
+        size_t cellCount = cells[c].objectCount;
+        types.resize(cellCount);
+        block.resize(cellCount);
+        for (size_t k = 0; k < cellCount; k++) {
+            types[k] = scene.getTypesArray()[order[begin + k]];
+        }
+        out.write(reinterpret_cast<const char*>(types.data()), cellCount * sizeof(int32_t));
+        for (const float* values : arrays) {
+            for (size_t k = 0; k < cellCount; k++) {
+                block[k] = values[order[begin + k]];
+            }
+            out.write(reinterpret_cast<const char*>(block.data()), cellCount * sizeof(float));
+        }
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write world file " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to move world file to " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool WorldStore::open(const std::string& path, int ioThreads) {
+    close();
+    if (!isLittleEndian()) {
+        std::cerr << "World files can only be read on little-endian hosts" << std::endl;
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    WorldFileHeader header;
+    if (fd < 0 || fstat(fd, &info) != 0 || !readFully(fd, &header, sizeof(header), 0) ||
+        std::memcmp(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != WORLD_FILE_VERSION || !(header.cellSize > 0.0f)) {
+        std::cerr << "No valid world file at " << path << std::endl;
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+
+    // Every block inside the file
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+    uint64_t tableEnd = sizeof(header) + uint64_t(header.cellCount) * sizeof(WorldCellEntry);
+    std::vector<WorldCellEntry> entries;
+    bool valid = tableEnd <= size;
+    if (valid) {
+        entries.resize(header.cellCount);
+        valid = readFully(fd, entries.data(), entries.size() * sizeof(WorldCellEntry), sizeof(header));
+    }
+    for (size_t i = 0; valid && i < entries.size(); i++) {
+        valid = entries[i].objectCount <= static_cast<uint32_t>(INT_MAX) && entries[i].offset >= tableEnd &&
+                entries[i].offset <= size && uint64_t(entries[i].objectCount) * WORLD_OBJECT_BYTES <= size - entries[i].offset;
+    }
+    if (!valid) {
+        std::cerr << "World file " << path << " is truncated or corrupt" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    m_path = path;
+    m_fd = fd;
+    m_cellSize = header.cellSize;
+    m_cells.reserve(entries.size());
+    for (const WorldCellEntry& entry : entries) {
+        Cell cell;
+        cell.x = entry.x;
+        cell.y = entry.y;
+        cell.z = entry.z;
+        cell.objectCount = static_cast<int>(entry.objectCount);
+        cell.offset = entry.offset;
+        cell.state = CELL_ON_DISK;
+        cell.firstObject = -1;
+        cell.lastWanted = 0;
+        cell.distance = 0.0f;
+        m_cellIndex[cellKey(cell.x, cell.y, cell.z)] = static_cast<int>(m_cells.size());
+        m_cells.push_back(cell);
+    }
+    std::memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.cellCount = static_cast<int>(m_cells.size());
+
+    m_stopping = false;
+    for (int i = 0; i < std::max(ioThreads, 1); i++) {
+        m_threads.emplace_back(&WorldStore::ioLoop, this);
+    }
+    return true;
+}
+
+void WorldStore::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    m_requests.clear();
+    m_finished.clear();
+    m_cells.clear();
+    m_cellIndex.clear();
+    m_resident.clear();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_path.clear();
+    m_cellSize = 0.0f;
+    m_frame = 0;
+    std::memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool WorldStore::isOpen() const {
+    return m_cellSize > 0.0f;
+}
+
+void WorldStore::setMemoryBudget(size_t bytes) {
+    m_memoryBudget = bytes;
+}
+
+size_t WorldStore::getMemoryBudget() const {
+    return m_memoryBudget;
+}
+
+void WorldStore::setLoadRadius(float radius) {
+    m_loadRadius = std::max(radius, 0.0f);
+}
+
+float WorldStore::getLoadRadius() const {
+    return m_loadRadius;
+}
+
+float WorldStore::getCellSize() const {
+    return m_cellSize;
+}
+
+const WorldStats& WorldStore::getStats() const {
+    return m_stats;
+}
+
+bool WorldStore::update(const glm::vec3& camera, ObjectManager& objects) {
+    if (!isOpen()) {
+        return false;
+    }
+    m_frame++;
+    bool evicted = false;
+    findWantedCells(camera);
+
+    // Move finished loads in. Wanted cells may push out cells that aren't; a cell that's
+    // no longer wanted only goes in if there's room anyway.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_taken.swap(m_finished);
+    }
+    std::sort(m_taken.begin(), m_taken.end(),
+              [this](const FinishedLoad& a, const FinishedLoad& b) { return nearer(a.cell, b.cell); });
+    int movedIn = 0;
+    size_t taken = 0;
+    for (; taken < m_taken.size() && movedIn < MAX_OBJECTS_PER_UPDATE; taken++) {
+        FinishedLoad& load = m_taken[taken];
+        Cell& cell = m_cells[load.cell];
+        m_stats.loadingCells--;
+        if (!load.data) {
+            cell.state = CELL_FAILED;
+            continue;
+        }
+        if (!makeRoom(cellBytes(cell), cell.lastWanted == m_frame, objects, evicted)) {
+            cell.state = CELL_ON_DISK;
+            m_stats.loadsDropped++;
+            continue;
+        }
+        const CellData& data = *load.data;
+        cell.state = CELL_RESIDENT;
+        cell.firstObject = objects.getObjectCount();
+        objects.addObjects(data.types.data(), data.x.data(), data.y.data(), data.z.data(), data.w.data(),
+                           static_cast<int>(data.types.size()));
+        m_resident.push_back(load.cell);
+        m_stats.residentCells++;
+        m_stats.residentObjects += cell.objectCount;
+        m_stats.residentBytes += cellBytes(cell);
+        m_stats.cellsLoaded++;
+        movedIn += cell.objectCount;
+    }
+    if (taken < m_taken.size()) {
+        // The rest waits for the next frames
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished.insert(m_finished.end(), std::make_move_iterator(m_taken.begin() + taken),
+                          std::make_move_iterator(m_taken.end()));
+    }
+    m_taken.clear();
+
+    // A lowered budget can leave too much resident, wanted or not
+    makeRoom(0, true, objects, evicted);
+
+    // Queue the wanted cells that aren't in yet, nearest first, as far as the budget
+    // goes once the nearer ones are in. Queued cells the I/O threads haven't started are
+    // taken back first, so cells that are no longer wanted drop out of the queue.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int cell : m_requests) {
+            m_cells[cell].state = CELL_ON_DISK;
+        }
+        m_stats.loadingCells -= static_cast<int>(m_requests.size());
+        m_requests.clear();
+        size_t plannedBytes = 0;
+        for (int index : m_wanted) {
+            Cell& cell = m_cells[index];
+            if (cell.state == CELL_RESIDENT || cell.state == CELL_LOADING) {
+                plannedBytes += cellBytes(cell);
+            } else if (cell.state == CELL_ON_DISK) {
+                if (plannedBytes + cellBytes(cell) > m_memoryBudget) {
+                    break;
+                }
+                plannedBytes += cellBytes(cell);
+                cell.state = CELL_LOADING;
+                m_requests.push_back(index);
+                m_stats.loadingCells++;
+            }
+        }
+    }
+    m_wake.notify_all();
+    return evicted;
+}
+
+void WorldStore::findWantedCells(const glm::vec3& camera) {
+    m_wanted.clear();
+    auto consider = [this, &camera](int index) {
+        Cell& cell = m_cells[index];
+        cell.distance = cellDistance(cell, camera);
+        if (cell.distance <= m_loadRadius) {
+            cell.lastWanted = m_frame;
+            m_wanted.push_back(index);
+        }
+    };
+
+    // Look up the cells of the grid around the camera, unless that's more cells than the world has
+    int reach = static_cast<int>(std::min(std::ceil(m_loadRadius / m_cellSize), static_cast<float>(GRID_LIMIT)));
+    double gridCells = std::pow(2.0 * reach + 1.0, 3.0);
+    if (gridCells < static_cast<double>(m_cells.size())) {
+        int cx = gridCoordinate(camera.x, m_cellSize);
+        int cy = gridCoordinate(camera.y, m_cellSize);
+        int cz = gridCoordinate(camera.z, m_cellSize);
+        for (int x = cx - reach; x <= cx + reach; x++) {
+            for (int y = cy - reach; y <= cy + reach; y++) {
+                for (int z = cz - reach; z <= cz + reach; z++) {
+                    auto found = m_cellIndex.find(cellKey(x, y, z));
+                    if (found != m_cellIndex.end()) {
+                        consider(found->second);
+                    }
+                }
+            }
+        }
+    } else {
+        for (int index = 0; index < static_cast<int>(m_cells.size()); index++) {
+            consider(index);
+        }
+    }
+    std::sort(m_wanted.begin(), m_wanted.end(), [this](int a, int b) { return nearer(a, b); });
+}
+
+float WorldStore::cellDistance(const Cell& cell, const glm::vec3& camera) const {
+    glm::vec3 low = glm::vec3(static_cast<float>(cell.x), static_cast<float>(cell.y), static_cast<float>(cell.z)) * m_cellSize;
+    glm::vec3 high = low + glm::vec3(m_cellSize);
+    glm::vec3 outside = glm::max(glm::max(low - camera, camera - high), glm::vec3(0.0f));
+    return glm::length(outside);
+}
+
+void WorldStore::evict(int cellIndex, ObjectManager& objects) {
+    Cell& cell = m_cells[cellIndex];
+    objects.removeObjects(cell.firstObject, cell.objectCount);
+    auto position = std::find(m_resident.begin(), m_resident.end(), cellIndex);
+    for (auto later = position + 1; later != m_resident.end(); ++later) {
+        m_cells[*later].firstObject -= cell.objectCount;
+    }
+    m_resident.erase(position);
+
+    cell.state = CELL_ON_DISK;
+    cell.firstObject = -1;
+    m_stats.residentCells--;
+    m_stats.residentObjects -= cell.objectCount;
+    m_stats.residentBytes -= cellBytes(cell);
+    m_stats.cellsEvicted++;
+}
+
+bool WorldStore::nearer(int a, int b) const {
+    if (m_cells[a].distance != m_cells[b].distance) {
+        return m_cells[a].distance < m_cells[b].distance;
+    }
+    return a < b;
+}
+
+bool WorldStore::makeRoom(size_t bytes, bool evictWanted, ObjectManager& objects, bool& evicted) {
+    if (m_stats.residentBytes + bytes <= m_memoryBudget) {
+        return true;
+    }
+
+    // Least recently wanted first, the farthest of those first
+    m_evictionOrder.assign(m_resident.begin(), m_resident.end());
+    std::sort(m_evictionOrder.begin(), m_evictionOrder.end(), [this](int a, int b) {
+        const Cell& first = m_cells[a];
+        const Cell& second = m_cells[b];
+        if (first.lastWanted != second.lastWanted) return first.lastWanted < second.lastWanted;
+        return nearer(b, a);
+    });
+    for (int cell : m_evictionOrder) {
+        if (m_stats.residentBytes + bytes <= m_memoryBudget) {
+            break;
+        }
+        if (m_cells[cell].lastWanted == m_frame && !evictWanted) {
+            break;
+        }
+        evict(cell, objects);
+        evicted = true;
+    }
+    return m_stats.residentBytes + bytes <= m_memoryBudget;
+}
+
+size_t WorldStore::cellBytes(const Cell& cell) {
+    return static_cast<size_t>(cell.objectCount) * WORLD_BYTES_PER_OBJECT;
+}
+
+void WorldStore::ioLoop() {
+    while (true) {
+        int cell;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_requests.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            cell = m_requests.front();
+            m_requests.pop_front();
+        }
+
+        // Cells are only added or removed while no I/O thread runs, so the entry is stable
+        std::unique_ptr<CellData> data = readCell(m_cells[cell]);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished.push_back(FinishedLoad{cell, std::move(data)});
+    }
+}
+
+std::unique_ptr<WorldStore::CellData> WorldStore::readCell(const Cell& cell) const {
+    size_t count = static_cast<size_t>(cell.objectCount);
+    size_t bytes = count * sizeof(float);
+    std::unique_ptr<CellData> data(new CellData());
+    data->types.resize(count);
+    data->x.resize(count);
+    data->y.resize(count);
+    data->z.resize(count);
+    data->w.resize(count);
+    void* arrays[5] = {data->types.data(), data->x.data(), data->y.data(), data->z.data(), data->w.data()};
+    for (int array = 0; array < 5; array++) {
+        if (!readFully(m_fd, arrays[array], bytes, cell.offset + array * bytes)) {
+            std::cerr << "Failed to read a cell of " << m_path << std::endl;
+            return nullptr;
+        }
+    }
+    return data;
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ObjectManager.h"
+#include "SceneFile.h"
+
+// Memory a resident object is charged against the budget: what ObjectManager keeps for it
+// (type, 4D and projected positions, slice size, selection slot and version)
+const size_t WORLD_BYTES_PER_OBJECT = 48;
+
+// Paging activity of a WorldStore
+struct WorldStats {
+    int cellCount;                 // Cells in the world
+    int residentCells;             // Cells whose objects are in the ObjectManager
+    int loadingCells;              // Cells queued or being read
+    long long residentObjects;
+    size_t residentBytes;          // Objects charged against the budget (WORLD_BYTES_PER_OBJECT each)
+    unsigned long long cellsLoaded;
+    unsigned long long cellsEvicted;
+    unsigned long long loadsDropped;  // Finished loads thrown away (no longer wanted and no room)
+};
+
+// A world too large for memory (or the GPU), stored on disk as a grid of cells and paged
+// in around the camera.
+//
+// A world file holds the objects partitioned into cells (cellSize on a side, by the
+// objects' 4D x, y and z): a header, a table of the non-empty cells, and each cell's
+// objects as one block of scene file arrays (types, x, y, z, w), little-endian like scene
+// files. Every frame, update() wants the cells within the load radius of the camera, queues
+// the missing ones nearest first for the I/O threads, and moves finished loads into the
+// ObjectManager. Cells that are no longer wanted stay resident until the memory budget
+// needs their room, and then go least recently wanted first. The ObjectManager only ever
+// holds resident cells, so rendering and picking only see those.
+//
+// Objects of resident cells can be edited like any other; edits are lost when their cell
+// is evicted (the world on disk is read-only).
+class WorldStore {
+public:
+    // I/O threads started by open unless told otherwise
+    static const int DEFAULT_IO_THREADS = 2;
+
+    // Default memory budget (about a million resident objects)
+    static const size_t DEFAULT_MEMORY_BUDGET = size_t(48) << 20;
+
+    // Objects of finished loads moved into the ObjectManager per update (at least one cell),
+    // so a burst of loads is spread over frames instead of stalling one
+    static const int MAX_OBJECTS_PER_UPDATE = 32768;
+
+    WorldStore();
+
+    // Stops the I/O threads
+    ~WorldStore();
+
+    WorldStore(const WorldStore&) = delete;
+    WorldStore& operator=(const WorldStore&) = delete;
+
+    // Partition the objects of a scene into the cells of a new world file. Holds 12 bytes
+    // per object in memory; the objects themselves are read from the mapping.
+    static bool build(const SceneFile& scene, const std::string& path, float cellSize);
+
+    // Open a world file and start its I/O threads (closing any open world first). No cells
+    // are resident until the first update.
+    bool open(const std::string& path, int ioThreads = DEFAULT_IO_THREADS);
+
+    // Stop the I/O threads and forget the world (the ObjectManager keeps what it holds)
+    void close();
+    bool isOpen() const;
+
+    // Resident objects are kept within this many bytes (WORLD_BYTES_PER_OBJECT each); takes
+    // effect at the next update
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const;
+
+    // Cells closer than this to the camera are wanted (default: the far plane plus the
+    // primitive size, so every object a ray can reach is wanted)
+    void setLoadRadius(float radius);
+    float getLoadRadius() const;
+
+    // Once per frame on the render thread, with the camera's 4D x, y and z: page cells in
+    // and out around it and bring `objects` in line with the resident cells. Loaded cells
+    // are appended; evicted ones are removed, which moves the objects after them to lower
+    // indices. Returns true if any object's index changed that way.
+    bool update(const glm::vec3& camera, ObjectManager& objects);
+
+    float getCellSize() const;
+    const WorldStats& getStats() const;
+
+private:
+    enum CellState {
+        CELL_ON_DISK,
+        CELL_LOADING,   // Queued or being read by an I/O thread
+        CELL_RESIDENT,  // Objects [firstObject, firstObject + objectCount) of the ObjectManager
+        CELL_FAILED     // Couldn't be read; not tried again
+    };
+
+    struct Cell {
+        int x, y, z;                  // Grid coordinates
+        int objectCount;
+        uint64_t offset;              // Of the cell's block in the world file
+        CellState state;
+        int firstObject;
+        unsigned long long lastWanted; // Frame the cell was last within the load radius
+        float distance;               // From the camera at the last update
+    };
+
+    // Objects of a cell read by an I/O thread
+    struct CellData {
+        std::vector<int> types;
+        std::vector<float> x, y, z, w;
+    };
+
+    struct FinishedLoad {
+        int cell;
+        std::unique_ptr<CellData> data;  // nullptr if the read failed
+    };
+
+    // I/O thread entry point
+    void ioLoop();
+
+    // Read the objects of a cell from the world file (on an I/O thread)
+    std::unique_ptr<CellData> readCell(const Cell& cell) const;
+
+    // Collect the cells within the load radius into m_wanted, nearest first
+    void findWantedCells(const glm::vec3& camera);
+
+    // Distance from the camera to the nearest point of a cell
+    float cellDistance(const Cell& cell, const glm::vec3& camera) const;
+
+    // Whether cell a comes before cell b nearest first. Ties go by index, so loading and
+    // eviction agree on the order of cells at the same distance and don't swap them.
+    bool nearer(int a, int b) const;
+
+    // Remove a resident cell's objects from the ObjectManager
+    void evict(int cell, ObjectManager& objects);
+
+    // Evict cells, least recently wanted first, until `bytes` more fit in the budget.
+    // Cells wanted this frame are only evicted if evictWanted is set. Returns whether
+    // the bytes fit; sets `evicted` if anything was evicted.
+    bool makeRoom(size_t bytes, bool evictWanted, ObjectManager& objects, bool& evicted);
+
+    static size_t cellBytes(const Cell& cell);
+
+    std::string m_path;
+    int m_fd;                                        // World file, read with pread by the I/O threads
+    float m_cellSize;
+    std::vector<Cell> m_cells;                       // Only the states change once open
+    std::unordered_map<uint64_t, int> m_cellIndex;   // Packed grid coordinates -> index into m_cells
+    std::vector<int> m_resident;                     // Resident cells in ObjectManager order
+    size_t m_memoryBudget;
+    float m_loadRadius;
+    unsigned long long m_frame;
+    WorldStats m_stats;
+
+    // Scratch for update
+    std::vector<int> m_wanted;
+    std::vector<int> m_evictionOrder;
+    std::vector<FinishedLoad> m_taken;
+
+    // Work shared with the I/O threads
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<int> m_requests;            // Cells to read, nearest first
+    std::vector<FinishedLoad> m_finished;
+    bool m_stopping;
+    std::vector<std::thread> m_threads;
+};
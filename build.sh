@@ -1 +1,3 @@
-g++ main.cpp SDFRenderer.cpp Shader.cpp ShaderSources.cpp ObjectManager.cpp -o sdf_renderer -lglfw -lGLEW -lGL
+g++ main.cpp SDFRenderer.cpp Shader.cpp ShaderSources.cpp ObjectManager.cpp ManifoldProjection.cpp SceneFile.cpp WorldStore.cpp CPURenderer.cpp ThreadPool.cpp SDFPacket.cpp SceneBVH.cpp ViewCuller.cpp TileBinner.cpp FrameArena.cpp AllocationCounter.cpp SDFBrickCache.cpp ResolutionGovernor.cpp Profiler.cpp PickingWorker.cpp Simulation.cpp SceneShaderCache.cpp -o sdf_renderer -lglfw -lGLEW -lGL -pthread
+g++ -O2 BlendBench.cpp ObjectManager.cpp ManifoldProjection.cpp CPURenderer.cpp ThreadPool.cpp SDFPacket.cpp SceneBVH.cpp -o blend_bench -pthread
+g++ -O2 SDFBench.cpp ObjectManager.cpp ManifoldProjection.cpp SceneFile.cpp WorldStore.cpp CPURenderer.cpp ThreadPool.cpp SDFPacket.cpp SceneBVH.cpp ViewCuller.cpp TileBinner.cpp FrameArena.cpp AllocationCounter.cpp -o sdf_bench -pthread
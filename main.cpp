@@ -1,59 +1,134 @@
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <string>
 #include "SDFRenderer.h"
 #include "CoordSystem.h"
+#include "Simulation.h"
 
-// Global renderer pointer for callbacks
+// Global renderer and simulation pointers for callbacks
 SDFRenderer* g_renderer = nullptr;
+Simulation* g_simulation = nullptr;
 
-// Key state tracking (for continuous movement)
-struct {
-    bool forward = false;   // W
-    bool backward = false;  // S
-    bool left = false;      // A
-    bool right = false;     // D
-    bool up = false;        // Space
-    bool down = false;      // Shift
-    bool shift = false;     // Shift key for selection mode
-} keyState;
-
-// Mouse callback function
+// Mouse callback function (the cursor is simulated, the renderer gets it back interpolated)
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    if (g_renderer) {
-        g_renderer->setMousePosition(static_cast<float>(xpos), static_cast<float>(ypos));
+    if (g_simulation) {
+        g_simulation->pushCursor(static_cast<float>(xpos), static_cast<float>(ypos));
     }
 }
 
-// Keyboard callback function for WASD and Space/Shift movement
+// Keyboard callback function: WASD, Space/Shift and Q/E (w) movement goes to the simulation,
+// everything else toggles renderer settings directly
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (!g_renderer) return;
+    if (!g_renderer || !g_simulation) return;
 
     // Update key state based on press/release
     if (action == GLFW_PRESS || action == GLFW_RELEASE) {
         bool isPressed = (action == GLFW_PRESS);
         
-        // Set the appropriate key state flag
         switch (key) {
             case GLFW_KEY_W:
-                keyState.forward = isPressed;
+                g_simulation->pushKey(SIM_KEY_FORWARD, isPressed);
                 break;
             case GLFW_KEY_S:
-                keyState.backward = isPressed;
+                g_simulation->pushKey(SIM_KEY_BACKWARD, isPressed);
                 break;
             case GLFW_KEY_A:
-                keyState.left = isPressed;
+                g_simulation->pushKey(SIM_KEY_LEFT, isPressed);
                 break;
             case GLFW_KEY_D:
-                keyState.right = isPressed;
+                g_simulation->pushKey(SIM_KEY_RIGHT, isPressed);
                 break;
             case GLFW_KEY_SPACE:
-                keyState.up = isPressed;
+                g_simulation->pushKey(SIM_KEY_UP, isPressed);
+                break;
+            case GLFW_KEY_E:
+                g_simulation->pushKey(SIM_KEY_ANA, isPressed);
+                break;
+            case GLFW_KEY_Q:
+                g_simulation->pushKey(SIM_KEY_KATA, isPressed);
+                break;
+            case GLFW_KEY_B:
+                // Toggle the baked distance cache
+                if (isPressed) {
+                    g_renderer->setBrickCacheEnabled(!g_renderer->isBrickCacheEnabled());
+                }
+                break;
+            case GLFW_KEY_R:
+                // Toggle dynamic resolution
+                if (isPressed) {
+                    g_renderer->setDynamicResolutionEnabled(!g_renderer->isDynamicResolutionEnabled());
+                }
+                break;
+            case GLFW_KEY_C:
+                // Toggle the cone pre-pass
+                if (isPressed) {
+                    g_renderer->setConePrepassEnabled(!g_renderer->isConePrepassEnabled());
+                }
+                break;
+            case GLFW_KEY_F:
+                // Toggle frustum culling
+                if (isPressed) {
+                    g_renderer->setCullingEnabled(!g_renderer->isCullingEnabled());
+                }
+                break;
+            case GLFW_KEY_N:
+                // Toggle screen-tile object binning
+                if (isPressed) {
+                    g_renderer->setTileBinningEnabled(!g_renderer->isTileBinningEnabled());
+                }
+                break;
+            case GLFW_KEY_H:
+                // Toggle the raymarch step heatmap
+                if (isPressed) {
+                    g_renderer->setDebugView(g_renderer->getDebugView() == DEBUG_VIEW_STEPS ? DEBUG_VIEW_SHADED : DEBUG_VIEW_STEPS);
+                }
+                break;
+            case GLFW_KEY_V:
+                // Toggle the shaders specialised to the scene
+                if (isPressed) {
+                    g_renderer->setShaderSpecialisationEnabled(!g_renderer->isShaderSpecialisationEnabled());
+                }
+                break;
+            case GLFW_KEY_G:
+                // Toggle GPU (object ID buffer) picking
+                if (isPressed) {
+                    g_renderer->setGpuPickingEnabled(!g_renderer->isGpuPickingEnabled());
+                }
+                break;
+            case GLFW_KEY_P:
+                // Toggle the profiler and its frame-time overlay
+                if (isPressed) {
+                    g_renderer->setProfilingEnabled(!g_renderer->isProfilingEnabled());
+                }
+                break;
+            case GLFW_KEY_T:
+                // Dump the recorded frames as a Chrome trace
+                if (isPressed && g_renderer->isProfilingEnabled()) {
+                    if (g_renderer->getProfiler().writeChromeTrace("sdf_trace.json")) {
+                        std::cout << "Wrote profiler trace to sdf_trace.json" << std::endl;
+                    } else {
+                        std::cerr << "Failed to write sdf_trace.json" << std::endl;
+                    }
+                }
+                break;
+            case GLFW_KEY_F5:
+                // Save the scene (load it again by passing the file on the command line)
+                if (isPressed) {
+                    if (g_renderer->saveScene("scene.sdfs")) {
+                        std::cout << "Saved the scene to scene.sdfs" << std::endl;
+                    } else {
+                        std::cerr << "Failed to write scene.sdfs" << std::endl;
+                    }
+                }
                 break;
             case GLFW_KEY_LEFT_SHIFT:
             case GLFW_KEY_RIGHT_SHIFT:
-                keyState.down = isPressed;
+                g_simulation->pushKey(SIM_KEY_DOWN, isPressed);
                 // No longer need to track shift key for multi-selection
                 break;
         }
@@ -62,12 +137,12 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 // Mouse button callback function
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
-    if (g_renderer) {
+    if (g_simulation) {
         if (button == GLFW_MOUSE_BUTTON_LEFT) {
             if (action == GLFW_PRESS) {
-                g_renderer->setMouseButtonState(true);
+                g_simulation->pushMouseButton(true);
             } else if (action == GLFW_RELEASE) {
-                g_renderer->setMouseButtonState(false);
+                g_simulation->pushMouseButton(false);
             }
         }
     }
@@ -79,9 +154,34 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     if (g_renderer) {
         g_renderer->setWindowSize(width, height);
     }
+    if (g_simulation) {
+        g_simulation->pushResize(width, height);
+    }
 }
 
-int main() {
+// Usage: sdf_renderer [scene.sdfs | world.sdfw] [--require-zero-allocations N]
+//
+// --require-zero-allocations checks that steady-state calls of SDFRenderer::render make no
+// heap allocations (see getFrameAllocations). The view is driven around a loop of N frames
+// (the camera circling its start position while turning all the way round) with the
+// profiler on, so culling, binning, object uploads, picking and the overlay change every
+// frame. After warm-up loops filling the profiler history, one more loop is checked; the
+// program exits with 0 if no frame of it allocated, with 1 at the first that did.
+int main(int argc, char** argv) {
+    const char* scenePath = nullptr;
+    int allocationCheckFrames = 0;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--require-zero-allocations") == 0) {
+            allocationCheckFrames = i + 1 < argc ? std::atoi(argv[++i]) : 0;
+            if (allocationCheckFrames < 1) {
+                std::cerr << "--require-zero-allocations needs a positive frame count" << std::endl;
+                return -1;
+            }
+        } else {
+            scenePath = argv[i];
+        }
+    }
+    
     // --- Initialize GLFW ---
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -112,12 +212,33 @@ int main() {
     // Set background color
     glClearColor(0.0f, 0.0f, 0.2f, 1.0f);
     
-    // Initialize the SDF renderer
+    // Initialize the SDF renderer, reusing the shader binaries of earlier launches
+    Shader::setBinaryCacheDirectory("shader_cache");
     SDFRenderer renderer;
     if (!renderer.initialize()) {
         std::cerr << "Failed to initialize SDF renderer" << std::endl;
         return -1;
     }
+    if (scenePath && std::filesystem::path(scenePath).extension() == ".sdfw") {
+        // A world file is paged in around the camera instead of the random objects
+        if (!renderer.openWorld(scenePath)) {
+            return -1;
+        }
+        std::cout << "Paging world " << scenePath << ": " << renderer.getWorld().getStats().cellCount << " cells of "
+                  << renderer.getWorld().getCellSize() << " units" << std::endl;
+    } else if (scenePath) {
+        // A scene file replaces the random objects
+        double loadStart = glfwGetTime();
+        if (!renderer.loadScene(scenePath)) {
+            return -1;
+        }
+        std::cout << "Loaded " << renderer.getObjectManager().getObjectCount() << " objects from " << scenePath
+                  << " in " << (glfwGetTime() - loadStart) * 1000.0 << " ms" << std::endl;
+    }
+    const Shader::BinaryCacheStats& shaderCache = Shader::getBinaryCacheStats();
+    std::cout << "Shaders: " << shaderCache.programsLoaded << " loaded from cache in "
+              << shaderCache.loadMilliseconds << " ms (saved " << shaderCache.savedMilliseconds << " ms), "
+              << shaderCache.programsCompiled << " compiled in " << shaderCache.compileMilliseconds << " ms" << std::endl;
     
     // Store renderer pointer for callbacks and set initial window size and mouse position
     g_renderer = &renderer;
@@ -126,6 +247,16 @@ int main() {
     renderer.setWindowSize(window_width, window_height);
     renderer.setMousePosition(window_width / 2.0f, window_height / 2.0f);
     
+    // Start the simulation thread from the renderer's camera with the cursor centred
+    SimulationState initialState = {};
+    initialState.cameraPosition = renderer.getCameraPosition();
+    initialState.cameraW = renderer.getCameraW();
+    initialState.mouseX = window_width / 2.0f;
+    initialState.mouseY = window_height / 2.0f;
+    Simulation simulation(initialState, window_width);
+    g_simulation = &simulation;
+    bool mouseLeftPressed = false;
+    
     // Set up callbacks
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -138,75 +269,43 @@ int main() {
     // --- Main loop ---
     float time = 0.0f;  // Keep time static or use it for other effects if needed
     
-    // Variables for time-based movement
-    double lastFrameTime = glfwGetTime();
+    // Profiler summary shown in the window title, refreshed twice a second
+    double lastTitleTime = glfwGetTime();
+    bool profilerTitle = false;
+    
+    // Frames rendered for --require-zero-allocations (whole loops of warm-up first), and
+    // whether a checked one allocated
+    int checkedFrames = 0;
+    int warmupFrames = 0;
+    bool allocationCheckFailed = false;
+    if (allocationCheckFrames > 0) {
+        warmupFrames = (Profiler::FRAME_HISTORY + allocationCheckFrames - 1) / allocationCheckFrames * allocationCheckFrames;
+        renderer.setProfilingEnabled(true);
+    }
     
     while (!glfwWindowShouldClose(window)) {
-        // Calculate delta time
         double currentFrameTime = glfwGetTime();
-        float deltaTime = static_cast<float>(currentFrameTime - lastFrameTime);
-        lastFrameTime = currentFrameTime;
         
         // Process input
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
             glfwSetWindowShouldClose(window, true);
         }
         
-        // Handle continuous movement
-        if (keyState.forward || keyState.backward || keyState.left || 
-            keyState.right || keyState.up || keyState.down) {
-            
-            // Get mouse position to determine view direction
-            double xpos, ypos;
-            glfwGetCursorPos(window, &xpos, &ypos);
-            int width, height;
-            glfwGetWindowSize(window, &width, &height);
-            
-            // Calculate horizontal angle - use negative for consistent control with shader
-            float horizontalAngle = -(float)(xpos / width) * 2.0f * 3.14159f;
-            
-            // Camera speed scaled by delta time for consistent movement
-            float cameraSpeed = 2.0f * deltaTime;
-            
-            // Forward/backward movement along view direction
-            if (keyState.forward) {
-                g_renderer->moveCamera(
-                    sin(horizontalAngle) * cameraSpeed,
-                    0.0f,
-                    cos(horizontalAngle) * cameraSpeed
-                );
-            }
-            if (keyState.backward) {
-                g_renderer->moveCamera(
-                    -sin(horizontalAngle) * cameraSpeed,
-                    0.0f,
-                    -cos(horizontalAngle) * cameraSpeed
-                );
-            }
-            
-            // Strafe left/right (perpendicular to view direction)
-            if (keyState.left) {
-                g_renderer->moveCamera(
-                    cos(horizontalAngle) * cameraSpeed,
-                    0.0f,
-                    -sin(horizontalAngle) * cameraSpeed
-                );
-            }
-            if (keyState.right) {
-                g_renderer->moveCamera(
-                    -cos(horizontalAngle) * cameraSpeed,
-                    0.0f,
-                    sin(horizontalAngle) * cameraSpeed
-                );
-            }
-            
-            // Up/down movement
-            if (keyState.up) {
-                g_renderer->moveCamera(0.0f, cameraSpeed, 0.0f);
-            }
-            if (keyState.down) {
-                g_renderer->moveCamera(0.0f, -cameraSpeed, 0.0f);
-            }
+        // Camera and cursor as simulated at this moment (movement runs at the simulation's
+        // tick rate, independent of how long frames take)
+        SimulationState state = simulation.getInterpolatedState();
+        renderer.setCameraW(state.cameraW);
+        renderer.setCameraPosition(state.cameraPosition.x, state.cameraPosition.y, state.cameraPosition.z);
+        renderer.setMousePosition(state.mouseX, state.mouseY);
+        if (state.mouseLeftPressed != mouseLeftPressed) {
+            renderer.setMouseButtonState(state.mouseLeftPressed);
+            mouseLeftPressed = state.mouseLeftPressed;
+        }
+        if (allocationCheckFrames > 0) {
+            float turn = static_cast<float>(checkedFrames % allocationCheckFrames) / allocationCheckFrames;
+            renderer.setCameraPosition(state.cameraPosition.x + std::sin(turn * 6.2831853f), state.cameraPosition.y,
+                                       state.cameraPosition.z + std::cos(turn * 6.2831853f));
+            renderer.setMousePosition(turn * window_width, window_height / 2.0f);
         }
             
         // Clear screen
@@ -215,14 +314,58 @@ int main() {
         // Render the SDF scene (time is now static)
         renderer.render(time);
         
+        // Allocation check: after the warm-up loops, every frame has to be allocation-free
+        if (allocationCheckFrames > 0) {
+            checkedFrames++;
+            if (checkedFrames > warmupFrames && renderer.getFrameAllocations() > 0) {
+                std::cerr << "Frame " << checkedFrames << " made " << renderer.getFrameAllocations()
+                          << " heap allocations after " << warmupFrames << " warm-up frames" << std::endl;
+                allocationCheckFailed = true;
+                glfwSetWindowShouldClose(window, true);
+            } else if (checkedFrames == warmupFrames + allocationCheckFrames) {
+                std::cout << "No heap allocations in " << allocationCheckFrames << " frames after "
+                          << warmupFrames << " warm-up frames" << std::endl;
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
+        
+        // Profiler summary in the title while profiling (restored when it's turned off)
+        if (renderer.isProfilingEnabled() && currentFrameTime - lastTitleTime > 0.5) {
+            std::string title = "Simple SDF Renderer | " + renderer.getProfiler().formatSummary(30);
+            title += " | " + std::to_string(renderer.getFrameAllocations()) + " allocs/frame";
+            const SDFRenderer::UploadStats& upload = renderer.getUploadStats();
+            int sceneObjects = upload.visibleObjects + upload.culledObjects;
+            if (sceneObjects > 0) {
+                long long culledPercent = static_cast<long long>(upload.culledObjects) * 100 / sceneObjects;
+                title += " | culled " + std::to_string(culledPercent) + "% of " + std::to_string(sceneObjects);
+            }
+            const TileBinStats& bins = renderer.getTileBinStats();
+            if (renderer.isTileBinningEnabled() && bins.tilesX * bins.tilesY > 0) {
+                title += " | " + std::to_string(bins.entries / (bins.tilesX * bins.tilesY)) + " objects/tile, max " +
+                         std::to_string(bins.maxTileObjects);
+            }
+            if (renderer.getWorld().isOpen()) {
+                const WorldStats& world = renderer.getWorld().getStats();
+                title += " | cells " + std::to_string(world.residentCells) + "/" + std::to_string(world.cellCount) +
+                         " resident, " + std::to_string(world.loadingCells) + " loading";
+            }
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleTime = currentFrameTime;
+            profilerTitle = true;
+        } else if (!renderer.isProfilingEnabled() && profilerTitle) {
+            glfwSetWindowTitle(window, "Simple SDF Renderer");
+            profilerTitle = false;
+        }
+        
         // Swap buffers and poll events
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     // --- Cleanup ---
+    g_simulation = nullptr;
     renderer.cleanup();
     glfwTerminate();
     
-    return 0;
+    return allocationCheckFailed ? 1 : 0;
 }